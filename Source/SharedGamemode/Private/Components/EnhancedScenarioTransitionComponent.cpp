@@ -83,8 +83,12 @@ void UEnhancedScenarioTransitionComponent::GenerateVotingOptions()
 		return;
 	}
 
-	// Get weighted options considering rotation and popularity
-	TArray<FPrimaryAssetId> WeightedOptions = PersistenceManager->GetWeightedScenarioOptions(NumScenarioOptions);
+	// Use the planned slate when the rotation planner has one, otherwise weight options by popularity
+	TArray<FPrimaryAssetId> WeightedOptions;
+	if (!PersistenceManager->GetPlannedRotationOptions(NumScenarioOptions, WeightedOptions))
+	{
+		WeightedOptions = PersistenceManager->GetWeightedScenarioOptions(NumScenarioOptions);
+	}
     
 	// Convert to enhanced vote entries
     FEnhancedVotingState* EnhancedState = static_cast<FEnhancedVotingState*>(&VotingState);
@@ -155,6 +159,10 @@ void UEnhancedScenarioTransitionComponent::ProcessVotingResults()
     // Update persistence
     if (UScenarioPersistenceManager* PersistenceManager = GetGameInstance<UGameInstance>()->GetSubsystem<UScenarioPersistenceManager>())
     {
+        for (const FEnhancedVoteEntry& Entry : EnhancedState->EnhancedVoteOptions)
+        {
+            PersistenceManager->RecordVotes(Entry.ScenarioId, Entry.VoteCount);
+        }
         PersistenceManager->UpdatePlayCount(WinningScenario);
     }
 
@@ -270,32 +278,17 @@ void UEnhancedScenarioTransitionComponent::ApplyRotationRules()
 	// If we filtered out too many options, add some back from the rotation pool
 	if (FilteredOptions.Num() < NumScenarioOptions / 2)
 	{
-		TArray<FPrimaryAssetId> RotationOptions = PersistenceManager->GetNextRotationOptions();
-        
-		for (const FPrimaryAssetId& ScenarioId : RotationOptions)
+		TArray<FPrimaryAssetId> ExistingOptions;
+		for (const FEnhancedVoteEntry& Entry : FilteredOptions)
 		{
-			if (FilteredOptions.Num() >= NumScenarioOptions)
-			{
-				break;
-			}
-
-			// Only add if not already in filtered options
-			bool bAlreadyExists = false;
-			for (const FEnhancedVoteEntry& Entry : FilteredOptions)
-			{
-				if (Entry.ScenarioId == ScenarioId)
-				{
-					bAlreadyExists = true;
-					break;
-				}
-			}
+			ExistingOptions.Add(Entry.ScenarioId);
+		}
 
-			if (!bAlreadyExists)
-			{
-				FEnhancedVoteEntry NewEntry;
-				NewEntry.ScenarioId = ScenarioId;
-				FilteredOptions.Add(NewEntry);
-			}
+		for (const FPrimaryAssetId& ScenarioId : PersistenceManager->GetNextRotationOptions(NumScenarioOptions - FilteredOptions.Num(), ExistingOptions))
+		{
+			FEnhancedVoteEntry NewEntry;
+			NewEntry.ScenarioId = ScenarioId;
+			FilteredOptions.Add(NewEntry);
 		}
 	}
 
@@ -18,6 +18,7 @@ Copyright 2021 Empires Team
 #include "Components/GamestateScenarioComponent.h"
 #include "ScenarioInstanceSubsystem.h"
 #include "Net/UnrealNetwork.h"
+#include "Engine/NetDriver.h"
 #include "GameplayScenario.h"
 
 UGamestateScenarioComponent::UGamestateScenarioComponent(const FObjectInitializer& ObjectInitializer)
@@ -63,20 +64,14 @@ void UGamestateScenarioComponent::OnRegister()
 	}
 }
 
-void UGamestateScenarioComponent::BeginPlay()
+void UGamestateScenarioComponent::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
 {
-	Super::BeginPlay();
-	
-	// Start periodic cleanup if we have authority
+	Super::PreReplication(ChangedPropertyTracker);
+
+	// Items ServerDeactivateScenario marked leave in the net update that follows
 	if (bHasAuthority)
 	{
-		GetWorld()->GetTimerManager().SetTimer(
-			CleanupTimerHandle,
-			this,
-			&UGamestateScenarioComponent::CleanupPendingScenarios,
-			1.0f,
-			true
-		);
+		Scenarios.RemovePendingScenarios();
 	}
 }
 
@@ -93,12 +88,7 @@ void UGamestateScenarioComponent::ServerActivateScenario_Implementation(UGamepla
 		return;
 	}
 
-	FGameplayScenarioNetworkArrayItem Item;
-	Item.Scenario = Scenario;
-    
-	Scenarios.Items.Add(Item);
-	Scenarios.MarkArrayDirty();
-	Scenarios.MarkItemDirty(Item);
+	Scenarios.AddScenario(Scenario);
 }
 
 void UGamestateScenarioComponent::ServerDeactivateScenario_Implementation(UGameplayScenario* Scenario)
@@ -111,8 +101,17 @@ void UGamestateScenarioComponent::ServerDeactivateScenario_Implementation(UGamep
 	int32 Index = FindScenarioIndex(Scenario);
 	if (Index != INDEX_NONE)
 	{
-		Scenarios.Items[Index].bPendingRemoval = true;
-		Scenarios.MarkArrayDirty();
+		Scenarios.MarkPendingRemoval(Index);
+		if (!HasReplicationTarget())
+		{
+			// Nothing will replicate, so nothing calls PreReplication to remove it
+			Scenarios.RemovePendingScenarios();
+		}
+		else if (AActor* Owner = GetOwner())
+		{
+			// Removed in PreReplication, with a net update forced so that happens right away
+			Owner->ForceNetUpdate();
+		}
 	}
 }
 
@@ -121,35 +120,21 @@ bool UGamestateScenarioComponent::IsScenarioActive(UGameplayScenario* Scenario)
 	return FindScenarioIndex(Scenario) != INDEX_NONE;
 }
 
-void UGamestateScenarioComponent::CleanupPendingScenarios()
+int32 UGamestateScenarioComponent::FindScenarioIndex(UGameplayScenario* Scenario) const
 {
-	if (!bHasAuthority)
-	{
-		return;
-	}
-
-	bool bNeedsCleanup = false;
-	for (int32 i = Scenarios.Items.Num() - 1; i >= 0; --i)
-	{
-		if (Scenarios.Items[i].bPendingRemoval)
-		{
-			Scenarios.Items.RemoveAt(i);
-			bNeedsCleanup = true;
-		}
-	}
+	return Scenarios.FindScenarioIndex(Scenario);
+}
 
-	if (bNeedsCleanup)
+bool UGamestateScenarioComponent::HasReplicationTarget() const
+{
+	const UWorld* World = GetWorld();
+	if (!World || World->GetNetMode() == NM_Standalone)
 	{
-		Scenarios.MarkArrayDirty();
+		return false;
 	}
-}
 
-int32 UGamestateScenarioComponent::FindScenarioIndex(UGameplayScenario* Scenario) const
-{
-	return Scenarios.Items.IndexOfByPredicate([Scenario](const FGameplayScenarioNetworkArrayItem& Item)
-   {
-	   return Item.Scenario == Scenario && !Item.bPendingRemoval;
-   });
+	const UNetDriver* NetDriver = World->GetNetDriver();
+	return NetDriver && NetDriver->ClientConnections.Num() > 0;
 }
 
 void UGamestateScenarioComponent::OnScenarioActivated(UGameplayScenario* Scenario)
@@ -201,6 +186,101 @@ void UGamestateScenarioComponent::DeactivateScenarioLocally(UGameplayScenario* S
 	}
 }
 
+int32 FGameplayScenarioNetworkArray::FindScenarioIndex(const UGameplayScenario* Scenario) const
+{
+	// Checked against the item, a replicated change may have left a stale entry behind
+	const int32* Index = ScenarioToIndex.Find(Scenario);
+	return Index && Items.IsValidIndex(*Index) && Items[*Index].Scenario == Scenario && !Items[*Index].bPendingRemoval ? *Index : INDEX_NONE;
+}
+
+void FGameplayScenarioNetworkArray::AddScenario(UGameplayScenario* Scenario)
+{
+	FGameplayScenarioNetworkArrayItem& Item = Items.AddDefaulted_GetRef();
+	Item.Scenario = Scenario;
+	MarkItemDirty(Item);
+	ScenarioToIndex.Add(Scenario, Items.Num() - 1);
+}
+
+void FGameplayScenarioNetworkArray::MarkPendingRemoval(int32 Index)
+{
+	FGameplayScenarioNetworkArrayItem& Item = Items[Index];
+	if (!Item.bPendingRemoval)
+	{
+		Item.bPendingRemoval = true;
+		ScenarioToIndex.Remove(Item.Scenario);
+		PendingRemovals.Add(Index);
+	}
+}
+
+bool FGameplayScenarioNetworkArray::RemovePendingScenarios()
+{
+	if (PendingRemovals.IsEmpty())
+	{
+		return false;
+	}
+
+	// Highest first, so the item swapped into each hole is never one still waiting to be removed
+	PendingRemovals.Sort(TGreater<int32>());
+	for (const int32 Index : PendingRemovals)
+	{
+		const int32 LastIndex = Items.Num() - 1;
+		Items.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+		if (Index < LastIndex)
+		{
+			int32* MovedIndex = ScenarioToIndex.Find(Items[Index].Scenario);
+			if (MovedIndex && *MovedIndex == LastIndex)
+			{
+				*MovedIndex = Index;
+			}
+		}
+	}
+	PendingRemovals.Reset();
+	MarkArrayDirty();
+	return true;
+}
+
+void FGameplayScenarioNetworkArray::PreReplicatedRemove(const TArrayView<int32> RemovedIndices, int32 FinalSize)
+{
+	for (const int32 Index : RemovedIndices)
+	{
+		const UGameplayScenario* Scenario = Items[Index].Scenario;
+		if (FindScenarioIndex(Scenario) == Index)
+		{
+			ScenarioToIndex.Remove(Scenario);
+		}
+	}
+	PendingReplicatedRemovals.Append(RemovedIndices.GetData(), RemovedIndices.Num());
+}
+
+void FGameplayScenarioNetworkArray::PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize)
+{
+	for (const int32 Index : AddedIndices)
+	{
+		ScenarioToIndex.Add(Items[Index].Scenario, Index);
+	}
+}
+
+void FGameplayScenarioNetworkArray::PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize)
+{
+	for (const int32 Index : ChangedIndices)
+	{
+		ScenarioToIndex.Add(Items[Index].Scenario, Index);
+	}
+}
+
+void FGameplayScenarioNetworkArray::PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters)
+{
+	// Removed slots below the final size now hold the items that were swapped into them
+	for (const int32 Index : PendingReplicatedRemovals)
+	{
+		if (Items.IsValidIndex(Index))
+		{
+			ScenarioToIndex.Add(Items[Index].Scenario, Index);
+		}
+	}
+	PendingReplicatedRemovals.Reset();
+}
+
 void FGameplayScenarioNetworkArrayItem::PreReplicatedRemove(const struct FGameplayScenarioNetworkArray& InArraySerializer)
 {
 	if (IsValid(InArraySerializer.ScenarioComp))
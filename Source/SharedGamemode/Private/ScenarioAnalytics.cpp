@@ -0,0 +1,304 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioAnalytics.h"
+
+#include "Misc/Crc.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace ScenarioAnalytics
+{
+	// Magic, version, header size, scenario count, payload size, payload CRC
+	static constexpr int32 HeaderSize = 18;
+
+	// Empty scenario id, outcome counts and histogram totals with no buckets in use, and the stage count
+	static constexpr int32 ScenarioRecordMinSize = 4 + 3 * 4 + 8 + 8 + 4 + 2 + 4;
+
+	struct FHeader
+	{
+		uint32 Magic = 0;
+		uint16 Version = 0;
+		uint16 HeaderSize = 0;
+		uint32 NumScenarios = 0;
+		uint32 PayloadSize = 0;
+		uint32 PayloadCrc = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FHeader& Header)
+		{
+			return Ar << Header.Magic << Header.Version << Header.HeaderSize << Header.NumScenarios << Header.PayloadSize << Header.PayloadCrc;
+		}
+	};
+
+	static void WriteStats(FArchive& Ar, const FScenarioOutcomeStats& Stats)
+	{
+		FScenarioOutcomeStats Copy = Stats;
+		FScenarioDurationHistogram& Durations = Copy.Durations;
+		Ar << Copy.Successes << Copy.Failures << Copy.Cancellations
+			<< Durations.TotalCount << Durations.TotalMilliseconds << Durations.MaxMilliseconds;
+
+		uint16 NumUsed = 0;
+		for (const uint32 Count : Durations.Counts)
+		{
+			NumUsed += Count > 0 ? 1 : 0;
+		}
+		Ar << NumUsed;
+		for (uint16 Index = 0; Index < FScenarioDurationHistogram::NumBuckets; ++Index)
+		{
+			if (Durations.Counts[Index] > 0)
+			{
+				Ar << Index << Durations.Counts[Index];
+			}
+		}
+	}
+
+	static bool ReadStats(FArchive& Ar, FScenarioOutcomeStats& OutStats)
+	{
+		FScenarioDurationHistogram& Durations = OutStats.Durations;
+		Ar << OutStats.Successes << OutStats.Failures << OutStats.Cancellations
+			<< Durations.TotalCount << Durations.TotalMilliseconds << Durations.MaxMilliseconds;
+
+		uint16 NumUsed = 0;
+		Ar << NumUsed;
+		for (uint16 Read = 0; Read < NumUsed && !Ar.IsError(); ++Read)
+		{
+			uint16 Index = 0;
+			uint32 Count = 0;
+			Ar << Index << Count;
+			if (Index >= FScenarioDurationHistogram::NumBuckets)
+			{
+				return false;
+			}
+			Durations.Counts[Index] = Count;
+		}
+		return !Ar.IsError();
+	}
+}
+
+int32 FScenarioDurationHistogram::GetBucketIndex(uint32 Milliseconds)
+{
+	if (Milliseconds < NumSubBuckets)
+	{
+		return static_cast<int32>(Milliseconds);
+	}
+
+	// Each power of two past the exact range is split into NumSubBuckets linear steps
+	const int32 Exponent = static_cast<int32>(FMath::FloorLog2(Milliseconds));
+	const int32 Shift = Exponent - SubBucketBits;
+	return (Shift + 1) * NumSubBuckets + static_cast<int32>(Milliseconds >> Shift) - NumSubBuckets;
+}
+
+uint32 FScenarioDurationHistogram::GetBucketLowerBound(int32 BucketIndex)
+{
+	const int32 Group = BucketIndex / NumSubBuckets;
+	const uint32 SubBucket = static_cast<uint32>(BucketIndex % NumSubBuckets);
+	return Group == 0 ? SubBucket : (NumSubBuckets + SubBucket) << (Group - 1);
+}
+
+void FScenarioDurationHistogram::Add(float Seconds)
+{
+	const uint32 Milliseconds = static_cast<uint32>(FMath::Clamp<double>(Seconds * 1000.0, 0.0, MAX_uint32));
+	Counts[GetBucketIndex(Milliseconds)]++;
+	TotalCount++;
+	TotalMilliseconds += Milliseconds;
+	MaxMilliseconds = FMath::Max(MaxMilliseconds, Milliseconds);
+}
+
+void FScenarioDurationHistogram::Merge(const FScenarioDurationHistogram& Other)
+{
+	for (int32 Index = 0; Index < NumBuckets; ++Index)
+	{
+		Counts[Index] += Other.Counts[Index];
+	}
+	TotalCount += Other.TotalCount;
+	TotalMilliseconds += Other.TotalMilliseconds;
+	MaxMilliseconds = FMath::Max(MaxMilliseconds, Other.MaxMilliseconds);
+}
+
+float FScenarioDurationHistogram::GetPercentile(float Percentile) const
+{
+	if (TotalCount == 0)
+	{
+		return 0.0f;
+	}
+
+	const uint64 Target = FMath::Clamp<uint64>(FMath::CeilToInt64(FMath::Clamp(Percentile, 0.0f, 100.0f) / 100.0 * TotalCount), 1, TotalCount);
+	uint64 Seen = 0;
+	for (int32 Index = 0; Index < NumBuckets; ++Index)
+	{
+		Seen += Counts[Index];
+		if (Seen >= Target)
+		{
+			const uint64 Lower = GetBucketLowerBound(Index);
+			const uint64 Upper = Index + 1 < NumBuckets ? GetBucketLowerBound(Index + 1) : static_cast<uint64>(MAX_uint32) + 1;
+			return FMath::Min<uint64>((Lower + Upper) / 2, MaxMilliseconds) / 1000.0f;
+		}
+	}
+	return MaxMilliseconds / 1000.0f;
+}
+
+float FScenarioDurationHistogram::GetMeanSeconds() const
+{
+	return TotalCount > 0 ? static_cast<float>(static_cast<double>(TotalMilliseconds) / TotalCount / 1000.0) : 0.0f;
+}
+
+void FScenarioOutcomeStats::Record(EScenarioOutcome Outcome, float Seconds)
+{
+	switch (Outcome)
+	{
+	case EScenarioOutcome::Success:
+		Successes++;
+		break;
+	case EScenarioOutcome::Failure:
+		Failures++;
+		break;
+	case EScenarioOutcome::Cancelled:
+		Cancellations++;
+		break;
+	}
+	Durations.Add(Seconds);
+}
+
+void FScenarioOutcomeStats::Merge(const FScenarioOutcomeStats& Other)
+{
+	Successes += Other.Successes;
+	Failures += Other.Failures;
+	Cancellations += Other.Cancellations;
+	Durations.Merge(Other.Durations);
+}
+
+void FScenarioAnalytics::RecordRun(const FPrimaryAssetId& ScenarioId, EScenarioOutcome Outcome, float Seconds)
+{
+	Scenarios.FindOrAdd(ScenarioId).Runs.Record(Outcome, Seconds);
+}
+
+void FScenarioAnalytics::RecordStage(const FPrimaryAssetId& ScenarioId, FName StageName, EScenarioOutcome Outcome, float Seconds)
+{
+	Scenarios.FindOrAdd(ScenarioId).Stages.FindOrAdd(StageName).Record(Outcome, Seconds);
+}
+
+void FScenarioAnalytics::Merge(const FScenarioAnalytics& Other)
+{
+	for (const TPair<FPrimaryAssetId, FScenarioAnalyticsEntry>& Pair : Other.Scenarios)
+	{
+		FScenarioAnalyticsEntry& Entry = Scenarios.FindOrAdd(Pair.Key);
+		Entry.Runs.Merge(Pair.Value.Runs);
+		for (const TPair<FName, FScenarioOutcomeStats>& Stage : Pair.Value.Stages)
+		{
+			Entry.Stages.FindOrAdd(Stage.Key).Merge(Stage.Value);
+		}
+	}
+}
+
+void FScenarioAnalytics::Write(TArray<uint8>& OutBytes) const
+{
+	using namespace ScenarioAnalytics;
+
+	OutBytes.Reset();
+	FMemoryWriter Writer(OutBytes);
+
+	// Placeholder, rewritten once the payload CRC is known
+	FHeader Header;
+	Writer << Header;
+
+	for (const TPair<FPrimaryAssetId, FScenarioAnalyticsEntry>& Pair : Scenarios)
+	{
+		FString ScenarioId = Pair.Key.ToString();
+		uint32 NumStages = Pair.Value.Stages.Num();
+		Writer << ScenarioId;
+		WriteStats(Writer, Pair.Value.Runs);
+		Writer << NumStages;
+		for (const TPair<FName, FScenarioOutcomeStats>& Stage : Pair.Value.Stages)
+		{
+			FString StageName = Stage.Key.ToString();
+			Writer << StageName;
+			WriteStats(Writer, Stage.Value);
+		}
+	}
+
+	Header.Magic = Magic;
+	Header.Version = CurrentVersion;
+	Header.HeaderSize = HeaderSize;
+	Header.NumScenarios = Scenarios.Num();
+	Header.PayloadSize = OutBytes.Num() - HeaderSize;
+	Header.PayloadCrc = FCrc::MemCrc32(OutBytes.GetData() + HeaderSize, Header.PayloadSize);
+	Writer.Seek(0);
+	Writer << Header;
+}
+
+bool FScenarioAnalytics::Read(const TArray<uint8>& Bytes, FString& OutError)
+{
+	using namespace ScenarioAnalytics;
+
+	if (Bytes.Num() < HeaderSize)
+	{
+		OutError = TEXT("file is shorter than its header");
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	FHeader Header;
+	Reader << Header;
+
+	if (Header.Magic != Magic)
+	{
+		OutError = TEXT("not a scenario analytics file");
+		return false;
+	}
+	if (Header.Version == 0 || Header.Version > CurrentVersion)
+	{
+		OutError = FString::Printf(TEXT("unsupported schema version %d"), Header.Version);
+		return false;
+	}
+	if (Header.HeaderSize < HeaderSize || static_cast<int64>(Header.HeaderSize) + Header.PayloadSize != Bytes.Num())
+	{
+		OutError = TEXT("size does not match header");
+		return false;
+	}
+	if (FCrc::MemCrc32(Bytes.GetData() + Header.HeaderSize, Header.PayloadSize) != Header.PayloadCrc)
+	{
+		OutError = TEXT("checksum mismatch");
+		return false;
+	}
+
+	// The scenario count is outside the CRC, so it must fit the payload before it sizes anything
+	if (static_cast<int64>(Header.NumScenarios) * ScenarioRecordMinSize > Header.PayloadSize)
+	{
+		OutError = TEXT("scenario count does not fit the payload");
+		return false;
+	}
+
+	Reader.Seek(Header.HeaderSize);
+
+	TMap<FPrimaryAssetId, FScenarioAnalyticsEntry> ReadScenarios;
+	ReadScenarios.Reserve(Header.NumScenarios);
+	for (uint32 ScenarioIndex = 0; ScenarioIndex < Header.NumScenarios; ++ScenarioIndex)
+	{
+		FString ScenarioId;
+		Reader << ScenarioId;
+		FScenarioAnalyticsEntry& Entry = ReadScenarios.FindOrAdd(FPrimaryAssetId(ScenarioId));
+
+		uint32 NumStages = 0;
+		const bool bReadRuns = ReadStats(Reader, Entry.Runs);
+		Reader << NumStages;
+		if (!bReadRuns || Reader.IsError())
+		{
+			OutError = TEXT("truncated scenario record");
+			return false;
+		}
+
+		for (uint32 StageIndex = 0; StageIndex < NumStages; ++StageIndex)
+		{
+			FString StageName;
+			Reader << StageName;
+			if (Reader.IsError() || !ReadStats(Reader, Entry.Stages.FindOrAdd(FName(*StageName))))
+			{
+				OutError = TEXT("truncated stage record");
+				return false;
+			}
+		}
+	}
+
+	Scenarios = MoveTemp(ReadScenarios);
+	return true;
+}
@@ -0,0 +1,318 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioBlackboard.h"
+
+#include "Engine/NetSerialization.h"
+
+namespace ScenarioBlackboard
+{
+	// Payload of type T in Value, replacing whatever it held before
+	template<typename T>
+	T& MakePayload(FInstancedStruct& Value)
+	{
+		if (Value.GetScriptStruct() != T::StaticStruct())
+		{
+			Value.InitializeAs<T>();
+		}
+		return Value.GetMutable<T>();
+	}
+}
+
+bool FScenarioBlackboardEntry::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	using namespace ScenarioBlackboard;
+
+	Key.NetSerialize(Ar, Map, bOutSuccess);
+
+	uint8 TypeValue = static_cast<uint8>(Type);
+	Ar.SerializeBits(&TypeValue, 3);
+	Type = static_cast<EScenarioBlackboardValueType>(TypeValue);
+
+	switch (Type)
+	{
+	case EScenarioBlackboardValueType::Int:
+		{
+			int32& IntValue = MakePayload<FScenarioBlackboardInt>(Value).Value;
+
+			// Zig-zag varint, same as tag stack counts
+			uint32 Encoded = Ar.IsSaving() ? (static_cast<uint32>(IntValue) << 1) ^ static_cast<uint32>(IntValue >> 31) : 0;
+			Ar.SerializeIntPacked(Encoded);
+			if (Ar.IsLoading())
+			{
+				IntValue = static_cast<int32>(Encoded >> 1) ^ -static_cast<int32>(Encoded & 1);
+			}
+		}
+		break;
+	case EScenarioBlackboardValueType::Float:
+		Ar << MakePayload<FScenarioBlackboardFloat>(Value).Value;
+		break;
+	case EScenarioBlackboardValueType::Vector:
+		bOutSuccess &= SerializePackedVector<10, 24>(MakePayload<FScenarioBlackboardVector>(Value).Value, Ar);
+		break;
+	case EScenarioBlackboardValueType::Object:
+		{
+			TObjectPtr<UObject>& ObjectValue = MakePayload<FScenarioBlackboardObject>(Value).Value;
+			UObject* Object = ObjectValue;
+			if (Map)
+			{
+				bOutSuccess &= Map->SerializeObject(Ar, UObject::StaticClass(), Object);
+			}
+			ObjectValue = Object;
+		}
+		break;
+	case EScenarioBlackboardValueType::Struct:
+		Value.NetSerialize(Ar, Map, bOutSuccess);
+		break;
+	default:
+		if (Ar.IsLoading())
+		{
+			Value.Reset();
+		}
+		break;
+	}
+
+	bOutSuccess = bOutSuccess && !Ar.IsError();
+	return true;
+}
+
+FString FScenarioBlackboardEntry::GetDebugString() const
+{
+	switch (Type)
+	{
+	case EScenarioBlackboardValueType::Int:
+		return FString::Printf(TEXT("%s = %d"), *Key.ToString(), Value.Get<FScenarioBlackboardInt>().Value);
+	case EScenarioBlackboardValueType::Float:
+		return FString::Printf(TEXT("%s = %f"), *Key.ToString(), Value.Get<FScenarioBlackboardFloat>().Value);
+	case EScenarioBlackboardValueType::Vector:
+		return FString::Printf(TEXT("%s = %s"), *Key.ToString(), *Value.Get<FScenarioBlackboardVector>().Value.ToString());
+	case EScenarioBlackboardValueType::Object:
+		return FString::Printf(TEXT("%s = %s"), *Key.ToString(), *GetNameSafe(Value.Get<FScenarioBlackboardObject>().Value));
+	case EScenarioBlackboardValueType::Struct:
+		return FString::Printf(TEXT("%s = %s"), *Key.ToString(), *GetNameSafe(Value.GetScriptStruct()));
+	default:
+		return FString::Printf(TEXT("%s = None"), *Key.ToString());
+	}
+}
+
+FScenarioBlackboardEntry* FScenarioBlackboard::FindOrAddEntry(FGameplayTag Key)
+{
+	if (!Key.IsValid())
+	{
+		return nullptr;
+	}
+
+	if (const int32* Index = KeyToIndexMap.Find(Key))
+	{
+		return &Entries[*Index];
+	}
+
+	FScenarioBlackboardEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Key = Key;
+	KeyToIndexMap.Add(Key, Entries.Num() - 1);
+	return &Entry;
+}
+
+template<typename PayloadType, typename ValueType>
+void FScenarioBlackboard::SetValue(FGameplayTag Key, EScenarioBlackboardValueType Type, const ValueType& NewValue)
+{
+	FScenarioBlackboardEntry* Entry = FindOrAddEntry(Key);
+	if (!Entry)
+	{
+		return;
+	}
+
+	if (const PayloadType* Current = Entry->GetPayload<PayloadType>(Type))
+	{
+		if (Current->Value == NewValue)
+		{
+			return;
+		}
+	}
+
+	Entry->Type = Type;
+	ScenarioBlackboard::MakePayload<PayloadType>(Entry->Value).Value = NewValue;
+	MarkItemDirty(*Entry);
+	NotifyValueChanged(*Entry);
+}
+
+void FScenarioBlackboard::SetInt(FGameplayTag Key, int32 Value)
+{
+	SetValue<FScenarioBlackboardInt>(Key, EScenarioBlackboardValueType::Int, Value);
+}
+
+void FScenarioBlackboard::SetFloat(FGameplayTag Key, float Value)
+{
+	SetValue<FScenarioBlackboardFloat>(Key, EScenarioBlackboardValueType::Float, Value);
+}
+
+void FScenarioBlackboard::SetVector(FGameplayTag Key, const FVector& Value)
+{
+	SetValue<FScenarioBlackboardVector>(Key, EScenarioBlackboardValueType::Vector, Value);
+}
+
+void FScenarioBlackboard::SetObject(FGameplayTag Key, UObject* Value)
+{
+	SetValue<FScenarioBlackboardObject>(Key, EScenarioBlackboardValueType::Object, TObjectPtr<UObject>(Value));
+}
+
+void FScenarioBlackboard::SetStruct(FGameplayTag Key, const FInstancedStruct& Value)
+{
+	FScenarioBlackboardEntry* Entry = FindOrAddEntry(Key);
+	if (!Entry || (Entry->Type == EScenarioBlackboardValueType::Struct && Entry->Value == Value))
+	{
+		return;
+	}
+
+	Entry->Type = EScenarioBlackboardValueType::Struct;
+	Entry->Value = Value;
+	MarkItemDirty(*Entry);
+	NotifyValueChanged(*Entry);
+}
+
+void FScenarioBlackboard::ClearValue(FGameplayTag Key)
+{
+	const int32* Index = KeyToIndexMap.Find(Key);
+	if (!Index)
+	{
+		return;
+	}
+
+	const int32 RemovedIndex = *Index;
+	KeyToIndexMap.Remove(Key);
+
+	// Order does not matter for replication, so swap the last entry into the hole
+	Entries.RemoveAtSwap(RemovedIndex);
+	if (Entries.IsValidIndex(RemovedIndex))
+	{
+		*KeyToIndexMap.Find(Entries[RemovedIndex].Key) = RemovedIndex;
+	}
+	MarkArrayDirty();
+
+	FScenarioBlackboardEntry Removed;
+	Removed.Key = Key;
+	NotifyValueChanged(Removed);
+}
+
+bool FScenarioBlackboard::GetInt(FGameplayTag Key, int32& OutValue) const
+{
+	const FScenarioBlackboardEntry* Entry = FindEntry(Key);
+	if (const FScenarioBlackboardInt* Payload = Entry ? Entry->GetPayload<FScenarioBlackboardInt>(EScenarioBlackboardValueType::Int) : nullptr)
+	{
+		OutValue = Payload->Value;
+		return true;
+	}
+	return false;
+}
+
+bool FScenarioBlackboard::GetFloat(FGameplayTag Key, float& OutValue) const
+{
+	const FScenarioBlackboardEntry* Entry = FindEntry(Key);
+	if (const FScenarioBlackboardFloat* Payload = Entry ? Entry->GetPayload<FScenarioBlackboardFloat>(EScenarioBlackboardValueType::Float) : nullptr)
+	{
+		OutValue = Payload->Value;
+		return true;
+	}
+	return false;
+}
+
+bool FScenarioBlackboard::GetVector(FGameplayTag Key, FVector& OutValue) const
+{
+	const FScenarioBlackboardEntry* Entry = FindEntry(Key);
+	if (const FScenarioBlackboardVector* Payload = Entry ? Entry->GetPayload<FScenarioBlackboardVector>(EScenarioBlackboardValueType::Vector) : nullptr)
+	{
+		OutValue = Payload->Value;
+		return true;
+	}
+	return false;
+}
+
+bool FScenarioBlackboard::GetObject(FGameplayTag Key, UObject*& OutValue) const
+{
+	const FScenarioBlackboardEntry* Entry = FindEntry(Key);
+	if (const FScenarioBlackboardObject* Payload = Entry ? Entry->GetPayload<FScenarioBlackboardObject>(EScenarioBlackboardValueType::Object) : nullptr)
+	{
+		OutValue = Payload->Value;
+		return true;
+	}
+	return false;
+}
+
+const FScenarioBlackboardEntry* FScenarioBlackboard::FindEntry(FGameplayTag Key) const
+{
+	const int32* Index = KeyToIndexMap.Find(Key);
+	return Index ? &Entries[*Index] : nullptr;
+}
+
+FDelegateHandle FScenarioBlackboard::Subscribe(FGameplayTag Key, FScenarioBlackboardChanged::FDelegate&& Delegate)
+{
+	return KeyListeners.FindOrAdd(Key).Add(MoveTemp(Delegate));
+}
+
+void FScenarioBlackboard::Unsubscribe(FGameplayTag Key, FDelegateHandle Handle)
+{
+	if (FScenarioBlackboardChanged* Listeners = KeyListeners.Find(Key))
+	{
+		Listeners->Remove(Handle);
+	}
+}
+
+void FScenarioBlackboard::PreReplicatedRemove(const TArrayView<int32> RemovedIndices, int32 FinalSize)
+{
+	for (int32 Index : RemovedIndices)
+	{
+		const FGameplayTag Key = Entries[Index].Key;
+		KeyToIndexMap.Remove(Key);
+
+		FScenarioBlackboardEntry Removed;
+		Removed.Key = Key;
+		NotifyValueChanged(Removed);
+	}
+
+	PendingReplicatedRemovals.Append(RemovedIndices.GetData(), RemovedIndices.Num());
+}
+
+void FScenarioBlackboard::PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize)
+{
+	for (int32 Index : AddedIndices)
+	{
+		KeyToIndexMap.FindOrAdd(Entries[Index].Key) = Index;
+		NotifyValueChanged(Entries[Index]);
+	}
+}
+
+void FScenarioBlackboard::PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize)
+{
+	for (int32 Index : ChangedIndices)
+	{
+		KeyToIndexMap.FindOrAdd(Entries[Index].Key) = Index;
+		NotifyValueChanged(Entries[Index]);
+	}
+}
+
+void FScenarioBlackboard::PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters)
+{
+	// Removed slots below the final size now hold the entries that were swapped into them
+	for (int32 Index : PendingReplicatedRemovals)
+	{
+		if (Entries.IsValidIndex(Index))
+		{
+			if (int32* KeyIndex = KeyToIndexMap.Find(Entries[Index].Key))
+			{
+				*KeyIndex = Index;
+			}
+		}
+	}
+	PendingReplicatedRemovals.Reset();
+}
+
+void FScenarioBlackboard::NotifyValueChanged(const FScenarioBlackboardEntry& Entry)
+{
+	if (const FScenarioBlackboardChanged* Listeners = KeyListeners.Find(Entry.Key))
+	{
+		// Listeners may subscribe to other keys, which can move the map's storage, so broadcast a copy
+		const FScenarioBlackboardChanged ListenersCopy = *Listeners;
+		ListenersCopy.Broadcast(Entry.Key, Entry);
+	}
+	OnValueChanged.Broadcast(Entry.Key, Entry);
+}
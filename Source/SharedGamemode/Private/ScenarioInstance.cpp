@@ -25,8 +25,10 @@ void UScenarioInstance::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& Ou
 	DOREPLIFETIME(UScenarioInstance, ScenarioAsset);
 	DOREPLIFETIME(UScenarioInstance, ScenarioState);
 	DOREPLIFETIME(UScenarioInstance, CurrentStage);
+	DOREPLIFETIME(UScenarioInstance, BranchStages);
 	DOREPLIFETIME(UScenarioInstance, PreviousStageResult);
 	DOREPLIFETIME(UScenarioInstance, TagStacks);
+	DOREPLIFETIME(UScenarioInstance, Blackboard);
 	DOREPLIFETIME(UScenarioInstance, RuntimeTags);
 }
 
@@ -50,6 +52,7 @@ bool UScenarioInstance::InitScenario(UGameplayScenario* Scenario, const FGamepla
 	ScenarioAsset = Scenario;
 	RuntimeTags.AppendTags(InitTags);
 	ScenarioState = EScenarioState::Active;
+	StartTime = GetWorldTime();
 
 	// Start with initial stage from scenario
 	EnterStage(ScenarioAsset->InitialStage);
@@ -59,13 +62,20 @@ bool UScenarioInstance::InitScenario(UGameplayScenario* Scenario, const FGamepla
 
 void UScenarioInstance::EndScenario(bool bCancelled)
 {
+	if (bEnded)
+	{
+		return;
+	}
+	bEnded = true;
+	EndTime = GetWorldTime();
+
 	// Update state
 	ScenarioState = bCancelled ? EScenarioState::Cancelled : ScenarioState;
 
 	// Clean up current stage
 	if (IsValid(CurrentStage))
 	{
-		ExitStage(CurrentStage);
+		ExitStage(CurrentStage, bCancelled);
 	}
 
 	// Clean up global services
@@ -82,9 +92,19 @@ void UScenarioInstance::EndScenario(bool bCancelled)
 	OnScenarioEnded.Broadcast(this, bCancelled);
 }
 
+float UScenarioInstance::GetRunningTime() const
+{
+	return static_cast<float>((bEnded ? EndTime : GetWorldTime()) - StartTime);
+}
+
 TArray<UScenarioTask_ObjectiveTracker*> UScenarioInstance::GetCurrentObjectiveTrackers()
 {
-	return ObjectiveTrackers;
+	TArray<UScenarioTask_ObjectiveTracker*> Trackers = MainStage.ObjectiveTrackers;
+	for (const FScenarioStageRuntime& Branch : Branches)
+	{
+		Trackers.Append(Branch.ObjectiveTrackers);
+	}
+	return Trackers;
 }
 
 void UScenarioInstance::ForEachStageService(TFunctionRef<void(UScenarioTask_StageService*)> Func)
@@ -99,146 +119,47 @@ void UScenarioInstance::ForEachStageService(TFunctionRef<void(UScenarioTask_Stag
 	}
 
 	// Process stage-specific services
-	for (auto* Service : StageServices)
+	for (auto* Service : MainStage.StageServices)
 	{
 		if (IsValid(Service))
 		{
 			Func(Service);
 		}
 	}
+
+	// Process services of the parallel branches
+	for (const FScenarioStageRuntime& Branch : Branches)
+	{
+		for (auto* Service : Branch.StageServices)
+		{
+			if (IsValid(Service))
+			{
+				Func(Service);
+			}
+		}
+	}
 }
 
 EScenarioResult UScenarioInstance::EvaluateObjectives()
 {
-    if (!IsValid(CurrentStage))
-    {
-        return EScenarioResult::None;
-    }
-
-    // Get completion mode for this stage
-    EScenarioCompletionMode StageCompletionMode = CurrentStage->CompletionMode;
-
-    // Track completion states for each objective
-    TMap<UScenarioObjective*, EScenarioResult> ObjectiveStates;
-    
-    // Current overall stage state - starts as success for AllSuccess mode,
-    // starts as failure for AnySuccess mode
-    EScenarioResult StageState = EScenarioResult::InProgress;
-
-    // Stage completion rules
-    const bool bStageRequiresAllSuccess = StageCompletionMode == EScenarioCompletionMode::AllSuccess;
-    const bool bStageNeedsAnySuccess = StageCompletionMode == EScenarioCompletionMode::AnySuccess;
-
-    // Check all objective trackers
-    for (UScenarioTask_ObjectiveTracker* Tracker : ObjectiveTrackers)
-    {
-        if (!IsValid(Tracker))
-        {
-            continue;
-        }
-
-        // Get current tracker state and objective rules
-        EScenarioResult TrackerState = Tracker->GetTrackerState();
-        UScenarioObjective* Objective = Tracker->GetObjective();
-        const EScenarioCompletionMode ObjectiveMode = Objective->CompletionMode;
-
-        // Quick failure/success checks
-        if (bStageRequiresAllSuccess && 
-            ObjectiveMode == EScenarioCompletionMode::AllSuccess && 
-            TrackerState == EScenarioResult::Failure)
-        {
-            // If stage needs all successes and any required tracker fails,
-            // the whole stage fails immediately
-            return EScenarioResult::Failure;
-        }
-
-        if (bStageNeedsAnySuccess && 
-            ObjectiveMode == EScenarioCompletionMode::AnySuccess && 
-            TrackerState == EScenarioResult::Success)
-        {
-            // If stage needs any success and any tracker succeeds,
-            // the whole stage succeeds immediately
-            return EScenarioResult::Success;
-        }
-
-        // Track objective state
-        EScenarioResult& ObjState = ObjectiveStates.FindOrAdd(
-            Objective, 
-            ObjectiveMode == EScenarioCompletionMode::AllSuccess ? 
-                EScenarioResult::Success : 
-                EScenarioResult::Failure
-        );
-
-        // Update objective state based on tracker
-        if (ObjectiveMode == EScenarioCompletionMode::AllSuccess)
-        {
-            // For AllSuccess objectives, any failure or in-progress
-            // tracker means the objective isn't complete
-            if (TrackerState != EScenarioResult::Success)
-            {
-                ObjState = TrackerState == EScenarioResult::Failure ? 
-                    EScenarioResult::Failure : 
-                    EScenarioResult::InProgress;
-            }
-        }
-        else // AnySuccess mode
-        {
-            // For AnySuccess objectives, any success means complete,
-            // all failures means failed, otherwise still in progress
-            if (TrackerState == EScenarioResult::Success)
-            {
-                ObjState = EScenarioResult::Success;
-            }
-            else if (TrackerState == EScenarioResult::InProgress)
-            {
-                ObjState = EScenarioResult::InProgress;
-            }
-        }
-    }
-
-    // Evaluate final stage state based on all objectives
-    int32 SuccessCount = 0;
-    int32 CompleteCount = 0;
-
-    for (const auto& KV : ObjectiveStates)
-    {
-        if (KV.Value != EScenarioResult::InProgress)
-        {
-            CompleteCount++;
-            if (KV.Value == EScenarioResult::Success)
-            {
-                SuccessCount++;
-            }
-        }
-    }
-
-    // All objectives must be complete to finish the stage
-    if (CompleteCount == ObjectiveStates.Num())
-    {
-        // Stage success/failure depends on completion mode
-        if (bStageRequiresAllSuccess)
-        {
-            // AllSuccess: every objective must succeed
-            return SuccessCount == CompleteCount ? 
-                EScenarioResult::Success : 
-                EScenarioResult::Failure;
-        }
-        else
-        {
-            // AnySuccess: at least one objective must succeed
-            return SuccessCount > 0 ? 
-                EScenarioResult::Success : 
-                EScenarioResult::Failure;
-        }
-    }
-
-    // Still waiting on some objectives
-    return EScenarioResult::InProgress;
+	if (!IsValid(CurrentStage))
+	{
+		return EScenarioResult::None;
+	}
+
+	// A forking stage completes when its branches join
+	if (CurrentStage->IsForkStage())
+	{
+		return BranchCounter.Evaluate(CurrentStage->JoinMode);
+	}
+
+	// Objective states are kept up to date as trackers report in, so this is just a read
+	return MainStage.ObjectiveCounter.Evaluate(CurrentStage->CompletionMode);
 }
 
 bool UScenarioInstance::TryProgressStage()
 {
-	if (!HasAuthority() || !IsValid(CurrentStage))
+	if (bEnteringStage || !HasAuthority() || !IsValid(CurrentStage))
 	{
 		return false;
 	}
@@ -289,6 +210,35 @@ int32 UScenarioInstance::GetTagStackCount(FGameplayTag Tag) const
 	return TagStacks.GetStackCount(Tag);
 }
 
+int32 UScenarioInstance::GetTagStackCountIncludingChildren(FGameplayTag Tag) const
+{
+	return TagStacks.GetStackCountIncludingChildren(Tag);
+}
+
+void UScenarioInstance::WatchTagStackThreshold(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, FScenarioTagStackThresholdReached OnReached)
+{
+	AddTagStackWatcher(Tag, Comparison, Threshold, FTagStackThresholdReached::CreateWeakLambda(this, [OnReached](FGameplayTag ReachedTag, int32 Count)
+	{
+		OnReached.ExecuteIfBound(ReachedTag, Count);
+	}));
+}
+
+FDelegateHandle UScenarioInstance::AddTagStackWatcher(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, FTagStackThresholdReached&& OnReached)
+{
+	return TagStacks.AddThresholdWatcher(Tag, Comparison, Threshold, MoveTemp(OnReached));
+}
+
+void UScenarioInstance::RemoveTagStackWatcher(FGameplayTag Tag, FDelegateHandle Handle)
+{
+	TagStacks.RemoveThresholdWatcher(Tag, Handle);
+}
+
+double UScenarioInstance::GetWorldTime() const
+{
+	const UWorld* World = GetWorld();
+	return World ? World->GetTimeSeconds() : 0.0;
+}
+
 bool UScenarioInstance::HasAuthority() const
 {
 	// Get the world this instance is in
@@ -319,55 +269,284 @@ void UScenarioInstance::OnTagStackChanged(FGameplayTag Tag, int32 NewCount, int3
 void UScenarioInstance::EnterStage(UScenarioStage* Stage)
 {
 	CurrentStage = Stage;
+	const int32 EntrySerial = ++StageEntrySerial;
 
-	if (HasAuthority())
 	{
-		// Create stage services
-		for (auto* ServiceTemplate : Stage->StageServices)
+		// Trackers may resolve from inside BeginPlay; hold progression until the whole stage is set up
+		TGuardValue<bool> EnteringGuard(bEnteringStage, true);
+
+		EnterStageRuntime(MainStage, Stage, INDEX_NONE);
+
+		if (HasAuthority() && Stage->IsForkStage())
 		{
-			if (auto* NewService = DuplicateObject<UScenarioTask_StageService>(ServiceTemplate, this))
-			{
-				StageServices.Add(NewService);
-				NewService->BeginPlay();
-			}
+			ForkBranches(Stage);
 		}
+	}
 
-		// Create objective trackers
+	if (!HasAuthority())
+	{
+		return;
+	}
+
+	if (Stage->IsForkStage())
+	{
+		// Let branches whose trackers already finished move on. Any of them can complete
+		// the join and move the main stage along, so stop as soon as that happens.
+		for (int32 BranchIndex = 0; BranchIndex < Branches.Num() && EntrySerial == StageEntrySerial; ++BranchIndex)
+		{
+			TryProgressBranch(BranchIndex);
+		}
+
+		if (EntrySerial == StageEntrySerial)
+		{
+			TryProgressStage();
+		}
+	}
+	else if (MainStage.Objectives.Num() > 0)
+	{
+		TryProgressStage();
+	}
+}
+
+void UScenarioInstance::ExitStage(UScenarioStage* Stage, bool bCancelled)
+{
+	// Branches that have not finished by now lost the join (or the scenario ended), so they are cancelled
+	for (FScenarioStageRuntime& Branch : Branches)
+	{
+		ExitStageRuntime(Branch, bCancelled || Branch.Result == EScenarioResult::InProgress);
+	}
+	Branches.Empty();
+	BranchStages.Empty();
+	BranchCounter.Reset(0);
+
+	ExitStageRuntime(MainStage, bCancelled);
+}
+
+void UScenarioInstance::EnterStageRuntime(FScenarioStageRuntime& Runtime, UScenarioStage* Stage, int32 BranchIndex)
+{
+	Runtime.Stage = Stage;
+	Runtime.Result = EScenarioResult::InProgress;
+	Runtime.EnterTime = GetWorldTime();
+	Runtime.Objectives.Reset();
+	Runtime.ObjectiveCounter.Reset(0);
+
+	if (!HasAuthority())
+	{
+		return;
+	}
+
+	// Create stage services
+	for (auto* ServiceTemplate : Stage->StageServices)
+	{
+		if (auto* NewService = DuplicateObject<UScenarioTask_StageService>(ServiceTemplate, this))
+		{
+			Runtime.StageServices.Add(NewService);
+		}
+	}
+
+	// Create objective trackers. A forking stage is completed by its branches instead.
+	if (!Stage->IsForkStage())
+	{
 		for (auto* Objective : Stage->Objectives)
 		{
+			if (!IsValid(Objective))
+			{
+				continue;
+			}
+
+			const int32 ObjectiveIndex = Runtime.Objectives.Num();
+			FScenarioObjectiveProgress Progress;
+			Progress.CompletionMode = Objective->CompletionMode;
+
 			for (auto* TrackerTemplate : Objective->ObjectiveTrackers)
 			{
 				if (auto* NewTracker = DuplicateObject<UScenarioTask_ObjectiveTracker>(TrackerTemplate, this))
 				{
-					ObjectiveTrackers.Add(NewTracker);
-					NewTracker->BeginPlay();
+					NewTracker->Objective = Objective;
+					NewTracker->BranchIndex = BranchIndex;
+					NewTracker->ObjectiveIndex = ObjectiveIndex;
+					NewTracker->TrackerIndex = Runtime.ObjectiveTrackers.Add(NewTracker);
+
+					Progress.Trackers.Total++;
+					Progress.Trackers.ApplyTransition(EScenarioResult::InProgress, NewTracker->GetTrackerState());
 				}
 			}
+
+			// Objectives without trackers can never report, so they take no part in the stage result
+			if (Progress.Trackers.Total > 0)
+			{
+				Progress.State = Progress.Trackers.Evaluate(Progress.CompletionMode);
+				Runtime.Objectives.Add(Progress);
+			}
 		}
+
+		Runtime.ObjectiveCounter.Reset(Runtime.Objectives.Num());
+		for (const FScenarioObjectiveProgress& Progress : Runtime.Objectives)
+		{
+			Runtime.ObjectiveCounter.ApplyTransition(EScenarioResult::InProgress, Progress.State);
+		}
+	}
+
+	// Start tasks only once the counters are in place, so results reported from BeginPlay are tallied
+	for (auto* Service : Runtime.StageServices)
+	{
+		Service->BeginPlay();
+	}
+	for (auto* Tracker : Runtime.ObjectiveTrackers)
+	{
+		Tracker->BeginPlay();
 	}
+
+	OnStageChanged.Broadcast(this, Stage, BranchIndex);
 }
 
-void UScenarioInstance::ExitStage(UScenarioStage* Stage)
+void UScenarioInstance::ExitStageRuntime(FScenarioStageRuntime& Runtime, bool bCancelled)
 {
+	if (Runtime.ProgressionTimer.IsValid())
+	{
+		if (UWorld* World = GetWorld())
+		{
+			World->GetTimerManager().ClearTimer(Runtime.ProgressionTimer);
+		}
+	}
+
 	// Clean up stage services
-	for (auto* Service : StageServices)
+	for (auto* Service : Runtime.StageServices)
 	{
 		if (IsValid(Service))
 		{
-			Service->EndPlay(false);
+			Service->EndPlay(bCancelled);
 		}
 	}
-	StageServices.Empty();
+	Runtime.StageServices.Empty();
 
-	// Clean up objective trackers
-	for (auto* Tracker : ObjectiveTrackers)
+	// Clean up objective trackers, detaching them first so late results are ignored
+	for (auto* Tracker : Runtime.ObjectiveTrackers)
 	{
 		if (IsValid(Tracker))
 		{
-			Tracker->EndPlay(false);
+			Tracker->BranchIndex = INDEX_NONE;
+			Tracker->ObjectiveIndex = INDEX_NONE;
+			Tracker->TrackerIndex = INDEX_NONE;
+			Tracker->EndPlay(bCancelled);
+		}
+	}
+	Runtime.ObjectiveTrackers.Empty();
+	Runtime.Objectives.Reset();
+	Runtime.ObjectiveCounter.Reset(0);
+
+	// Cleared so a runtime exited twice, like a finished branch at the join, is only reported once
+	if (IsValid(Runtime.Stage) && HasAuthority())
+	{
+		OnStageExited.Broadcast(this, Runtime.Stage, bCancelled ? EScenarioResult::InProgress : Runtime.Result, static_cast<float>(GetWorldTime() - Runtime.EnterTime));
+	}
+	Runtime.Stage = nullptr;
+}
+
+void UScenarioInstance::ForkBranches(UScenarioStage* Stage)
+{
+	Branches.Reserve(Stage->ForkBranches.Num());
+	BranchStages.Reserve(Stage->ForkBranches.Num());
+
+	for (UScenarioStage* BranchStage : Stage->ForkBranches)
+	{
+		// Branches run plain success/failure chains; forks do not nest
+		if (!ensureMsgf(IsValid(BranchStage) && !BranchStage->IsForkStage(),
+			TEXT("Scenario %s: fork stage %s has an invalid or nested fork branch"), *GetNameSafe(ScenarioAsset), *GetNameSafe(Stage)))
+		{
+			continue;
 		}
+
+		Branches.AddDefaulted();
+		BranchStages.Add(BranchStage);
+	}
+
+	// Indices are stable from here until the main stage exits, so trackers can refer to their branch by index
+	BranchCounter.Reset(Branches.Num());
+	for (int32 BranchIndex = 0; BranchIndex < Branches.Num(); ++BranchIndex)
+	{
+		EnterStageRuntime(Branches[BranchIndex], BranchStages[BranchIndex], BranchIndex);
 	}
-	ObjectiveTrackers.Empty();
+}
+
+void UScenarioInstance::TryProgressBranch(int32 BranchIndex)
+{
+	if (bEnteringStage || !Branches.IsValidIndex(BranchIndex))
+	{
+		return;
+	}
+
+	FScenarioStageRuntime& Branch = Branches[BranchIndex];
+	if (!IsValid(Branch.Stage) || Branch.Result != EScenarioResult::InProgress)
+	{
+		return;
+	}
+
+	// Nothing outside can move a branch on, so a stage without trackers succeeds right away
+	const EScenarioResult StageResult = Branch.Objectives.Num() > 0 ?
+		Branch.ObjectiveCounter.Evaluate(Branch.Stage->CompletionMode) : EScenarioResult::Success;
+	if (StageResult == EScenarioResult::InProgress)
+	{
+		return;
+	}
+
+	const float Delay = GetStageTransitionDelay(Branch.Stage);
+	if (Delay > 0)
+	{
+		FTimerDelegate TimerDelegate;
+		TimerDelegate.BindUObject(this, &ThisClass::ProgressBranch_Internal, BranchIndex, StageResult);
+		GetWorld()->GetTimerManager().SetTimer(Branch.ProgressionTimer, TimerDelegate, Delay, false);
+	}
+	else
+	{
+		ProgressBranch_Internal(BranchIndex, StageResult);
+	}
+}
+
+void UScenarioInstance::ProgressBranch_Internal(int32 BranchIndex, EScenarioResult Transition)
+{
+	if (!Branches.IsValidIndex(BranchIndex))
+	{
+		return;
+	}
+
+	FScenarioStageRuntime& Branch = Branches[BranchIndex];
+	if (!IsValid(Branch.Stage) || Branch.Result != EScenarioResult::InProgress)
+	{
+		return;
+	}
+
+	UScenarioStage* NextStage = Transition == EScenarioResult::Success ?
+		Branch.Stage->NextStage_Success : Branch.Stage->NextStage_Failure;
+
+	// Entering the next stage resets the result, otherwise it stays as the chain's result
+	Branch.Result = Transition;
+	ExitStageRuntime(Branch, false);
+
+	if (IsValid(NextStage) && ensure(!NextStage->IsForkStage()))
+	{
+		// Continue down this branch's chain
+		{
+			TGuardValue<bool> EnteringGuard(bEnteringStage, true);
+			BranchStages[BranchIndex] = NextStage;
+			EnterStageRuntime(Branch, NextStage, BranchIndex);
+		}
+		TryProgressBranch(BranchIndex);
+		return;
+	}
+
+	// End of the chain: the branch reports its last stage result to the join
+	BranchCounter.ApplyTransition(EScenarioResult::InProgress, Transition);
+	TryProgressStage();
+}
+
+FScenarioStageRuntime* UScenarioInstance::GetStageRuntime(int32 BranchIndex)
+{
+	if (BranchIndex == INDEX_NONE)
+	{
+		return &MainStage;
+	}
+	return Branches.IsValidIndex(BranchIndex) ? &Branches[BranchIndex] : nullptr;
 }
 
 void UScenarioInstance::ProgressStage_Internal(EScenarioResult Transition)
@@ -382,6 +561,7 @@ void UScenarioInstance::ProgressStage_Internal(EScenarioResult Transition)
 		CurrentStage->NextStage_Success : CurrentStage->NextStage_Failure;
 
 	// Exit current stage
+	MainStage.Result = Transition;
 	ExitStage(CurrentStage);
 	PreviousStageResult = Transition;
 
@@ -399,6 +579,11 @@ void UScenarioInstance::ProgressStage_Internal(EScenarioResult Transition)
 }
 
 float UScenarioInstance::GetStageTransitionDelay() const
+{
+	return GetStageTransitionDelay(CurrentStage);
+}
+
+float UScenarioInstance::GetStageTransitionDelay(const UScenarioStage* Stage) const
 {
 	float TotalDelay = 0.0f;
 
@@ -409,18 +594,50 @@ float UScenarioInstance::GetStageTransitionDelay() const
 	}
 
 	// Add stage-specific delay
-	if (IsValid(CurrentStage))
+	if (IsValid(Stage))
 	{
-		TotalDelay += CurrentStage->StageCompletionDelay;
+		TotalDelay += Stage->StageCompletionDelay;
 	}
 
 	return TotalDelay;
 }
 
-void UScenarioInstance::NotifyTaskUpdate(UScenarioTask_ObjectiveTracker* Task)
+void UScenarioInstance::NotifyTaskUpdate(UScenarioTask_ObjectiveTracker* Task, EScenarioResult OldResult)
 {
-	if (ObjectiveTrackers.Contains(Task))
+	if (!IsValid(Task))
+	{
+		return;
+	}
+
+	// Trackers know where they live, so there is no need to search the active stages
+	FScenarioStageRuntime* Runtime = GetStageRuntime(Task->BranchIndex);
+	if (!Runtime || !Runtime->ObjectiveTrackers.IsValidIndex(Task->TrackerIndex) || Runtime->ObjectiveTrackers[Task->TrackerIndex] != Task)
+	{
+		return;
+	}
+
+	// Roll the change up into the objective, and into the stage if the objective changed state
+	FScenarioObjectiveProgress& Progress = Runtime->Objectives[Task->ObjectiveIndex];
+	Progress.Trackers.ApplyTransition(OldResult, Task->GetTrackerState());
+
+	const EScenarioResult NewObjectiveState = Progress.Trackers.Evaluate(Progress.CompletionMode);
+	if (NewObjectiveState != Progress.State)
+	{
+		Runtime->ObjectiveCounter.ApplyTransition(Progress.State, NewObjectiveState);
+		Progress.State = NewObjectiveState;
+	}
+
+	if (bEnteringStage)
+	{
+		return;
+	}
+
+	if (Task->BranchIndex == INDEX_NONE)
 	{
 		TryProgressStage();
 	}
+	else
+	{
+		TryProgressBranch(Task->BranchIndex);
+	}
 }
@@ -27,6 +27,7 @@ Copyright 2021 Empires Team
 
 #include "GameFeatureAction.h"
 #include "GameFeaturesSubsystem.h"
+#include "ScenarioPersistenceManager.h"
 #include "ScenarioReplicationProxy.h"
 
 
@@ -129,6 +130,10 @@ UScenarioInstance* UScenarioInstanceSubsystem::StartScenario(UGameplayScenario*
 
 	// Create the scenario instance
 	UScenarioInstance* Instance = NewObject<UScenarioInstance>(ReplicationProxy);
+
+	// Bound before InitScenario, which may already finish stages
+	Instance->OnStageExited.AddUObject(this, &ThisClass::RecordStageOutcome);
+	Instance->OnScenarioEnded.AddUObject(this, &ThisClass::RecordScenarioOutcome);
     
 	if (Instance->InitScenario(ScenarioAsset, Tags))
 	{
@@ -189,6 +194,36 @@ void UScenarioInstanceSubsystem::OnScenarioEnded(UScenarioInstance* Instance, bo
 	}
 }
 
+void UScenarioInstanceSubsystem::RecordScenarioOutcome(UScenarioInstance* Instance, bool bWasCancelled)
+{
+	UScenarioPersistenceManager* PersistenceManager = GetGameInstance()->GetSubsystem<UScenarioPersistenceManager>();
+	if (!PersistenceManager || !IsValid(Instance->GetScenarioAsset()))
+	{
+		return;
+	}
+
+	const EScenarioState State = Instance->GetState();
+	const EScenarioOutcome Outcome = bWasCancelled ? EScenarioOutcome::Cancelled
+		: State == EScenarioState::Success ? EScenarioOutcome::Success
+		: State == EScenarioState::Failure ? EScenarioOutcome::Failure
+		: EScenarioOutcome::Cancelled;
+	PersistenceManager->RecordScenarioOutcome(Instance->GetScenarioAsset()->GetPrimaryAssetId(), Outcome, Instance->GetRunningTime());
+}
+
+void UScenarioInstanceSubsystem::RecordStageOutcome(UScenarioInstance* Instance, UScenarioStage* Stage, EScenarioResult Result, float Seconds)
+{
+	UScenarioPersistenceManager* PersistenceManager = GetGameInstance()->GetSubsystem<UScenarioPersistenceManager>();
+	if (!PersistenceManager || !IsValid(Instance->GetScenarioAsset()))
+	{
+		return;
+	}
+
+	const EScenarioOutcome Outcome = Result == EScenarioResult::Success ? EScenarioOutcome::Success
+		: Result == EScenarioResult::Failure ? EScenarioOutcome::Failure
+		: EScenarioOutcome::Cancelled;
+	PersistenceManager->RecordStageOutcome(Instance->GetScenarioAsset()->GetPrimaryAssetId(), Stage->GetFName(), Outcome, Seconds);
+}
+
 void UScenarioInstanceSubsystem::NotifyAddedScenarioFromReplication(UScenarioInstance* Instance)
 {
 	if (IsValid(Instance))
@@ -0,0 +1,8 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "Logging/LogMacros.h"
+
+// Shared by the persistence manager, the writer, the stats stores and the backends. Defined in ScenarioPersistenceManager.cpp.
+DECLARE_LOG_CATEGORY_EXTERN(LogScenarioPersistence, Log, All);
@@ -3,30 +3,203 @@
 
 #include "ScenarioPersistenceManager.h"
 
-#include "JsonObjectConverter.h"
+#include "ScenarioPersistenceLog.h"
+#include "ScenarioPersistenceWriter.h"
+#include "ScenarioRemoteStatsBackend.h"
+#include "ScenarioStatsBackend.h"
+#include "Async/Async.h"
+#include "Engine/AssetManager.h"
 #include "GameFramework/GameStateBase.h"
+#include "GameplayScenario.h"
+#include "Misc/FileHelper.h"
+
+DEFINE_LOG_CATEGORY(LogScenarioPersistence);
+
+static TAutoConsoleVariable<FString> CVarPersistenceBackend(
+	TEXT("Scenario.Persistence.Backend"),
+	TEXT("file"),
+	TEXT("Where scenario stats are kept: file (local snapshot and journal), shared (memory-mapped file shared by every server process on this host, Linux and Mac only) or remote (aggregation service at Scenario.Persistence.Remote.Url)"));
+
+static TAutoConsoleVariable<bool> CVarPersistenceWriteBehind(
+	TEXT("Scenario.Persistence.WriteBehind"),
+	true,
+	TEXT("Journal scenario stats from a background thread instead of on the game thread after every change"));
+
+static TAutoConsoleVariable<int32> CVarPersistenceSharedStoreCapacity(
+	TEXT("Scenario.Persistence.SharedStoreCapacity"),
+	1024,
+	TEXT("Number of scenarios the shared stats file can hold, only used when the file is created"));
+
+static TAutoConsoleVariable<FString> CVarPersistenceRemoteUrl(
+	TEXT("Scenario.Persistence.Remote.Url"),
+	TEXT("http://127.0.0.1:8787/scenario-stats"),
+	TEXT("Base URL of the scenario stats aggregation service"));
+
+static TAutoConsoleVariable<bool> CVarPersistenceWaitForLoad(
+	TEXT("Scenario.Persistence.WaitForLoad"),
+	true,
+	TEXT("Queries made before the startup load of scenario stats finishes wait for it; when off they see empty stats until it lands"));
+
+static TAutoConsoleVariable<int32> CVarRotationPlanSlots(
+	TEXT("Scenario.Rotation.Plan.Slots"),
+	0,
+	TEXT("Upcoming matches the rotation planner plans ahead on a worker thread, 0 turns the planner off and votes use popularity-weighted options"));
+
+static TAutoConsoleVariable<int32> CVarRotationPlanOptions(
+	TEXT("Scenario.Rotation.Plan.Options"),
+	5,
+	TEXT("Vote options the rotation planner prepares for each upcoming match"));
+
+static TAutoConsoleVariable<float> CVarRotationPlanMatchMinutes(
+	TEXT("Scenario.Rotation.Plan.MatchMinutes"),
+	20.0f,
+	TEXT("Expected match length, used to project wall-time cooldowns onto upcoming matches"));
+
+static TAutoConsoleVariable<float> CVarRotationPlanPlayerCountStrength(
+	TEXT("Scenario.Rotation.Plan.PlayerCountStrength"),
+	1.0f,
+	TEXT("How strongly the planner favours scenarios whose average player count is close to the current one, 0 ignores player counts"));
+
+static TAutoConsoleVariable<FString> CVarRotationPlanDiversityTags(
+	TEXT("Scenario.Rotation.Plan.DiversityTags"),
+	TEXT(""),
+	TEXT("Comma-separated parent tags, e.g. Scenario.Mode,Scenario.Terrain. Planned options avoid sharing a tag under them with each other and with recent matches"));
+
+static TAutoConsoleVariable<int32> CVarRotationPlanDiversityMatches(
+	TEXT("Scenario.Rotation.Plan.DiversityMatches"),
+	2,
+	TEXT("How many previous matches planned options avoid sharing diversity tags with"));
+
+static TAutoConsoleVariable<int32> CVarRotationPopularityWindowHours(
+	TEXT("Scenario.Rotation.PopularityWindowHours"),
+	0,
+	TEXT("Popularity-weighted options only count plays and votes from the last this many hours (up to 720), 0 uses all-time totals"));
+
+struct FScenarioStatsPendingLoad
+{
+	struct FResult
+	{
+		TSharedPtr<IScenarioStatsBackend> Backend;
+		FScenarioStatsStore Store;
+		FScenarioAnalytics Analytics;
+		double LoadSeconds = 0.0;
+	};
+
+	TFuture<FResult> Result;
+
+	// Changes made before the load finished, applied again on top of the loaded store
+	TArray<FScenarioStatsDelta> Deltas;
+
+	double StartTime = 0.0;
+	double WaitSeconds = 0.0;
+};
 
 void UScenarioPersistenceManager::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
-	LoadPersistedData();
+
+	// Console variables are read here, the worker only gets plain values
+	const FScenarioStatsFilePaths Paths = FScenarioStatsFilePaths::InDirectory(FPaths::ProjectSavedDir());
+	const FString BackendName = CVarPersistenceBackend.GetValueOnGameThread();
+	const int32 SharedStoreCapacity = CVarPersistenceSharedStoreCapacity.GetValueOnGameThread();
+	const FString RemoteUrl = CVarPersistenceRemoteUrl.GetValueOnGameThread();
+	const bool bWriteBehind = CVarPersistenceWriteBehind.GetValueOnGameThread();
+	AnalyticsPath = Paths.Analytics;
+
+	// Reading and parsing the stats happens on a worker, so it does not hold up game instance startup
+	TSharedRef<TPromise<FScenarioStatsPendingLoad::FResult>> Promise = MakeShared<TPromise<FScenarioStatsPendingLoad::FResult>>();
+	PendingLoad = MakeShared<FScenarioStatsPendingLoad>();
+	PendingLoad->Result = Promise->GetFuture();
+	PendingLoad->StartTime = FPlatformTime::Seconds();
+
+	Async(EAsyncExecution::ThreadPool, [Promise, Paths, BackendName, SharedStoreCapacity, RemoteUrl, bWriteBehind, WeakThis = TWeakObjectPtr<UScenarioPersistenceManager>(this)]()
+	{
+		const double LoadStartTime = FPlatformTime::Seconds();
+		FScenarioStatsPendingLoad::FResult Result;
+
+		if (BackendName == TEXT("shared"))
+		{
+			Result.Backend = MakeShared<FScenarioSharedStatsBackend>(Paths, SharedStoreCapacity);
+		}
+		else if (BackendName == TEXT("remote"))
+		{
+			Result.Backend = MakeShared<FScenarioRemoteStatsBackend>(Paths, RemoteUrl);
+		}
+
+		if (!Result.Backend.IsValid() || !Result.Backend->Load(Result.Store))
+		{
+			if (Result.Backend.IsValid())
+			{
+				UE_LOG(LogScenarioPersistence, Warning, TEXT("Scenario stats backend '%s' is unavailable, using local files"), *BackendName);
+				Result.Store.Reset();
+			}
+			Result.Backend = MakeShared<FScenarioFileStatsBackend>(Paths, bWriteBehind);
+			Result.Backend->Load(Result.Store);
+		}
+
+		TArray<uint8> AnalyticsBytes;
+		FString AnalyticsError;
+		if (FFileHelper::LoadFileToArray(AnalyticsBytes, *Paths.Analytics, FILEREAD_Silent)
+			&& !Result.Analytics.Read(AnalyticsBytes, AnalyticsError))
+		{
+			UE_LOG(LogScenarioPersistence, Warning, TEXT("Starting over with scenario analytics, %s is unreadable: %s"), *Paths.Analytics, *AnalyticsError);
+		}
+
+		Result.LoadSeconds = FPlatformTime::Seconds() - LoadStartTime;
+		Promise->SetValue(MoveTemp(Result));
+
+		// Picked up on the next game thread task even if nothing queries the stats before then
+		AsyncTask(ENamedThreads::GameThread, [WeakThis]()
+		{
+			if (const UScenarioPersistenceManager* Manager = WeakThis.Get())
+			{
+				Manager->FinishLoad(false);
+			}
+		});
+	});
+
+	ShowPlanCommand = IConsoleManager::Get().RegisterConsoleCommand(
+		TEXT("Scenario.Rotation.ShowPlan"),
+		TEXT("Prints the upcoming matches planned by the rotation planner"),
+		FConsoleCommandWithOutputDeviceDelegate::CreateUObject(this, &ThisClass::DumpRotationPlan),
+		ECVF_Default);
+
+	DumpAnalyticsCommand = IConsoleManager::Get().RegisterConsoleCommand(
+		TEXT("Scenario.Analytics.Dump"),
+		TEXT("Prints outcome rates and duration percentiles per scenario, and per stage with the slowest stages first"),
+		FConsoleCommandWithOutputDeviceDelegate::CreateUObject(this, &ThisClass::DumpAnalytics),
+		ECVF_Default);
+
+	OnConsoleVariablesChanged();
+	ConsoleVariableSink = IConsoleManager::Get().RegisterConsoleVariableSink_Handle(
+		FConsoleCommandDelegate::CreateUObject(this, &ThisClass::OnConsoleVariablesChanged));
 }
 
 void UScenarioPersistenceManager::Deinitialize()
 {
-	SavePersistedData();
+	IConsoleManager::Get().UnregisterConsoleVariableSink_Handle(ConsoleVariableSink);
+	IConsoleManager::Get().UnregisterConsoleObject(ShowPlanCommand);
+	ShowPlanCommand = nullptr;
+	IConsoleManager::Get().UnregisterConsoleObject(DumpAnalyticsCommand);
+	DumpAnalyticsCommand = nullptr;
+
+	FinishLoad(true);
+	FlushAnalytics(true);
+	Backend->Shutdown(Store);
+	Backend.Reset();
 	Super::Deinitialize();
 }
 
 void UScenarioPersistenceManager::SaveScenarioStats(const FScenarioStats& Stats)
 {
-	ScenarioStatistics.Add(Stats.ScenarioId, Stats);
-	SavePersistedData();
+	ApplyDelta(FScenarioStatsDelta::MakeStats(Stats));
 }
 
 FScenarioStats UScenarioPersistenceManager::GetScenarioStats(const FPrimaryAssetId& ScenarioId) const
 {
-	if (const FScenarioStats* Stats = ScenarioStatistics.Find(ScenarioId))
+	RefreshFromBackend();
+
+	if (const FScenarioStats* Stats = Store.Stats.Find(ScenarioId))
 	{
 		return *Stats;
 	}
@@ -35,204 +208,648 @@ FScenarioStats UScenarioPersistenceManager::GetScenarioStats(const FPrimaryAsset
 
 void UScenarioPersistenceManager::UpdatePlayCount(const FPrimaryAssetId& ScenarioId)
 {
-	FScenarioStats& Stats = ScenarioStatistics.FindOrAdd(ScenarioId);
-	Stats.ScenarioId = ScenarioId;
-	Stats.TimesPlayed++;
-	Stats.LastPlayed = FDateTime::UtcNow();
+	const FDateTime CurrentTime = FDateTime::UtcNow();
+
+	// The previous scenario ran until this one was picked
+	if (CurrentScenarioId.IsValid())
+	{
+		RecordMatchDuration(CurrentScenarioId, (CurrentTime - CurrentScenarioStartTime).GetTotalSeconds());
+	}
+	CurrentScenarioId = ScenarioId;
+	CurrentScenarioStartTime = CurrentTime;
+	RecentPlays.Add(ScenarioId);
+	CacheScenarioTags(ScenarioId);
+
+	ApplyDelta(FScenarioStatsDelta::MakePlay(ScenarioId, CurrentTime));
 
 	// Update average player count if we have a valid world
 	if (UWorld* World = GetWorld())
 	{
 		if (AGameStateBase* GameState = World->GetGameState())
 		{
-			float CurrentPlayerCount = GameState->PlayerArray.Num();
-			Stats.AveragePlayerCount = ((Stats.AveragePlayerCount * (Stats.TimesPlayed - 1)) + CurrentPlayerCount) / Stats.TimesPlayed;
+			ApplyDelta(FScenarioStatsDelta::MakePlayerCountSample(ScenarioId, GameState->PlayerArray.Num(), CurrentTime));
 		}
 	}
 
-	SavePersistedData();
+	// Plan the following matches while this one runs, rather than at the vote
+	UpdateRotationPlan();
 }
 
-void UScenarioPersistenceManager::SetRotationEntry(const FScenarioRotationEntry& Entry)
+void UScenarioPersistenceManager::RecordVotes(const FPrimaryAssetId& ScenarioId, int32 Votes)
 {
-	// Remove existing entry if present
-	RotationEntries.RemoveAll([&Entry](const FScenarioRotationEntry& ExistingEntry) {
-		return ExistingEntry.ScenarioId == Entry.ScenarioId;
-	});
+	if (Votes > 0)
+	{
+		ApplyDelta(FScenarioStatsDelta::MakeVotes(ScenarioId, Votes, FDateTime::UtcNow()));
+	}
+}
 
-	RotationEntries.Add(Entry);
-	SavePersistedData();
+void UScenarioPersistenceManager::RecordMatchDuration(const FPrimaryAssetId& ScenarioId, float Seconds)
+{
+	if (Seconds > 0.0f)
+	{
+		ApplyDelta(FScenarioStatsDelta::MakeMatchDuration(ScenarioId, Seconds, FDateTime::UtcNow()));
+	}
 }
 
-TArray<FPrimaryAssetId> UScenarioPersistenceManager::GetNextRotationOptions() const
+FScenarioPopularity UScenarioPersistenceManager::GetScenarioPopularity(const FPrimaryAssetId& ScenarioId, int32 Hours) const
 {
-	TArray<FPrimaryAssetId> ValidOptions;
+	RefreshFromBackend();
+
+	if (const FScenarioStatsHistory* History = Store.History.Find(ScenarioId))
+	{
+		return History->GetPopularity(FDateTime::UtcNow(), Hours);
+	}
+	return FScenarioPopularity();
+}
+
+void UScenarioPersistenceManager::SetRotationEntry(const FScenarioRotationEntry& Entry)
+{
+	CacheScenarioTags(Entry.ScenarioId);
+	ApplyDelta(FScenarioStatsDelta::MakeRotationEntry(Entry));
+}
+
+TArray<FPrimaryAssetId> UScenarioPersistenceManager::GetNextRotationOptions(int32 Count, const TArray<FPrimaryAssetId>& Exclude) const
+{
+	RefreshFromBackend();
+
 	const FDateTime CurrentTime = FDateTime::UtcNow();
+	if (bRotationSamplerDirty || CurrentTime >= RotationSamplerValidUntil)
+	{
+		RebuildRotationSampler(CurrentTime);
+	}
+
+	TArray<FPrimaryAssetId> Options;
+	Options.Reserve(Count);
+	RotationSampler.Sample(Count, Exclude, Options);
+	return Options;
+}
+
+void UScenarioPersistenceManager::RebuildRotationSampler(const FDateTime& CurrentTime) const
+{
+	RotationSampler.Reset();
+	RotationSamplerValidUntil = FDateTime::MaxValue();
 
-	// Filter scenarios based on minimum gap and weight
-	for (const FScenarioRotationEntry& Entry : RotationEntries)
+	// Filter scenarios based on minimum gap, and note when the next filtered one becomes eligible
+	for (const FScenarioRotationEntry& Entry : Store.RotationEntries)
 	{
-		if (const FScenarioStats* Stats = ScenarioStatistics.Find(Entry.ScenarioId))
+		// Every play rebuilds the sampler, so match-count cooldowns need no expiry time
+		if (RecentPlays.WasPlayedWithin(Entry.ScenarioId, Entry.MinimumMatchesBetweenPlays))
 		{
-			// Check if enough time has passed since last play
-			FTimespan TimeSinceLastPlay = CurrentTime - Stats->LastPlayed;
-			if (TimeSinceLastPlay.GetDays() >= Entry.MinimumGapBetweenPlays)
-			{
-				// Add scenario multiple times based on weight to influence random selection
-				int32 WeightedCount = FMath::RoundToInt(Entry.Weight * 10.0f);
-				for (int32 i = 0; i < WeightedCount; ++i)
-				{
-					ValidOptions.Add(Entry.ScenarioId);
-				}
-			}
+			continue;
 		}
-		else
+
+		if (const FScenarioStats* Stats = Store.Stats.Find(Entry.ScenarioId))
 		{
-			// If never played, always include
-			ValidOptions.Add(Entry.ScenarioId);
+			const FDateTime EligibleAt = Stats->LastPlayed + FTimespan::FromDays(Entry.MinimumGapBetweenPlays);
+			if (CurrentTime < EligibleAt)
+			{
+				RotationSamplerValidUntil = FMath::Min(RotationSamplerValidUntil, EligibleAt);
+				continue;
+			}
 		}
+
+		RotationSampler.Add(Entry.ScenarioId, Entry.Weight);
 	}
 
-	return ValidOptions;
+	RotationSampler.Build();
+	bRotationSamplerDirty = false;
 }
 
 bool UScenarioPersistenceManager::IsScenarioAllowedInRotation(const FPrimaryAssetId& ScenarioId) const
 {
-	const FDateTime CurrentTime = FDateTime::UtcNow();
+	RefreshFromBackend();
 
-	// Check if scenario is in rotation and meets time requirements
-	for (const FScenarioRotationEntry& Entry : RotationEntries)
+	const FScenarioRotationEntry* Entry = FindRotationEntry(ScenarioId);
+	if (!Entry)
 	{
-		if (Entry.ScenarioId == ScenarioId)
+		return false; // Not in rotation
+	}
+
+	// Check match count and time requirements
+	if (RecentPlays.WasPlayedWithin(ScenarioId, Entry->MinimumMatchesBetweenPlays))
+	{
+		return false;
+	}
+	if (const FScenarioStats* Stats = Store.Stats.Find(ScenarioId))
+	{
+		FTimespan TimeSinceLastPlay = FDateTime::UtcNow() - Stats->LastPlayed;
+		return TimeSinceLastPlay.GetDays() >= Entry->MinimumGapBetweenPlays;
+	}
+	return true; // Never played before, so it's allowed
+}
+
+const FScenarioRotationEntry* UScenarioPersistenceManager::FindRotationEntry(const FPrimaryAssetId& ScenarioId) const
+{
+	if (bRotationEntryIndicesDirty)
+	{
+		RotationEntryIndices.Reset();
+		for (int32 Index = 0; Index < Store.RotationEntries.Num(); ++Index)
 		{
-			if (const FScenarioStats* Stats = ScenarioStatistics.Find(ScenarioId))
-			{
-				FTimespan TimeSinceLastPlay = CurrentTime - Stats->LastPlayed;
-				return TimeSinceLastPlay.GetDays() >= Entry.MinimumGapBetweenPlays;
-			}
-			return true; // Never played before, so it's allowed
+			RotationEntryIndices.Add(Store.RotationEntries[Index].ScenarioId, Index);
 		}
+		bRotationEntryIndicesDirty = false;
 	}
 
-	return false; // Not in rotation
+	const int32* Index = RotationEntryIndices.Find(ScenarioId);
+	return Index ? &Store.RotationEntries[*Index] : nullptr;
 }
 
 TArray<FPrimaryAssetId> UScenarioPersistenceManager::GetWeightedScenarioOptions(int32 Count) const
 {
+	RefreshFromBackend();
+
+	const int32 WindowHours = CVarRotationPopularityWindowHours.GetValueOnGameThread();
+	const FDateTime CurrentTime = FDateTime::UtcNow();
+	if (bPopularityIndexDirty || WindowHours != PopularityIndexWindowHours
+		|| (WindowHours > 0 && FScenarioStatsHistory::GetHourEpoch(CurrentTime) != PopularityIndexHour))
+	{
+		RebuildPopularityIndex(WindowHours, CurrentTime);
+	}
+
+	// Get top Count scenarios
 	TArray<FPrimaryAssetId> WeightedOptions;
-	TArray<TPair<FPrimaryAssetId, float>> ScoredScenarios;
+	PopularityIndex.GetTop(Count, WeightedOptions);
+
+	return WeightedOptions;
+}
 
-	// Calculate scores for each scenario
-	for (const auto& StatPair : ScenarioStatistics)
+void UScenarioPersistenceManager::RebuildPopularityIndex(int32 WindowHours, const FDateTime& CurrentTime) const
+{
+	PopularityIndex.Reset();
+	for (const TPair<FPrimaryAssetId, FScenarioStats>& StatPair : Store.Stats)
 	{
-		const FScenarioStats& Stats = StatPair.Value;
-		float PopularityScore = 0.0f;
+		PopularityIndex.Add(StatPair.Key, GetPopularityScore(StatPair.Value, WindowHours, CurrentTime));
+	}
+	PopularityIndex.Build();
 
-		if (Stats.TimesPlayed > 0)
-		{
-			// Calculate score based on votes per play and average player count
-			float VotesPerPlay = static_cast<float>(Stats.TotalVotes) / Stats.TimesPlayed;
-			PopularityScore = (VotesPerPlay * 0.7f) + (Stats.AveragePlayerCount * 0.3f);
-		}
+	PopularityIndexWindowHours = WindowHours;
+	PopularityIndexHour = FScenarioStatsHistory::GetHourEpoch(CurrentTime);
+	bPopularityIndexDirty = false;
+}
+
+float UScenarioPersistenceManager::GetPopularityScore(const FScenarioStats& Stats, int32 WindowHours, const FDateTime& CurrentTime) const
+{
+	int32 Plays = Stats.TimesPlayed;
+	int32 Votes = Stats.TotalVotes;
+	float AveragePlayerCount = Stats.AveragePlayerCount;
 
-		ScoredScenarios.Add(TPair<FPrimaryAssetId, float>(Stats.ScenarioId, PopularityScore));
+	// Recent activity only, so a scenario that was popular months ago does not stay on top
+	if (WindowHours > 0)
+	{
+		const FScenarioStatsHistory* History = Store.History.Find(Stats.ScenarioId);
+		const FScenarioPopularity Popularity = History ? History->GetPopularity(CurrentTime, WindowHours) : FScenarioPopularity();
+		Plays = Popularity.Plays;
+		Votes = Popularity.Votes;
+		AveragePlayerCount = Popularity.AveragePlayerCount;
 	}
 
-	// Sort by score
-	ScoredScenarios.Sort([](const TPair<FPrimaryAssetId, float>& A, const TPair<FPrimaryAssetId, float>& B) {
-		return A.Value > B.Value;
-	});
+	float PopularityScore = 0.0f;
+	if (Plays > 0)
+	{
+		// Calculate score based on votes per play and average player count
+		float VotesPerPlay = static_cast<float>(Votes) / Plays;
+		PopularityScore = (VotesPerPlay * 0.7f) + (AveragePlayerCount * 0.3f);
+	}
+	return PopularityScore;
+}
 
-	// Get top Count scenarios
-	for (int32 i = 0; i < FMath::Min(Count, ScoredScenarios.Num()); ++i)
+bool UScenarioPersistenceManager::GetPlannedRotationOptions(int32 Count, TArray<FPrimaryAssetId>& OutOptions) const
+{
+	OutOptions.Reset();
+	UpdateRotationPlan();
+
+	if (CVarRotationPlanSlots.GetValueOnGameThread() <= 0 || RotationPlan.Slots.IsEmpty())
 	{
-		WeightedOptions.Add(ScoredScenarios[i].Key);
+		return false;
 	}
 
-	return WeightedOptions;
+	const TArray<FPrimaryAssetId>& Options = RotationPlan.Slots[0].Options;
+	OutOptions.Append(Options.GetData(), FMath::Min(Count, Options.Num()));
+	return !OutOptions.IsEmpty();
 }
 
-void UScenarioPersistenceManager::LoadPersistedData()
+void UScenarioPersistenceManager::UpdateRotationPlan() const
 {
-	FString SaveFilePath = GetSaveFilePath();
-	FString JsonString;
+	const int32 NumSlots = CVarRotationPlanSlots.GetValueOnGameThread();
+	if (NumSlots <= 0)
+	{
+		return;
+	}
 
-	if (FFileHelper::LoadFileToString(JsonString, *SaveFilePath))
+	if (PendingRotationPlan.IsValid())
 	{
-		TSharedPtr<FJsonObject> JsonObject;
-		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+		if (!PendingRotationPlan.IsReady())
+		{
+			return;
+		}
 
-		if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+		// A play or rotation change while the worker ran makes its plan stale, plan again below
+		FScenarioRotationPlan Plan = PendingRotationPlan.Consume();
+		if (Plan.Generation == RotationPlanGeneration)
 		{
-			// Load scenario statistics
-			const TArray<TSharedPtr<FJsonValue>>* StatsArray;
-			if (JsonObject->TryGetArrayField(TEXT("ScenarioStats"), StatsArray))
+			RotationPlan = MoveTemp(Plan);
+			UE_LOG(LogScenarioPersistence, Verbose, TEXT("Planned %d rotation slots in %.2fms"), RotationPlan.Slots.Num(), RotationPlan.PlanSeconds * 1000.0);
+		}
+	}
+
+	if (RotationPlan.Slots.Num() == NumSlots || !FinishLoad(false))
+	{
+		return;
+	}
+
+	FScenarioRotationPlanInput Input;
+	Input.NumSlots = NumSlots;
+	Input.NumOptions = FMath::Max(1, CVarRotationPlanOptions.GetValueOnGameThread());
+	Input.DiversityMatches = FMath::Max(0, CVarRotationPlanDiversityMatches.GetValueOnGameThread());
+	Input.MatchLength = FTimespan::FromMinutes(FMath::Max(1.0f, CVarRotationPlanMatchMinutes.GetValueOnGameThread()));
+	Input.Seed = FMath::Rand();
+	Input.Generation = RotationPlanGeneration;
+	Input.KeepSlots = RotationPlan.Slots;
+	if (Input.KeepSlots.Num() > NumSlots)
+	{
+		Input.KeepSlots.SetNum(NumSlots);
+	}
+
+	// The next vote happens when the current match is expected to end
+	const FDateTime CurrentTime = FDateTime::UtcNow();
+	Input.FirstVoteTime = CurrentScenarioId.IsValid() ? FMath::Max(CurrentTime, CurrentScenarioStartTime + Input.MatchLength) : CurrentTime;
+
+	const int32 NumRecent = RotationDiversityRoots.IsEmpty() ? 0 : FMath::Min(Input.DiversityMatches, RecentPlays.Num());
+	for (int32 MatchesAgo = 0; MatchesAgo < NumRecent; ++MatchesAgo)
+	{
+		Input.RecentDiversityTags.Add(ScenarioTagCache.FindRef(RecentPlays.GetRecent(MatchesAgo)).Filter(RotationDiversityRoots));
+	}
+
+	if (bRotationPlanCandidatesDirty)
+	{
+		RotationPlanCandidates.Reset(Store.RotationEntries.Num());
+		for (const FScenarioRotationEntry& Entry : Store.RotationEntries)
+		{
+			FScenarioRotationPlanCandidate& Candidate = RotationPlanCandidates.AddDefaulted_GetRef();
+			Candidate.ScenarioId = Entry.ScenarioId;
+			Candidate.Weight = Entry.Weight;
+			Candidate.MinimumMatchesBetweenPlays = Entry.MinimumMatchesBetweenPlays;
+			Candidate.MinimumGap = FTimespan::FromDays(Entry.MinimumGapBetweenPlays);
+			if (!RotationDiversityRoots.IsEmpty())
 			{
-				for (const auto& JsonValue : *StatsArray)
-				{
-					FScenarioStats Stats;
-					if (FJsonObjectConverter::JsonObjectToUStruct(JsonValue->AsObject().ToSharedRef(), &Stats))
-					{
-						ScenarioStatistics.Add(Stats.ScenarioId, Stats);
-					}
-				}
+				Candidate.DiversityTags = ScenarioTagCache.FindRef(Entry.ScenarioId).Filter(RotationDiversityRoots);
 			}
+		}
+		bRotationPlanCandidatesDirty = false;
+	}
+
+	int32 NumPlayers = 0;
+	if (UWorld* World = GetWorld())
+	{
+		if (AGameStateBase* GameState = World->GetGameState())
+		{
+			NumPlayers = GameState->PlayerArray.Num();
+		}
+	}
+	const float PlayerCountStrength = CVarRotationPlanPlayerCountStrength.GetValueOnGameThread();
 
-			// Load rotation entries
-			const TArray<TSharedPtr<FJsonValue>>* RotationArray;
-			if (JsonObject->TryGetArrayField(TEXT("RotationEntries"), RotationArray))
+	// The worker gets its own copy, only play history and player counts are filled in per plan
+	Input.Candidates = RotationPlanCandidates;
+	for (FScenarioRotationPlanCandidate& Candidate : Input.Candidates)
+	{
+		Candidate.MatchesSinceLastPlay = RecentPlays.GetMatchesSince(Candidate.ScenarioId);
+
+		if (const FScenarioStats* Stats = Store.Stats.Find(Candidate.ScenarioId))
+		{
+			Candidate.LastPlayed = Stats->LastPlayed;
+
+			// Scenarios usually played with far more or fewer players than are here now are offered less often
+			if (NumPlayers > 0 && Stats->AveragePlayerCount > 0.0f && PlayerCountStrength > 0.0f)
 			{
-				for (const auto& JsonValue : *RotationArray)
-				{
-					FScenarioRotationEntry Entry;
-					if (FJsonObjectConverter::JsonObjectToUStruct(JsonValue->AsObject().ToSharedRef(), &Entry))
-					{
-						RotationEntries.Add(Entry);
-					}
-				}
+				const float Suitability = FMath::Min<float>(NumPlayers, Stats->AveragePlayerCount) / FMath::Max<float>(NumPlayers, Stats->AveragePlayerCount);
+				Candidate.Weight *= FMath::Pow(Suitability, PlayerCountStrength);
 			}
 		}
 	}
+
+	PendingRotationPlan = Async(EAsyncExecution::ThreadPool, [Input = MoveTemp(Input)]()
+	{
+		return FScenarioRotationPlanner::Plan(Input);
+	});
 }
 
-void UScenarioPersistenceManager::SavePersistedData()
+void UScenarioPersistenceManager::InvalidateRotationPlan(const FPrimaryAssetId& PlayedScenarioId) const
 {
-	TSharedPtr<FJsonObject> JsonObject = MakeShared<FJsonObject>();
-    
-	// Save scenario statistics
-	TArray<TSharedPtr<FJsonValue>> StatsArray;
-	for (const auto& StatPair : ScenarioStatistics)
+	// Later slots assumed the first option of the first slot wins, so only that play keeps them valid
+	if (PlayedScenarioId.IsValid() && !RotationPlan.Slots.IsEmpty()
+		&& !RotationPlan.Slots[0].Options.IsEmpty() && RotationPlan.Slots[0].Options[0] == PlayedScenarioId)
+	{
+		RotationPlan.Slots.RemoveAt(0);
+	}
+	else
+	{
+		RotationPlan.Slots.Reset();
+	}
+	++RotationPlanGeneration;
+}
+
+void UScenarioPersistenceManager::OnConsoleVariablesChanged()
+{
+	// Sinks run after any console variable changes, so most calls find the roots unchanged
+	const FString RootNames = CVarRotationPlanDiversityTags.GetValueOnGameThread();
+	if (RootNames == RotationDiversityRootNames)
+	{
+		return;
+	}
+	RotationDiversityRootNames = RootNames;
+
+	RotationDiversityRoots.Reset();
+	TArray<FString> Names;
+	RootNames.ParseIntoArray(Names, TEXT(","));
+	for (const FString& Name : Names)
 	{
-		TSharedPtr<FJsonObject> StatObject = MakeShared<FJsonObject>();
-		if (FJsonObjectConverter::UStructToJsonObject(FScenarioStats::StaticStruct(), &StatPair.Value, StatObject.ToSharedRef(), 0, 0))
+		const FGameplayTag Root = FGameplayTag::RequestGameplayTag(FName(*Name.TrimStartAndEnd()), false);
+		if (Root.IsValid())
 		{
-			StatsArray.Add(MakeShared<FJsonValueObject>(StatObject));
+			RotationDiversityRoots.AddTag(Root);
 		}
 	}
-	JsonObject->SetArrayField(TEXT("ScenarioStats"), StatsArray);
 
-	// Save rotation entries
-	TArray<TSharedPtr<FJsonValue>> RotationArray;
-	for (const auto& Entry : RotationEntries)
+	bRotationPlanCandidatesDirty = true;
+	InvalidateRotationPlan();
+}
+
+void UScenarioPersistenceManager::CacheScenarioTags(const FPrimaryAssetId& ScenarioId) const
+{
+	if (!ScenarioId.IsValid() || ScenarioTagCache.Contains(ScenarioId))
+	{
+		return;
+	}
+
+	FGameplayTagContainer Tags;
+	if (UAssetManager::IsInitialized())
 	{
-		TSharedPtr<FJsonObject> EntryObject = MakeShared<FJsonObject>();
-		if (FJsonObjectConverter::UStructToJsonObject(FScenarioRotationEntry::StaticStruct(), &Entry, EntryObject.ToSharedRef(), 0, 0))
+		UAssetManager& AssetManager = UAssetManager::Get();
+		if (const UGameplayScenario* Scenario = AssetManager.GetPrimaryAssetObject<UGameplayScenario>(ScenarioId))
+		{
+			Tags = Scenario->ScenarioTags;
+		}
+		else
 		{
-			RotationArray.Add(MakeShared<FJsonValueObject>(EntryObject));
+			// Read the tags from the asset registry rather than loading every scenario in the rotation
+			FAssetData AssetData;
+			FString TagString;
+			if (AssetManager.GetPrimaryAssetData(ScenarioId, AssetData)
+				&& AssetData.GetTagValue(GET_MEMBER_NAME_CHECKED(UGameplayScenario, ScenarioTags), TagString))
+			{
+				Tags.FromExportString(TagString);
+			}
 		}
 	}
-	JsonObject->SetArrayField(TEXT("RotationEntries"), RotationArray);
 
-	// Save to file
-	FString JsonString;
-	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&JsonString);
-	if (FJsonSerializer::Serialize(JsonObject.ToSharedRef(), Writer))
+	ScenarioTagCache.Add(ScenarioId, Tags);
+}
+
+void UScenarioPersistenceManager::CacheRotationScenarioTags() const
+{
+	for (const FScenarioRotationEntry& Entry : Store.RotationEntries)
+	{
+		CacheScenarioTags(Entry.ScenarioId);
+	}
+}
+
+void UScenarioPersistenceManager::DumpRotationPlan(FOutputDevice& Ar) const
+{
+	if (CVarRotationPlanSlots.GetValueOnGameThread() <= 0)
 	{
-		FFileHelper::SaveStringToFile(JsonString, *GetSaveFilePath());
+		Ar.Logf(TEXT("Rotation planning is off, set Scenario.Rotation.Plan.Slots to plan ahead"));
+		return;
+	}
+
+	UpdateRotationPlan();
+	Ar.Logf(TEXT("Rotation plan: %d slots, generation %u, planned in %.2fms%s"),
+		RotationPlan.Slots.Num(), RotationPlanGeneration, RotationPlan.PlanSeconds * 1000.0,
+		PendingRotationPlan.IsValid() ? TEXT(", planning more") : TEXT(""));
+
+	for (int32 SlotIndex = 0; SlotIndex < RotationPlan.Slots.Num(); ++SlotIndex)
+	{
+		const FScenarioRotationPlanSlot& Slot = RotationPlan.Slots[SlotIndex];
+		Ar.Logf(TEXT("  %d. vote at %s: %s"), SlotIndex + 1, *Slot.VoteTime.ToString(),
+			*FString::JoinBy(Slot.Options, TEXT(", "), [](const FPrimaryAssetId& ScenarioId) { return ScenarioId.ToString(); }));
 	}
 }
 
-FString UScenarioPersistenceManager::GetSaveFilePath() const
+void UScenarioPersistenceManager::RecordScenarioOutcome(const FPrimaryAssetId& ScenarioId, EScenarioOutcome Outcome, float Seconds)
 {
-	return FPaths::ProjectSavedDir() / TEXT("ScenarioStats.json");
+	Analytics.RecordRun(ScenarioId, Outcome, Seconds);
+	bAnalyticsDirty = true;
+	FlushAnalytics(false);
+}
+
+void UScenarioPersistenceManager::RecordStageOutcome(const FPrimaryAssetId& ScenarioId, FName StageName, EScenarioOutcome Outcome, float Seconds)
+{
+	// Written out with the next scenario run, stages end far more often than runs
+	Analytics.RecordStage(ScenarioId, StageName, Outcome, Seconds);
+	bAnalyticsDirty = true;
+}
+
+const FScenarioAnalytics& UScenarioPersistenceManager::GetAnalytics() const
+{
+	FinishLoad(CVarPersistenceWaitForLoad.GetValueOnGameThread());
+	return Analytics;
+}
+
+void UScenarioPersistenceManager::FlushAnalytics(bool bWait)
+{
+	if (PendingAnalyticsWrite.IsValid())
+	{
+		if (!bWait && !PendingAnalyticsWrite.IsReady())
+		{
+			return;
+		}
+		PendingAnalyticsWrite.Wait();
+		PendingAnalyticsWrite.Reset();
+	}
+
+	// Writing before the saved analytics are loaded would replace them
+	if (!bAnalyticsDirty || PendingLoad.IsValid())
+	{
+		return;
+	}
+	bAnalyticsDirty = false;
+
+	// The copy is the only game thread cost; encoding and the temp file and rename happen on the worker
+	PendingAnalyticsWrite = Async(EAsyncExecution::ThreadPool, [Snapshot = Analytics, Path = AnalyticsPath]()
+	{
+		TArray<uint8> Bytes;
+		Snapshot.Write(Bytes);
+		if (!FScenarioPersistenceWriter::WriteFileAtomic(Path, Bytes))
+		{
+			UE_LOG(LogScenarioPersistence, Warning, TEXT("Failed to write scenario analytics to %s"), *Path);
+		}
+	});
+
+	if (bWait)
+	{
+		PendingAnalyticsWrite.Wait();
+		PendingAnalyticsWrite.Reset();
+	}
+}
+
+void UScenarioPersistenceManager::DumpAnalytics(FOutputDevice& Ar) const
+{
+	auto Describe = [](const FScenarioOutcomeStats& Stats)
+	{
+		const float Percent = 100.0f / FMath::Max<uint32>(Stats.GetTotal(), 1);
+		return FString::Printf(TEXT("%u ended, %.0f%% success, %.0f%% failure, %.0f%% cancelled, p50 %.1fs, p90 %.1fs, p99 %.1fs, max %.1fs"),
+			Stats.GetTotal(), Stats.Successes * Percent, Stats.Failures * Percent, Stats.Cancellations * Percent,
+			Stats.Durations.GetPercentile(50.0f), Stats.Durations.GetPercentile(90.0f), Stats.Durations.GetPercentile(99.0f),
+			Stats.Durations.MaxMilliseconds / 1000.0f);
+	};
+
+	for (const TPair<FPrimaryAssetId, FScenarioAnalyticsEntry>& Pair : GetAnalytics().Scenarios)
+	{
+		Ar.Logf(TEXT("%s: %s"), *Pair.Key.ToString(), *Describe(Pair.Value.Runs));
+
+		TArray<TPair<FName, const FScenarioOutcomeStats*>> Stages;
+		for (const TPair<FName, FScenarioOutcomeStats>& Stage : Pair.Value.Stages)
+		{
+			Stages.Emplace(Stage.Key, &Stage.Value);
+		}
+		Stages.Sort([](const TPair<FName, const FScenarioOutcomeStats*>& A, const TPair<FName, const FScenarioOutcomeStats*>& B)
+		{
+			return A.Value->Durations.GetPercentile(90.0f) > B.Value->Durations.GetPercentile(90.0f);
+		});
+		for (const TPair<FName, const FScenarioOutcomeStats*>& Stage : Stages)
+		{
+			Ar.Logf(TEXT("  %s: %s"), *Stage.Key.ToString(), *Describe(*Stage.Value));
+		}
+	}
+}
+
+void UScenarioPersistenceManager::ApplyDelta(const FScenarioStatsDelta& Delta)
+{
+	const bool bLoaded = FinishLoad(false);
+	Delta.Apply(Store);
+	if (bLoaded)
+	{
+		Backend->Apply(Delta);
+	}
+	else
+	{
+		PendingLoad->Deltas.Add(Delta);
+	}
+
+	// Only the changed scenario moves in the popularity order
+	if (!bPopularityIndexDirty && Delta.Kind != EScenarioStatsDeltaKind::RotationEntry && Delta.Kind != EScenarioStatsDeltaKind::MatchDuration)
+	{
+		if (const FScenarioStats* Stats = Store.Stats.Find(Delta.ScenarioId))
+		{
+			PopularityIndex.Update(Delta.ScenarioId, GetPopularityScore(*Stats, PopularityIndexWindowHours, FDateTime::UtcNow()));
+		}
+	}
+
+	if (Delta.Kind == EScenarioStatsDeltaKind::RotationEntry)
+	{
+		bRotationEntryIndicesDirty = true;
+		bRotationPlanCandidatesDirty = true;
+		InvalidateRotationPlan();
+	}
+	else if (Delta.Kind == EScenarioStatsDeltaKind::Play)
+	{
+		InvalidateRotationPlan(Delta.ScenarioId);
+	}
+
+	// Votes, player counts and durations do not affect rotation eligibility or weights
+	if (Delta.Kind != EScenarioStatsDeltaKind::Votes && Delta.Kind != EScenarioStatsDeltaKind::PlayerCountSample
+		&& Delta.Kind != EScenarioStatsDeltaKind::MatchDuration)
+	{
+		bRotationSamplerDirty = true;
+	}
+}
+
+void UScenarioPersistenceManager::RefreshFromBackend() const
+{
+	if (FinishLoad(CVarPersistenceWaitForLoad.GetValueOnGameThread()) && Backend->Refresh(Store))
+	{
+		bRotationSamplerDirty = true;
+		bRotationEntryIndicesDirty = true;
+		bRotationPlanCandidatesDirty = true;
+		bPopularityIndexDirty = true;
+
+		// Other servers may have added rotation entries
+		CacheRotationScenarioTags();
+	}
+}
+
+bool UScenarioPersistenceManager::FinishLoad(bool bWait) const
+{
+	if (!PendingLoad.IsValid())
+	{
+		return true;
+	}
+
+	if (!PendingLoad->Result.IsReady())
+	{
+		if (!bWait)
+		{
+			return false;
+		}
+
+		const double WaitStartTime = FPlatformTime::Seconds();
+		PendingLoad->Result.Wait();
+		PendingLoad->WaitSeconds = FPlatformTime::Seconds() - WaitStartTime;
+	}
+
+	// Cleared first, so the deltas replayed below go straight to the backend
+	const TSharedPtr<FScenarioStatsPendingLoad> Load = MoveTemp(PendingLoad);
+	FScenarioStatsPendingLoad::FResult Result = Load->Result.Consume();
+
+	Backend = MoveTemp(Result.Backend);
+	Store = MoveTemp(Result.Store);
+
+	// Outcomes recorded while loading are added to the saved ones
+	Result.Analytics.Merge(Analytics);
+	Analytics = MoveTemp(Result.Analytics);
+	Backend->Start();
+
+	// Recent plays are not stored, so a restart rebuilds them from last played times. Other
+	// servers sharing the backend count as well, and repeat plays of one scenario are lost.
+	TArray<const FScenarioStats*> PlayedStats;
+	for (const TPair<FPrimaryAssetId, FScenarioStats>& StatPair : Store.Stats)
+	{
+		if (StatPair.Value.LastPlayed.GetTicks() > 0)
+		{
+			PlayedStats.Add(&StatPair.Value);
+		}
+	}
+	PlayedStats.Sort([](const FScenarioStats& A, const FScenarioStats& B) { return A.LastPlayed < B.LastPlayed; });
+	RecentPlays.Reset();
+	for (int32 Index = FMath::Max(PlayedStats.Num() - FScenarioRecentPlays::Capacity, 0); Index < PlayedStats.Num(); ++Index)
+	{
+		RecentPlays.Add(PlayedStats[Index]->ScenarioId);
+	}
+
+	for (const FScenarioStatsDelta& Delta : Load->Deltas)
+	{
+		Delta.Apply(Store);
+		Backend->Apply(Delta);
+		if (Delta.Kind == EScenarioStatsDeltaKind::Play)
+		{
+			RecentPlays.Add(Delta.ScenarioId);
+		}
+	}
+	bRotationSamplerDirty = true;
+	bRotationEntryIndicesDirty = true;
+	bRotationPlanCandidatesDirty = true;
+	bPopularityIndexDirty = true;
+
+	// Read every rotation scenario's tags once now, rather than when the planner first needs them
+	CacheRotationScenarioTags();
+	for (int32 MatchesAgo = 0; MatchesAgo < RecentPlays.Num(); ++MatchesAgo)
+	{
+		CacheScenarioTags(RecentPlays.GetRecent(MatchesAgo));
+	}
+	InvalidateRotationPlan();
+	UpdateRotationPlan();
+
+	// LoadSeconds minus WaitSeconds is the startup time the game thread did not spend loading
+	UE_LOG(LogScenarioPersistence, Log, TEXT("Loaded %d scenario stats in %.2fms off the game thread, ready %.2fms after Initialize, game thread waited %.2fms, %d changes replayed"),
+		Store.Stats.Num(), Result.LoadSeconds * 1000.0, (FPlatformTime::Seconds() - Load->StartTime) * 1000.0, Load->WaitSeconds * 1000.0, Load->Deltas.Num());
+	return true;
 }
@@ -0,0 +1,256 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioPersistenceWriter.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/FileHelper.h"
+#include "ScenarioPersistenceLog.h"
+#include "ScenarioStatsFile.h"
+
+static TAutoConsoleVariable<float> CVarPersistenceDebounceSeconds(
+	TEXT("Scenario.Persistence.DebounceSeconds"),
+	2.0f,
+	TEXT("How long scenario stats must stay unchanged before the background writer appends them to the journal"));
+
+static TAutoConsoleVariable<float> CVarPersistenceMaxDelaySeconds(
+	TEXT("Scenario.Persistence.MaxDelaySeconds"),
+	10.0f,
+	TEXT("Longest time changed scenario stats wait before being saved, even if they keep changing"));
+
+static TAutoConsoleVariable<int32> CVarPersistenceJournalCompactBytes(
+	TEXT("Scenario.Persistence.JournalCompactBytes"),
+	256 * 1024,
+	TEXT("Journal size at which the background writer folds it into the scenario stats snapshot"));
+
+FScenarioPersistenceWriter::FScenarioPersistenceWriter(const FString& InSnapshotPath, const FString& InJournalPath, const FScenarioStatsStore& InStore, uint64 InLastSequence, bool bBackgroundThread)
+	: SnapshotPath(InSnapshotPath)
+	, JournalPath(InJournalPath)
+	, Store(InStore)
+	, LastSequence(InLastSequence)
+{
+	// Records left over from an earlier run (possibly with a torn tail) are folded in before appending
+	bCompactPending = IFileManager::Get().FileSize(*JournalPath) > 0;
+
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	FlushedEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	if (bBackgroundThread)
+	{
+		Thread = FRunnableThread::Create(this, TEXT("ScenarioPersistenceWriter"), 0, TPri_BelowNormal);
+	}
+}
+
+FScenarioPersistenceWriter::~FScenarioPersistenceWriter()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	else
+	{
+		// No worker, finish on the calling thread
+		DrainQueue();
+		WritePending();
+		if (JournalSize > 0 || bCompactPending)
+		{
+			Compact();
+		}
+	}
+
+	JournalHandle.Reset();
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	FPlatformProcess::ReturnSynchEventToPool(FlushedEvent);
+}
+
+void FScenarioPersistenceWriter::Enqueue(const FScenarioStatsDelta& Delta)
+{
+	PendingDeltas.Enqueue(Delta);
+	if (Thread)
+	{
+		WakeEvent->Trigger();
+	}
+	else
+	{
+		Flush();
+	}
+}
+
+void FScenarioPersistenceWriter::Flush()
+{
+	if (!Thread)
+	{
+		if (DrainQueue() || bCompactPending)
+		{
+			WritePending();
+		}
+		return;
+	}
+
+	const int32 Request = ++FlushRequested;
+	WakeEvent->Trigger();
+	while (FlushCompleted.load() < Request)
+	{
+		FlushedEvent->Wait(100);
+	}
+}
+
+uint32 FScenarioPersistenceWriter::Run()
+{
+	bool bDirty = false;
+	double FirstChangeTime = 0.0;
+	double LastChangeTime = 0.0;
+
+	if (bCompactPending)
+	{
+		Compact();
+	}
+
+	while (!bStopping.load())
+	{
+		uint32 WaitMs = 1000;
+		if (bDirty)
+		{
+			const double Now = FPlatformTime::Seconds();
+			const double WriteTime = FMath::Min(LastChangeTime + CVarPersistenceDebounceSeconds.GetValueOnAnyThread(), FirstChangeTime + CVarPersistenceMaxDelaySeconds.GetValueOnAnyThread());
+			WaitMs = static_cast<uint32>(FMath::Clamp((WriteTime - Now) * 1000.0, 0.0, 1000.0));
+		}
+		WakeEvent->Wait(WaitMs);
+
+		// Read the request before draining, so every delta queued ahead of it is part of this write
+		const int32 FlushTarget = FlushRequested.load();
+
+		if (DrainQueue())
+		{
+			LastChangeTime = FPlatformTime::Seconds();
+			if (!bDirty)
+			{
+				FirstChangeTime = LastChangeTime;
+				bDirty = true;
+			}
+		}
+
+		const double Now = FPlatformTime::Seconds();
+		const bool bFlushRequested = FlushTarget != FlushCompleted.load();
+		if (bDirty && (bFlushRequested
+			|| Now - LastChangeTime >= CVarPersistenceDebounceSeconds.GetValueOnAnyThread()
+			|| Now - FirstChangeTime >= CVarPersistenceMaxDelaySeconds.GetValueOnAnyThread()))
+		{
+			WritePending();
+			bDirty = false;
+		}
+
+		if (bFlushRequested)
+		{
+			FlushCompleted.store(FlushTarget);
+			FlushedEvent->Trigger();
+		}
+	}
+
+	// Final write of whatever is still pending, leaving a compacted snapshot for the next run
+	DrainQueue();
+	WritePending();
+	if (JournalSize > 0)
+	{
+		Compact();
+	}
+	FlushCompleted.store(FlushRequested.load());
+	FlushedEvent->Trigger();
+
+	return 0;
+}
+
+void FScenarioPersistenceWriter::Stop()
+{
+	bStopping.store(true);
+	WakeEvent->Trigger();
+}
+
+bool FScenarioPersistenceWriter::DrainQueue()
+{
+	bool bAnyDeltas = false;
+	FScenarioStatsDelta Delta;
+	while (PendingDeltas.Dequeue(Delta))
+	{
+		bAnyDeltas = true;
+		Delta.Apply(Store);
+		FScenarioStatsFile::AppendJournalRecord(Delta, ++LastSequence, PendingJournalBytes);
+	}
+	return bAnyDeltas;
+}
+
+void FScenarioPersistenceWriter::WritePending()
+{
+	if (bCompactPending)
+	{
+		Compact();
+		return;
+	}
+
+	if (PendingJournalBytes.Num() == 0)
+	{
+		return;
+	}
+
+	if (!JournalHandle.IsValid())
+	{
+		JournalHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*JournalPath, true));
+	}
+
+	if (JournalHandle.IsValid() && JournalHandle->Write(PendingJournalBytes.GetData(), PendingJournalBytes.Num()) && JournalHandle->Flush())
+	{
+		JournalSize += PendingJournalBytes.Num();
+		PendingJournalBytes.Reset();
+	}
+	else
+	{
+		// The records are still in the worker's copy, so a snapshot captures them
+		UE_LOG(LogScenarioPersistence, Warning, TEXT("Failed to append to %s, compacting instead"), *JournalPath);
+		JournalHandle.Reset();
+		Compact();
+		return;
+	}
+
+	if (JournalSize >= CVarPersistenceJournalCompactBytes.GetValueOnAnyThread())
+	{
+		Compact();
+	}
+}
+
+void FScenarioPersistenceWriter::Compact()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	FScenarioStatsFile::Write(Store, LastSequence, SnapshotBuffer);
+	if (!WriteFileAtomic(SnapshotPath, SnapshotBuffer))
+	{
+		// Keep the journal, it is still the only record of these changes
+		UE_LOG(LogScenarioPersistence, Warning, TEXT("Failed to save scenario stats to %s"), *SnapshotPath);
+		return;
+	}
+
+	// The snapshot now covers every sequence in the journal, so even if deleting it fails the records are skipped on replay
+	JournalHandle.Reset();
+	IFileManager::Get().Delete(*JournalPath, false, true, true);
+	JournalSize = 0;
+	PendingJournalBytes.Reset();
+	bCompactPending = false;
+
+	UE_LOG(LogScenarioPersistence, Verbose, TEXT("Compacted %d scenario stats (%d bytes) into %s in %.2fms"), Store.Stats.Num(), SnapshotBuffer.Num(), *SnapshotPath, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+bool FScenarioPersistenceWriter::WriteFileAtomic(const FString& InFilePath, const TArray<uint8>& Contents)
+{
+	// Per-process temp name, several server processes on one host may save the same file
+	const FString TempPath = FString::Printf(TEXT("%s.%u.tmp"), *InFilePath, FPlatformProcess::GetCurrentProcessId());
+	if (!FFileHelper::SaveArrayToFile(Contents, *TempPath))
+	{
+		return false;
+	}
+
+	// Same directory, so this is a rename and readers see either the old or the new file
+	return IFileManager::Get().Move(*InFilePath, *TempPath, true, true);
+}
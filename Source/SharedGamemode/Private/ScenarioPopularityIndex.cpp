@@ -0,0 +1,109 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioPopularityIndex.h"
+
+void FScenarioPopularityIndex::Reset()
+{
+	Entries.Reset();
+	Keys.Reset();
+	NextOrder = 0;
+}
+
+void FScenarioPopularityIndex::Add(const FPrimaryAssetId& ScenarioId, float Score)
+{
+	FKey& Key = Keys.Add(ScenarioId);
+	Key.Score = Score;
+	Key.Order = NextOrder++;
+	Entries.Add(FEntry{ ScenarioId, Key });
+}
+
+void FScenarioPopularityIndex::Build()
+{
+	Entries.Sort([](const FEntry& A, const FEntry& B) { return Precedes(A.Key, B.Key); });
+}
+
+void FScenarioPopularityIndex::Update(const FPrimaryAssetId& ScenarioId, float Score)
+{
+	FKey* Key = Keys.Find(ScenarioId);
+	if (!Key)
+	{
+		FKey& NewKey = Keys.Add(ScenarioId);
+		NewKey.Score = Score;
+		NewKey.Order = NextOrder++;
+		Entries.Insert(FEntry{ ScenarioId, NewKey }, LowerBound(0, Entries.Num(), NewKey));
+		return;
+	}
+
+	if (Key->Score == Score)
+	{
+		return;
+	}
+
+	const int32 OldIndex = LowerBound(0, Entries.Num(), *Key);
+	check(Entries.IsValidIndex(OldIndex) && Entries[OldIndex].ScenarioId == ScenarioId);
+
+	Key->Score = Score;
+	const FEntry Moved{ ScenarioId, *Key };
+
+	// Shift only the entries the moved one passes
+	int32 NewIndex = OldIndex;
+	if (Precedes(*Key, Entries[OldIndex].Key))
+	{
+		NewIndex = LowerBound(0, OldIndex, *Key);
+		for (int32 Index = OldIndex; Index > NewIndex; --Index)
+		{
+			Entries[Index] = Entries[Index - 1];
+		}
+	}
+	else
+	{
+		NewIndex = LowerBound(OldIndex + 1, Entries.Num(), *Key) - 1;
+		for (int32 Index = OldIndex; Index < NewIndex; ++Index)
+		{
+			Entries[Index] = Entries[Index + 1];
+		}
+	}
+	Entries[NewIndex] = Moved;
+}
+
+void FScenarioPopularityIndex::Remove(const FPrimaryAssetId& ScenarioId)
+{
+	FKey Key;
+	if (Keys.RemoveAndCopyValue(ScenarioId, Key))
+	{
+		Entries.RemoveAt(LowerBound(0, Entries.Num(), Key), 1, EAllowShrinking::No);
+	}
+}
+
+void FScenarioPopularityIndex::GetTop(int32 Count, TArray<FPrimaryAssetId>& OutIds) const
+{
+	const int32 NumTop = FMath::Min(Count, Entries.Num());
+	OutIds.Reserve(OutIds.Num() + NumTop);
+	for (int32 Index = 0; Index < NumTop; ++Index)
+	{
+		OutIds.Add(Entries[Index].ScenarioId);
+	}
+}
+
+bool FScenarioPopularityIndex::Precedes(const FKey& A, const FKey& B)
+{
+	return A.Score > B.Score || (A.Score == B.Score && A.Order < B.Order);
+}
+
+int32 FScenarioPopularityIndex::LowerBound(int32 Begin, int32 End, const FKey& Key) const
+{
+	while (Begin < End)
+	{
+		const int32 Middle = Begin + (End - Begin) / 2;
+		if (Precedes(Entries[Middle].Key, Key))
+		{
+			Begin = Middle + 1;
+		}
+		else
+		{
+			End = Middle;
+		}
+	}
+	return Begin;
+}
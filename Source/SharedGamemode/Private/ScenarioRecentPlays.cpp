@@ -0,0 +1,52 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioRecentPlays.h"
+
+void FScenarioRecentPlays::Reset()
+{
+	for (FPrimaryAssetId& ScenarioId : Ring)
+	{
+		ScenarioId = FPrimaryAssetId();
+	}
+	NumPlays = 0;
+	LastPlayNumbers.Reset();
+}
+
+void FScenarioRecentPlays::Add(const FPrimaryAssetId& ScenarioId)
+{
+	FPrimaryAssetId& Slot = Ring[NumPlays % Capacity];
+
+	// The overwritten play leaves the window; forget its scenario unless it was played again since
+	if (NumPlays >= Capacity)
+	{
+		const int64 OverwrittenPlay = NumPlays - Capacity;
+		const int64* LastPlay = LastPlayNumbers.Find(Slot);
+		if (LastPlay && *LastPlay == OverwrittenPlay)
+		{
+			LastPlayNumbers.Remove(Slot);
+		}
+	}
+
+	Slot = ScenarioId;
+	LastPlayNumbers.Add(ScenarioId, NumPlays);
+	++NumPlays;
+}
+
+int32 FScenarioRecentPlays::GetMatchesSince(const FPrimaryAssetId& ScenarioId) const
+{
+	const int64* LastPlay = LastPlayNumbers.Find(ScenarioId);
+	return LastPlay ? static_cast<int32>(NumPlays - 1 - *LastPlay) : INDEX_NONE;
+}
+
+const FPrimaryAssetId& FScenarioRecentPlays::GetRecent(int32 MatchesAgo) const
+{
+	check(MatchesAgo >= 0 && MatchesAgo < Num());
+	return Ring[(NumPlays - 1 - MatchesAgo) % Capacity];
+}
+
+bool FScenarioRecentPlays::WasPlayedWithin(const FPrimaryAssetId& ScenarioId, int32 NumMatches) const
+{
+	const int32 MatchesSince = GetMatchesSince(ScenarioId);
+	return MatchesSince != INDEX_NONE && MatchesSince < NumMatches;
+}
@@ -0,0 +1,326 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioRemoteStatsBackend.h"
+
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Misc/FileHelper.h"
+#include "ScenarioPersistenceLog.h"
+#include "ScenarioPersistenceWriter.h"
+
+static TAutoConsoleVariable<float> CVarRemoteBatchSeconds(
+	TEXT("Scenario.Persistence.Remote.BatchSeconds"),
+	1.0f,
+	TEXT("How often queued scenario stat deltas are sent to the aggregation service"));
+
+static TAutoConsoleVariable<float> CVarRemoteSnapshotSeconds(
+	TEXT("Scenario.Persistence.Remote.SnapshotSeconds"),
+	30.0f,
+	TEXT("How often the global scenario stats are pulled from the aggregation service"));
+
+static TAutoConsoleVariable<float> CVarRemoteMaxRetrySeconds(
+	TEXT("Scenario.Persistence.Remote.MaxRetrySeconds"),
+	60.0f,
+	TEXT("Longest backoff between retries of a failed scenario stats batch"));
+
+static TAutoConsoleVariable<int32> CVarRemoteMaxPendingBytes(
+	TEXT("Scenario.Persistence.Remote.MaxPendingBytes"),
+	64 * 1024,
+	TEXT("Unsent scenario stat deltas kept in memory before they spill to disk"));
+
+static TAutoConsoleVariable<int32> CVarRemoteMaxSpillBytes(
+	TEXT("Scenario.Persistence.Remote.MaxSpillBytes"),
+	16 * 1024 * 1024,
+	TEXT("Size of the on-disk spill queue past which new scenario stat deltas are dropped"));
+
+// Sequences reserved per write of the client file
+static constexpr uint64 SequenceReservationBlock = 4096;
+
+FScenarioRemoteStatsBackend::FScenarioRemoteStatsBackend(const FScenarioStatsFilePaths& InPaths, const FString& InUrl)
+	: Paths(InPaths)
+	, Url(InUrl)
+{
+}
+
+FScenarioRemoteStatsBackend::~FScenarioRemoteStatsBackend()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+}
+
+bool FScenarioRemoteStatsBackend::Load(FScenarioStatsStore& OutStore)
+{
+	// Start from the last global snapshot we saw; the service's answer replaces it shortly
+	TArray<uint8> Bytes;
+	if (FFileHelper::LoadFileToArray(Bytes, *Paths.RemoteCache, FILEREAD_Silent))
+	{
+		uint64 UnusedSequence = 0;
+		FString Error;
+		if (!FScenarioStatsFile::Read(Bytes, OutStore, UnusedSequence, Error))
+		{
+			UE_LOG(LogScenarioPersistence, Warning, TEXT("Ignoring cached global scenario stats %s: %s"), *Paths.RemoteCache, *Error);
+		}
+	}
+
+	// The service only recognizes a resent batch under the id it was first sent with
+	FString ClientState;
+	TArray<FString> Fields;
+	FGuid ClientGuid;
+	if (FFileHelper::LoadFileToString(ClientState, *Paths.RemoteClient)
+		&& ClientState.ParseIntoArrayWS(Fields) == 2
+		&& FGuid::Parse(Fields[0], ClientGuid))
+	{
+		ClientId = ClientGuid.ToString(EGuidFormats::Digits);
+		LexFromString(LastSequence, *Fields[1]);
+	}
+	else
+	{
+		ClientId = FGuid::NewGuid().ToString(EGuidFormats::Digits);
+	}
+
+	// Spilled batches from an earlier run keep their sequences, so new deltas continue after them
+	for (const FString& SpillPath : { GetSendingSpillPath(), Paths.RemoteSpill })
+	{
+		if (FFileHelper::LoadFileToArray(Bytes, *SpillPath, FILEREAD_Silent))
+		{
+			FScenarioStatsFile::ReadJournal(Bytes, 0, [this](uint64 Sequence, const FScenarioStatsDelta&)
+			{
+				LastSequence = FMath::Max(LastSequence, Sequence);
+			});
+		}
+	}
+
+	// Without a saved id every restart would look like a new client to the service
+	return ReserveSequences();
+}
+
+void FScenarioRemoteStatsBackend::Start()
+{
+	TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateSP(this, &FScenarioRemoteStatsBackend::Tick), 0.25f);
+	RequestSnapshot();
+}
+
+void FScenarioRemoteStatsBackend::Apply(const FScenarioStatsDelta& Delta)
+{
+	if (LastSequence >= ReservedSequence && !ReserveSequences())
+	{
+		// Keep counting past the reservation; only a crash before the next successful write can reuse these
+		ReservedSequence = LastSequence + SequenceReservationBlock;
+	}
+	FScenarioStatsFile::AppendJournalRecord(Delta, ++LastSequence, PendingBytes);
+
+	// Backpressure: a slow or unreachable service must not grow memory without bound
+	if (PendingBytes.Num() >= CVarRemoteMaxPendingBytes.GetValueOnGameThread())
+	{
+		Spill(PendingBytes);
+		PendingBytes.Reset();
+	}
+}
+
+bool FScenarioRemoteStatsBackend::Refresh(FScenarioStatsStore& InOutStore)
+{
+	if (!ReceivedSnapshot.IsSet())
+	{
+		return false;
+	}
+
+	InOutStore = MoveTemp(ReceivedSnapshot.GetValue());
+	ReceivedSnapshot.Reset();
+
+	// Our own deltas the service has not applied yet are still missing from its snapshot. Oldest first:
+	// a sending file not yet loaded, the batch in flight, then what spilled after it, then memory.
+	auto ApplyJournal = [&InOutStore](const TArray<uint8>& Bytes)
+	{
+		FScenarioStatsFile::ReadJournal(Bytes, 0, [&InOutStore](uint64, const FScenarioStatsDelta& Delta) { Delta.Apply(InOutStore); });
+	};
+
+	// The spill files only exist under backpressure, so they are normally not read at all
+	TArray<uint8> SpilledBytes;
+	if (!bInFlightFromSpill && FFileHelper::LoadFileToArray(SpilledBytes, *GetSendingSpillPath(), FILEREAD_Silent))
+	{
+		ApplyJournal(SpilledBytes);
+	}
+	ApplyJournal(InFlightBytes);
+	if (FFileHelper::LoadFileToArray(SpilledBytes, *Paths.RemoteSpill, FILEREAD_Silent))
+	{
+		ApplyJournal(SpilledBytes);
+	}
+	ApplyJournal(PendingBytes);
+	return true;
+}
+
+void FScenarioRemoteStatsBackend::Shutdown(const FScenarioStatsStore& Store)
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	TickHandle.Reset();
+
+	for (FHttpRequestPtr* Request : { &BatchRequest, &SnapshotRequest })
+	{
+		if (Request->IsValid())
+		{
+			(*Request)->OnProcessRequestComplete().Unbind();
+			(*Request)->CancelRequest();
+			Request->Reset();
+		}
+	}
+
+	// Everything unsent goes to disk and is sent first next run; a batch that did arrive is dropped as a duplicate
+	if (!bInFlightFromSpill)
+	{
+		Spill(InFlightBytes);
+	}
+	Spill(PendingBytes);
+	InFlightBytes.Reset();
+	PendingBytes.Reset();
+}
+
+bool FScenarioRemoteStatsBackend::Tick(float DeltaTime)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	if (!BatchRequest.IsValid() && Now >= NextSendTime)
+	{
+		SendNextBatch();
+	}
+
+	if (!SnapshotRequest.IsValid() && Now >= NextSnapshotTime)
+	{
+		RequestSnapshot();
+	}
+
+	return true;
+}
+
+void FScenarioRemoteStatsBackend::SendNextBatch()
+{
+	if (InFlightBytes.Num() == 0)
+	{
+		IFileManager& FileManager = IFileManager::Get();
+
+		// Spilled deltas are older than anything in memory, so they go first
+		if (FileManager.FileExists(*GetSendingSpillPath()) || FileManager.Move(*GetSendingSpillPath(), *Paths.RemoteSpill, true, true, false, true))
+		{
+			bInFlightFromSpill = FFileHelper::LoadFileToArray(InFlightBytes, *GetSendingSpillPath(), FILEREAD_Silent);
+		}
+
+		if (InFlightBytes.Num() == 0)
+		{
+			bInFlightFromSpill = false;
+			if (PendingBytes.Num() == 0)
+			{
+				NextSendTime = FPlatformTime::Seconds() + CVarRemoteBatchSeconds.GetValueOnGameThread();
+				return;
+			}
+			Swap(InFlightBytes, PendingBytes);
+		}
+	}
+
+	BatchRequest = FHttpModule::Get().CreateRequest();
+	BatchRequest->SetURL(FString::Printf(TEXT("%s/deltas?client=%s"), *Url, *ClientId));
+	BatchRequest->SetVerb(TEXT("POST"));
+	BatchRequest->SetHeader(TEXT("Content-Type"), TEXT("application/octet-stream"));
+	BatchRequest->SetContent(InFlightBytes);
+	BatchRequest->OnProcessRequestComplete().BindSP(this, &FScenarioRemoteStatsBackend::OnBatchSent);
+	BatchRequest->ProcessRequest();
+}
+
+void FScenarioRemoteStatsBackend::OnBatchSent(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bConnectedSuccessfully)
+{
+	BatchRequest.Reset();
+
+	if (bConnectedSuccessfully && Response.IsValid() && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		if (bInFlightFromSpill)
+		{
+			IFileManager::Get().Delete(*GetSendingSpillPath(), false, true, true);
+			bInFlightFromSpill = false;
+		}
+		InFlightBytes.Reset();
+		FailedAttempts = 0;
+		NextSendTime = FPlatformTime::Seconds() + CVarRemoteBatchSeconds.GetValueOnGameThread();
+		return;
+	}
+
+	// Keep the batch and back off; its records keep their sequences, so a late success is not applied twice
+	++FailedAttempts;
+	const double Backoff = FMath::Min(CVarRemoteBatchSeconds.GetValueOnGameThread() * FMath::Pow(2.0, FMath::Min(FailedAttempts, 16)), static_cast<double>(CVarRemoteMaxRetrySeconds.GetValueOnGameThread()));
+	NextSendTime = FPlatformTime::Seconds() + Backoff;
+	UE_LOG(LogScenarioPersistence, Warning, TEXT("Sending scenario stats to %s failed (%d), retrying in %.1fs"), *Url, Response.IsValid() ? Response->GetResponseCode() : 0, Backoff);
+}
+
+void FScenarioRemoteStatsBackend::RequestSnapshot()
+{
+	SnapshotRequest = FHttpModule::Get().CreateRequest();
+	SnapshotRequest->SetURL(Url + TEXT("/snapshot"));
+	SnapshotRequest->SetVerb(TEXT("GET"));
+	SnapshotRequest->OnProcessRequestComplete().BindSP(this, &FScenarioRemoteStatsBackend::OnSnapshotReceived);
+	SnapshotRequest->ProcessRequest();
+}
+
+void FScenarioRemoteStatsBackend::OnSnapshotReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bConnectedSuccessfully)
+{
+	SnapshotRequest.Reset();
+	NextSnapshotTime = FPlatformTime::Seconds() + CVarRemoteSnapshotSeconds.GetValueOnGameThread();
+
+	if (!bConnectedSuccessfully || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		return;
+	}
+
+	FScenarioStatsStore Snapshot;
+	uint64 UnusedSequence = 0;
+	FString Error;
+	if (!FScenarioStatsFile::Read(Response->GetContent(), Snapshot, UnusedSequence, Error))
+	{
+		UE_LOG(LogScenarioPersistence, Warning, TEXT("Ignoring global scenario stats from %s: %s"), *Url, *Error);
+		return;
+	}
+
+	ReceivedSnapshot.Emplace(MoveTemp(Snapshot));
+
+	// Cached for the next start, written off the game thread
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Bytes = Response->GetContent(), CachePath = Paths.RemoteCache]()
+	{
+		FScenarioPersistenceWriter::WriteFileAtomic(CachePath, Bytes);
+	});
+}
+
+void FScenarioRemoteStatsBackend::Spill(const TArray<uint8>& Bytes)
+{
+	if (Bytes.Num() == 0)
+	{
+		return;
+	}
+
+	if (FMath::Max<int64>(IFileManager::Get().FileSize(*Paths.RemoteSpill), 0) + Bytes.Num() > CVarRemoteMaxSpillBytes.GetValueOnGameThread())
+	{
+		UE_LOG(LogScenarioPersistence, Error, TEXT("Scenario stats spill queue %s is full, dropping %d bytes of deltas"), *Paths.RemoteSpill, Bytes.Num());
+		return;
+	}
+
+	FFileHelper::SaveArrayToFile(Bytes, *Paths.RemoteSpill, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+FString FScenarioRemoteStatsBackend::GetSendingSpillPath() const
+{
+	return Paths.RemoteSpill + TEXT(".sending");
+}
+
+bool FScenarioRemoteStatsBackend::ReserveSequences()
+{
+	// Sequences need not be contiguous, the service only drops those at or below the last it applied
+	const uint64 NewReservedSequence = LastSequence + SequenceReservationBlock;
+	const FString ClientState = FString::Printf(TEXT("%s %llu\n"), *ClientId, NewReservedSequence);
+
+	FTCHARToUTF8 Utf8(*ClientState);
+	if (!FScenarioPersistenceWriter::WriteFileAtomic(Paths.RemoteClient, TArray<uint8>(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length())))
+	{
+		UE_LOG(LogScenarioPersistence, Error, TEXT("Failed to save the scenario stats client id to %s"), *Paths.RemoteClient);
+		return false;
+	}
+
+	ReservedSequence = NewReservedSequence;
+	return true;
+}
@@ -0,0 +1,142 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioRotationPlanner.h"
+
+namespace ScenarioRotationPlanner
+{
+	// Simulated play history of one candidate
+	struct FCandidateState
+	{
+		// Match number of the last play, where 0 is the latest real match and slot N is match N + 1
+		int32 LastMatch = MIN_int32;
+		FDateTime LastPlayed;
+	};
+
+	struct FKeyedCandidate
+	{
+		int32 CandidateIndex;
+		double Key;
+	};
+}
+
+FScenarioRotationPlan FScenarioRotationPlanner::Plan(const FScenarioRotationPlanInput& Input)
+{
+	using namespace ScenarioRotationPlanner;
+
+	const double StartTime = FPlatformTime::Seconds();
+	FScenarioRotationPlan Plan;
+	Plan.Generation = Input.Generation;
+
+	const int32 NumCandidates = Input.Candidates.Num();
+	TArray<FCandidateState> States;
+	States.SetNum(NumCandidates);
+	TMap<FPrimaryAssetId, int32> CandidateIndices;
+	CandidateIndices.Reserve(NumCandidates);
+	for (int32 Index = 0; Index < NumCandidates; ++Index)
+	{
+		const FScenarioRotationPlanCandidate& Candidate = Input.Candidates[Index];
+		CandidateIndices.Add(Candidate.ScenarioId, Index);
+		if (Candidate.MatchesSinceLastPlay != INDEX_NONE)
+		{
+			States[Index].LastMatch = -Candidate.MatchesSinceLastPlay;
+		}
+		States[Index].LastPlayed = Candidate.LastPlayed;
+	}
+
+	// Diversity tags of the assumed winners, newest first, starting with the real plays
+	TArray<FGameplayTagContainer> RecentTags = Input.RecentDiversityTags;
+
+	auto PlayWinner = [&](const FScenarioRotationPlanSlot& Slot, int32 SlotIndex)
+	{
+		if (Slot.Options.IsEmpty())
+		{
+			return;
+		}
+		const int32* CandidateIndex = CandidateIndices.Find(Slot.Options[0]);
+		if (CandidateIndex)
+		{
+			States[*CandidateIndex].LastMatch = SlotIndex + 1;
+			States[*CandidateIndex].LastPlayed = Slot.VoteTime;
+		}
+		RecentTags.Insert(CandidateIndex ? Input.Candidates[*CandidateIndex].DiversityTags : FGameplayTagContainer(), 0);
+	};
+
+	const int32 NumKept = FMath::Min(Input.KeepSlots.Num(), Input.NumSlots);
+	for (int32 SlotIndex = 0; SlotIndex < NumKept; ++SlotIndex)
+	{
+		Plan.Slots.Add(Input.KeepSlots[SlotIndex]);
+		PlayWinner(Input.KeepSlots[SlotIndex], SlotIndex);
+	}
+
+	FRandomStream Random(Input.Seed);
+	TArray<FKeyedCandidate> Keyed;
+	Keyed.Reserve(NumCandidates);
+	TArray<bool> Taken;
+
+	for (int32 SlotIndex = NumKept; SlotIndex < Input.NumSlots; ++SlotIndex)
+	{
+		FScenarioRotationPlanSlot& Slot = Plan.Slots.AddDefaulted_GetRef();
+		Slot.VoteTime = Input.FirstVoteTime + Input.MatchLength * SlotIndex;
+
+		// Weighted order without replacement: the largest log(u) / w wins
+		Keyed.Reset();
+		for (int32 Index = 0; Index < NumCandidates; ++Index)
+		{
+			const FScenarioRotationPlanCandidate& Candidate = Input.Candidates[Index];
+			const FCandidateState& State = States[Index];
+			if (Candidate.Weight <= 0.0f
+				|| (State.LastMatch != MIN_int32 && SlotIndex - State.LastMatch < Candidate.MinimumMatchesBetweenPlays)
+				|| (State.LastPlayed.GetTicks() > 0 && Slot.VoteTime < State.LastPlayed + Candidate.MinimumGap))
+			{
+				continue;
+			}
+			Keyed.Add({ Index, FMath::Loge(FMath::Max(Random.GetFraction(), UE_SMALL_NUMBER)) / Candidate.Weight });
+		}
+		Keyed.Sort([](const FKeyedCandidate& A, const FKeyedCandidate& B) { return A.Key > B.Key; });
+
+		const int32 NumRecent = FMath::Min(Input.DiversityMatches, RecentTags.Num());
+		auto IsDiverse = [&](const FGameplayTagContainer& Tags)
+		{
+			if (Tags.IsEmpty())
+			{
+				return true;
+			}
+			for (int32 Recent = 0; Recent < NumRecent; ++Recent)
+			{
+				if (Tags.HasAnyExact(RecentTags[Recent]))
+				{
+					return false;
+				}
+			}
+			for (const FPrimaryAssetId& Option : Slot.Options)
+			{
+				if (Tags.HasAnyExact(Input.Candidates[CandidateIndices[Option]].DiversityTags))
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// Diverse options first, then whatever is left if that does not fill the slot
+		Taken.Init(false, Keyed.Num());
+		for (int32 Pass = 0; Pass < 2 && Slot.Options.Num() < Input.NumOptions; ++Pass)
+		{
+			for (int32 KeyedIndex = 0; KeyedIndex < Keyed.Num() && Slot.Options.Num() < Input.NumOptions; ++KeyedIndex)
+			{
+				const FScenarioRotationPlanCandidate& Candidate = Input.Candidates[Keyed[KeyedIndex].CandidateIndex];
+				if (!Taken[KeyedIndex] && (Pass == 1 || IsDiverse(Candidate.DiversityTags)))
+				{
+					Taken[KeyedIndex] = true;
+					Slot.Options.Add(Candidate.ScenarioId);
+				}
+			}
+		}
+
+		PlayWinner(Slot, SlotIndex);
+	}
+
+	Plan.PlanSeconds = FPlatformTime::Seconds() - StartTime;
+	return Plan;
+}
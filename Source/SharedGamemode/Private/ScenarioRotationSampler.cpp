@@ -0,0 +1,137 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioRotationSampler.h"
+
+void FScenarioRotationSampler::Reset()
+{
+	Ids.Reset();
+	Weights.Reset();
+	Probabilities.Reset();
+	Aliases.Reset();
+}
+
+void FScenarioRotationSampler::Add(const FPrimaryAssetId& ScenarioId, float Weight)
+{
+	if (Weight > 0.0f)
+	{
+		Ids.Add(ScenarioId);
+		Weights.Add(Weight);
+	}
+}
+
+void FScenarioRotationSampler::Build()
+{
+	const int32 NumIds = Ids.Num();
+	Probabilities.SetNumUninitialized(NumIds);
+	Aliases.SetNumUninitialized(NumIds);
+	Scaled.SetNumUninitialized(NumIds);
+	Small.Reset();
+	Large.Reset();
+
+	double TotalWeight = 0.0;
+	for (float Weight : Weights)
+	{
+		TotalWeight += Weight;
+	}
+
+	for (int32 Index = 0; Index < NumIds; ++Index)
+	{
+		Scaled[Index] = static_cast<float>(Weights[Index] * NumIds / TotalWeight);
+		(Scaled[Index] < 1.0f ? Small : Large).Add(Index);
+	}
+
+	while (Small.Num() > 0 && Large.Num() > 0)
+	{
+		const int32 Less = Small.Pop(EAllowShrinking::No);
+		const int32 More = Large.Pop(EAllowShrinking::No);
+
+		Probabilities[Less] = Scaled[Less];
+		Aliases[Less] = More;
+
+		Scaled[More] = (Scaled[More] + Scaled[Less]) - 1.0f;
+		(Scaled[More] < 1.0f ? Small : Large).Add(More);
+	}
+
+	// Whatever is left is 1 up to rounding error
+	for (int32 Index : Large)
+	{
+		Probabilities[Index] = 1.0f;
+		Aliases[Index] = Index;
+	}
+	for (int32 Index : Small)
+	{
+		Probabilities[Index] = 1.0f;
+		Aliases[Index] = Index;
+	}
+}
+
+int32 FScenarioRotationSampler::SampleIndex() const
+{
+	const int32 Column = FMath::RandRange(0, Ids.Num() - 1);
+	return FMath::FRand() < Probabilities[Column] ? Column : Aliases[Column];
+}
+
+void FScenarioRotationSampler::Sample(int32 Count, const TArray<FPrimaryAssetId>& Exclude, TArray<FPrimaryAssetId>& OutIds) const
+{
+	const int32 FirstPicked = OutIds.Num();
+	auto IsTaken = [&](const FPrimaryAssetId& ScenarioId)
+	{
+		for (int32 Index = FirstPicked; Index < OutIds.Num(); ++Index)
+		{
+			if (OutIds[Index] == ScenarioId)
+			{
+				return true;
+			}
+		}
+		return Exclude.Contains(ScenarioId);
+	};
+
+	Count = FMath::Min(Count, Ids.Num());
+	int32 Rejections = 0;
+	const int32 MaxRejections = 4 * Count + 8;
+
+	while (OutIds.Num() - FirstPicked < Count && Rejections < MaxRejections)
+	{
+		const FPrimaryAssetId& ScenarioId = Ids[SampleIndex()];
+		if (IsTaken(ScenarioId))
+		{
+			++Rejections;
+			continue;
+		}
+		OutIds.Add(ScenarioId);
+	}
+
+	// Most of the weight is already taken: draw from what is left directly
+	while (OutIds.Num() - FirstPicked < Count)
+	{
+		double RemainingWeight = 0.0;
+		for (int32 Index = 0; Index < Ids.Num(); ++Index)
+		{
+			if (!IsTaken(Ids[Index]))
+			{
+				RemainingWeight += Weights[Index];
+			}
+		}
+		if (RemainingWeight <= 0.0)
+		{
+			break;
+		}
+
+		double Target = FMath::FRand() * RemainingWeight;
+		int32 Picked = INDEX_NONE;
+		for (int32 Index = 0; Index < Ids.Num(); ++Index)
+		{
+			if (!IsTaken(Ids[Index]))
+			{
+				Picked = Index;
+				Target -= Weights[Index];
+				if (Target <= 0.0)
+				{
+					break;
+				}
+			}
+		}
+		OutIds.Add(Ids[Picked]);
+	}
+}
@@ -0,0 +1,523 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioSharedStatsStore.h"
+
+#include "Misc/Paths.h"
+#include "ScenarioPersistenceLog.h"
+#include <atomic>
+
+#define SCENARIO_SHARED_STATS_SUPPORTED (PLATFORM_LINUX || PLATFORM_MAC)
+
+#if SCENARIO_SHARED_STATS_SUPPORTED
+THIRD_PARTY_INCLUDES_START
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+THIRD_PARTY_INCLUDES_END
+#endif
+
+// Layout shared between processes; every process must be running the same build
+struct FScenarioSharedStatsStore::FHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x53534753; // "SGSS"
+	static constexpr uint32 CurrentVersion = 3;
+
+	uint32 Magic;
+	uint32 Version;
+	uint32 Capacity;
+	uint32 SlotSize;
+	std::atomic<uint32> NumSlots;
+	std::atomic<uint64> ChangeCounter;
+};
+
+// FScenarioStatsBucket with atomic fields; zero-filled means unused, since no real period has epoch 0
+struct FScenarioSharedStatsStore::FBucket
+{
+	std::atomic<int32> Epoch;
+	std::atomic<int32> Plays;
+	std::atomic<int32> Votes;
+	std::atomic<int32> PlayerCountSamples;
+	std::atomic<int32> PlayerCountSum;
+	std::atomic<uint32> PlayerCountHistogram[FScenarioStatsBucket::NumPlayerCountBins];
+	std::atomic<int32> DurationSeconds;
+	std::atomic<int32> DurationSamples;
+};
+
+struct FScenarioSharedStatsStore::FSlot
+{
+	static constexpr int32 MaxKeyLength = 120;
+
+	// Zero until the slot is claimed, published last so readers never see a half-written key
+	std::atomic<uint32> bOccupied;
+	uint32 KeyHash;
+	std::atomic<int32> TimesPlayed;
+	std::atomic<int32> TotalVotes;
+	std::atomic<int64> LastPlayedTicks;
+
+	// Player counts in thousandths, so the average survives concurrent adds from many processes
+	std::atomic<int64> PlayerCountMilliSum;
+	std::atomic<int32> PlayerCountSamples;
+
+	std::atomic<uint32> bInRotation;
+	std::atomic<float> Weight;
+	std::atomic<int32> MinimumGapBetweenPlays;
+	std::atomic<int32> MinimumMatchesBetweenPlays;
+
+	// "Type:Name", UTF-8, null terminated
+	ANSICHAR Key[MaxKeyLength];
+
+	FBucket Hourly[FScenarioStatsHistory::NumHourlyBuckets];
+	FBucket Daily[FScenarioStatsHistory::NumDailyBuckets];
+};
+
+static_assert(std::atomic<int64>::is_always_lock_free && std::atomic<float>::is_always_lock_free,
+	"Shared stats rely on lock-free atomics working across processes");
+
+namespace ScenarioSharedStatsStore
+{
+	static uint32 HashKey(const FString& Key)
+	{
+		return FCrc::StrCrc32(*Key);
+	}
+
+	static FScenarioStats ToStats(const FPrimaryAssetId& ScenarioId, int32 TimesPlayed, int32 TotalVotes, int64 PlayerCountMilliSum, int32 PlayerCountSamples, int64 LastPlayedTicks)
+	{
+		FScenarioStats Stats;
+		Stats.ScenarioId = ScenarioId;
+		Stats.TimesPlayed = TimesPlayed;
+		Stats.TotalVotes = TotalVotes;
+		Stats.AveragePlayerCount = PlayerCountSamples > 0 ? static_cast<float>(PlayerCountMilliSum) / (1000.0f * PlayerCountSamples) : 0.0f;
+		Stats.LastPlayed = FDateTime(LastPlayedTicks);
+		return Stats;
+	}
+}
+
+FScenarioSharedStatsStore::~FScenarioSharedStatsStore()
+{
+#if SCENARIO_SHARED_STATS_SUPPORTED
+	if (MappedData)
+	{
+		munmap(MappedData, MappedSize);
+	}
+	if (FileDescriptor >= 0)
+	{
+		close(FileDescriptor);
+	}
+#endif
+}
+
+bool FScenarioSharedStatsStore::IsSupported()
+{
+	return SCENARIO_SHARED_STATS_SUPPORTED;
+}
+
+TSharedPtr<FScenarioSharedStatsStore> FScenarioSharedStatsStore::Open(const FString& FilePath, int32 Capacity, const FScenarioStatsStore& Seed)
+{
+#if SCENARIO_SHARED_STATS_SUPPORTED
+	const FString FullPath = FPaths::ConvertRelativePathToFull(FilePath);
+	const int32 FileDescriptor = open(TCHAR_TO_UTF8(*FullPath), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (FileDescriptor < 0)
+	{
+		UE_LOG(LogScenarioPersistence, Warning, TEXT("Failed to open shared scenario stats %s (errno %d)"), *FullPath, errno);
+		return nullptr;
+	}
+
+	TSharedPtr<FScenarioSharedStatsStore> Store(new FScenarioSharedStatsStore());
+	Store->FileDescriptor = FileDescriptor;
+
+	// Held while sizing, so exactly one process creates and seeds the table
+	Store->Lock();
+
+	struct stat FileStat;
+	fstat(FileDescriptor, &FileStat);
+	const bool bCreate = FileStat.st_size == 0;
+
+	uint32 SlotCount = Capacity;
+	if (!bCreate)
+	{
+		FHeader ExistingHeader;
+		if (FileStat.st_size < static_cast<off_t>(sizeof(FHeader)) || pread(FileDescriptor, &ExistingHeader, sizeof(FHeader), 0) != sizeof(FHeader)
+			|| ExistingHeader.Magic != FHeader::ExpectedMagic || ExistingHeader.Version != FHeader::CurrentVersion || ExistingHeader.SlotSize != sizeof(FSlot)
+			|| FileStat.st_size != static_cast<off_t>(sizeof(FHeader) + ExistingHeader.Capacity * sizeof(FSlot)))
+		{
+			UE_LOG(LogScenarioPersistence, Error, TEXT("Shared scenario stats %s has an incompatible layout"), *FullPath);
+			Store->Unlock();
+			return nullptr;
+		}
+		SlotCount = ExistingHeader.Capacity;
+	}
+
+	Store->MappedSize = sizeof(FHeader) + SlotCount * sizeof(FSlot);
+	if (bCreate && ftruncate(FileDescriptor, Store->MappedSize) != 0)
+	{
+		UE_LOG(LogScenarioPersistence, Warning, TEXT("Failed to size shared scenario stats %s (errno %d)"), *FullPath, errno);
+		Store->Unlock();
+		return nullptr;
+	}
+
+	void* Mapping = mmap(nullptr, Store->MappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, FileDescriptor, 0);
+	if (Mapping == MAP_FAILED)
+	{
+		UE_LOG(LogScenarioPersistence, Warning, TEXT("Failed to map shared scenario stats %s (errno %d)"), *FullPath, errno);
+		Store->Unlock();
+		return nullptr;
+	}
+
+	Store->MappedData = static_cast<uint8*>(Mapping);
+	Store->Header = reinterpret_cast<FHeader*>(Store->MappedData);
+	Store->Slots = reinterpret_cast<FSlot*>(Store->MappedData + sizeof(FHeader));
+
+	if (bCreate)
+	{
+		// ftruncate zero-fills, so every slot starts out empty
+		Store->Header->Magic = FHeader::ExpectedMagic;
+		Store->Header->Version = FHeader::CurrentVersion;
+		Store->Header->Capacity = SlotCount;
+		Store->Header->SlotSize = sizeof(FSlot);
+
+		// Lock is already held, so write the slots directly rather than through Apply
+		for (const TPair<FPrimaryAssetId, FScenarioStats>& Pair : Seed.Stats)
+		{
+			if (FSlot* Slot = Store->FindOrAddSlot(Pair.Key))
+			{
+				Slot->TimesPlayed.store(Pair.Value.TimesPlayed);
+				Slot->TotalVotes.store(Pair.Value.TotalVotes);
+				Slot->LastPlayedTicks.store(Pair.Value.LastPlayed.GetTicks());
+				Slot->PlayerCountMilliSum.store(FMath::RoundToInt64(Pair.Value.AveragePlayerCount * 1000.0) * Pair.Value.TimesPlayed);
+				Slot->PlayerCountSamples.store(Pair.Value.TimesPlayed);
+			}
+		}
+		for (const FScenarioRotationEntry& Entry : Seed.RotationEntries)
+		{
+			if (FSlot* Slot = Store->FindOrAddSlot(Entry.ScenarioId))
+			{
+				Slot->Weight.store(Entry.Weight);
+				Slot->MinimumGapBetweenPlays.store(Entry.MinimumGapBetweenPlays);
+				Slot->MinimumMatchesBetweenPlays.store(Entry.MinimumMatchesBetweenPlays);
+				Slot->bInRotation.store(1);
+			}
+		}
+		for (const TPair<FPrimaryAssetId, FScenarioStatsHistory>& Pair : Seed.History)
+		{
+			FSlot* Slot = Store->FindOrAddSlot(Pair.Key);
+			if (!Slot)
+			{
+				continue;
+			}
+
+			auto SeedBuckets = [](FBucket* Buckets, const FScenarioStatsBucket* Source, int32 NumBuckets)
+			{
+				for (int32 Index = 0; Index < NumBuckets; ++Index)
+				{
+					const FScenarioStatsBucket& Bucket = Source[Index];
+					if (Bucket.IsEmpty())
+					{
+						continue;
+					}
+					Buckets[Index].Plays.store(Bucket.Plays);
+					Buckets[Index].Votes.store(Bucket.Votes);
+					Buckets[Index].PlayerCountSamples.store(Bucket.PlayerCountSamples);
+					Buckets[Index].PlayerCountSum.store(Bucket.PlayerCountSum);
+					for (int32 Bin = 0; Bin < FScenarioStatsBucket::NumPlayerCountBins; ++Bin)
+					{
+						Buckets[Index].PlayerCountHistogram[Bin].store(Bucket.PlayerCountHistogram[Bin]);
+					}
+					Buckets[Index].DurationSeconds.store(Bucket.DurationSeconds);
+					Buckets[Index].DurationSamples.store(Bucket.DurationSamples);
+					Buckets[Index].Epoch.store(Bucket.Epoch, std::memory_order_release);
+				}
+			};
+			SeedBuckets(Slot->Hourly, Pair.Value.Hourly, FScenarioStatsHistory::NumHourlyBuckets);
+			SeedBuckets(Slot->Daily, Pair.Value.Daily, FScenarioStatsHistory::NumDailyBuckets);
+		}
+		Store->Header->ChangeCounter.fetch_add(1);
+
+		UE_LOG(LogScenarioPersistence, Log, TEXT("Created shared scenario stats %s with %d slots"), *FullPath, SlotCount);
+	}
+
+	Store->Unlock();
+	return Store;
+#else
+	return nullptr;
+#endif
+}
+
+bool FScenarioSharedStatsStore::Apply(const FScenarioStatsDelta& Delta)
+{
+	// Claiming a slot takes the lock, but only the first time a scenario is seen
+	const FString Key = Delta.ScenarioId.ToString();
+	FSlot* Slot = FindSlot(Key, ScenarioSharedStatsStore::HashKey(Key));
+	if (!Slot)
+	{
+		Lock();
+		Slot = FindOrAddSlot(Delta.ScenarioId);
+		Unlock();
+	}
+	if (!Slot)
+	{
+		return false;
+	}
+
+	switch (Delta.Kind)
+	{
+	case EScenarioStatsDeltaKind::Play:
+		Slot->TimesPlayed.fetch_add(1);
+		Slot->LastPlayedTicks.store(Delta.Ticks);
+		AddToHistory(*Slot, Delta.Ticks, [](FBucket& Bucket) { Bucket.Plays.fetch_add(1); });
+		break;
+	case EScenarioStatsDeltaKind::Votes:
+		Slot->TotalVotes.fetch_add(Delta.Votes);
+		AddToHistory(*Slot, Delta.Ticks, [&Delta](FBucket& Bucket) { Bucket.Votes.fetch_add(Delta.Votes); });
+		break;
+	case EScenarioStatsDeltaKind::PlayerCountSample:
+	{
+		Slot->PlayerCountMilliSum.fetch_add(FMath::RoundToInt64(Delta.Value * 1000.0));
+		Slot->PlayerCountSamples.fetch_add(1);
+		const int32 Bin = FScenarioStatsBucket::GetPlayerCountBin(Delta.Value);
+		const int32 RoundedCount = FMath::RoundToInt32(Delta.Value);
+		AddToHistory(*Slot, Delta.Ticks, [Bin, RoundedCount](FBucket& Bucket)
+		{
+			Bucket.PlayerCountSamples.fetch_add(1);
+			Bucket.PlayerCountSum.fetch_add(RoundedCount);
+			Bucket.PlayerCountHistogram[Bin].fetch_add(1);
+		});
+		break;
+	}
+	case EScenarioStatsDeltaKind::MatchDuration:
+	{
+		const int32 RoundedSeconds = FMath::Max(FMath::RoundToInt32(Delta.Value), 0);
+		AddToHistory(*Slot, Delta.Ticks, [RoundedSeconds](FBucket& Bucket)
+		{
+			Bucket.DurationSamples.fetch_add(1);
+			Bucket.DurationSeconds.fetch_add(RoundedSeconds);
+		});
+		break;
+	}
+	case EScenarioStatsDeltaKind::Stats:
+		// Several fields have to change together
+		Lock();
+		Slot->TimesPlayed.store(Delta.Count);
+		Slot->TotalVotes.store(Delta.Votes);
+		Slot->LastPlayedTicks.store(Delta.Ticks);
+		Slot->PlayerCountMilliSum.store(FMath::RoundToInt64(Delta.Value * 1000.0) * Delta.Count);
+		Slot->PlayerCountSamples.store(Delta.Count);
+		Unlock();
+		break;
+	case EScenarioStatsDeltaKind::RotationEntry:
+		Lock();
+		Slot->Weight.store(Delta.Value);
+		Slot->MinimumGapBetweenPlays.store(Delta.Count);
+		Slot->MinimumMatchesBetweenPlays.store(Delta.Votes);
+		Slot->bInRotation.store(1);
+		Unlock();
+		break;
+	default:
+		break;
+	}
+
+	Header->ChangeCounter.fetch_add(1);
+	return true;
+}
+
+uint64 FScenarioSharedStatsStore::GetChangeCounter() const
+{
+	return Header->ChangeCounter.load();
+}
+
+void FScenarioSharedStatsStore::ReadAll(FScenarioStatsStore& OutStore) const
+{
+	OutStore.Reset();
+
+	auto ReadBuckets = [](const FBucket* Buckets, FScenarioStatsBucket* Out, int32 NumBuckets)
+	{
+		bool bAnyUsed = false;
+		for (int32 Index = 0; Index < NumBuckets; ++Index)
+		{
+			const int32 Epoch = Buckets[Index].Epoch.load(std::memory_order_acquire);
+			if (Epoch <= 0)
+			{
+				continue;
+			}
+			FScenarioStatsBucket& Bucket = Out[Index];
+			Bucket.Epoch = Epoch;
+			Bucket.Plays = Buckets[Index].Plays.load();
+			Bucket.Votes = Buckets[Index].Votes.load();
+			Bucket.PlayerCountSamples = Buckets[Index].PlayerCountSamples.load();
+			Bucket.PlayerCountSum = Buckets[Index].PlayerCountSum.load();
+			for (int32 Bin = 0; Bin < FScenarioStatsBucket::NumPlayerCountBins; ++Bin)
+			{
+				Bucket.PlayerCountHistogram[Bin] = static_cast<uint16>(FMath::Min<uint32>(Buckets[Index].PlayerCountHistogram[Bin].load(), MAX_uint16));
+			}
+			Bucket.DurationSeconds = Buckets[Index].DurationSeconds.load();
+			Bucket.DurationSamples = Buckets[Index].DurationSamples.load();
+			bAnyUsed = true;
+		}
+		return bAnyUsed;
+	};
+
+	for (uint32 SlotIndex = 0; SlotIndex < Header->Capacity; ++SlotIndex)
+	{
+		const FSlot& Slot = Slots[SlotIndex];
+		if (!Slot.bOccupied.load(std::memory_order_acquire))
+		{
+			continue;
+		}
+
+		const FPrimaryAssetId ScenarioId = FPrimaryAssetId::FromString(UTF8_TO_TCHAR(Slot.Key));
+		if (Slot.TimesPlayed.load() > 0 || Slot.TotalVotes.load() > 0)
+		{
+			OutStore.Stats.Add(ScenarioId, ScenarioSharedStatsStore::ToStats(ScenarioId, Slot.TimesPlayed.load(), Slot.TotalVotes.load(),
+				Slot.PlayerCountMilliSum.load(), Slot.PlayerCountSamples.load(), Slot.LastPlayedTicks.load()));
+		}
+		if (Slot.bInRotation.load())
+		{
+			FScenarioRotationEntry& Entry = OutStore.RotationEntries.AddDefaulted_GetRef();
+			Entry.ScenarioId = ScenarioId;
+			Entry.Weight = Slot.Weight.load();
+			Entry.MinimumGapBetweenPlays = Slot.MinimumGapBetweenPlays.load();
+			Entry.MinimumMatchesBetweenPlays = Slot.MinimumMatchesBetweenPlays.load();
+		}
+
+		FScenarioStatsHistory History;
+		const bool bHasHourly = ReadBuckets(Slot.Hourly, History.Hourly, FScenarioStatsHistory::NumHourlyBuckets);
+		const bool bHasDaily = ReadBuckets(Slot.Daily, History.Daily, FScenarioStatsHistory::NumDailyBuckets);
+		if (bHasHourly || bHasDaily)
+		{
+			OutStore.History.Add(ScenarioId, MoveTemp(History));
+		}
+	}
+}
+
+void FScenarioSharedStatsStore::Sync()
+{
+#if SCENARIO_SHARED_STATS_SUPPORTED
+	if (MappedData)
+	{
+		msync(MappedData, MappedSize, MS_ASYNC);
+	}
+#endif
+}
+
+FScenarioSharedStatsStore::FSlot* FScenarioSharedStatsStore::FindSlot(const FString& Key, uint32 KeyHash) const
+{
+	const FTCHARToUTF8 Utf8Key(*Key);
+	const uint32 Capacity = Header->Capacity;
+	for (uint32 Probe = 0; Probe < Capacity; ++Probe)
+	{
+		FSlot& Slot = Slots[(KeyHash + Probe) % Capacity];
+		if (!Slot.bOccupied.load(std::memory_order_acquire))
+		{
+			// Slots are never freed, so the first empty slot ends the probe sequence
+			return nullptr;
+		}
+		if (Slot.KeyHash == KeyHash && FCStringAnsi::Strcmp(Slot.Key, Utf8Key.Get()) == 0)
+		{
+			return &Slot;
+		}
+	}
+	return nullptr;
+}
+
+FScenarioSharedStatsStore::FSlot* FScenarioSharedStatsStore::FindOrAddSlot(const FPrimaryAssetId& ScenarioId)
+{
+	// Caller holds the lock
+	const FString Key = ScenarioId.ToString();
+	const uint32 KeyHash = ScenarioSharedStatsStore::HashKey(Key);
+	if (FSlot* Existing = FindSlot(Key, KeyHash))
+	{
+		return Existing;
+	}
+
+	const FTCHARToUTF8 Utf8Key(*Key);
+	if (Utf8Key.Length() >= FSlot::MaxKeyLength)
+	{
+		UE_LOG(LogScenarioPersistence, Warning, TEXT("Scenario id %s is too long for the shared stats store"), *Key);
+		return nullptr;
+	}
+
+	const uint32 Capacity = Header->Capacity;
+	for (uint32 Probe = 0; Probe < Capacity; ++Probe)
+	{
+		FSlot& Slot = Slots[(KeyHash + Probe) % Capacity];
+		if (!Slot.bOccupied.load(std::memory_order_acquire))
+		{
+			Slot.KeyHash = KeyHash;
+			FMemory::Memcpy(Slot.Key, Utf8Key.Get(), Utf8Key.Length() + 1);
+			Slot.bOccupied.store(1, std::memory_order_release);
+			Header->NumSlots.fetch_add(1);
+			return &Slot;
+		}
+	}
+
+	UE_LOG(LogScenarioPersistence, Warning, TEXT("Shared scenario stats store is full (%d slots)"), Capacity);
+	return nullptr;
+}
+
+FScenarioSharedStatsStore::FBucket* FScenarioSharedStatsStore::ClaimBucket(FBucket* Buckets, int32 NumBuckets, int32 Epoch)
+{
+	FBucket& Bucket = Buckets[Epoch % NumBuckets];
+	int32 CurrentEpoch = Bucket.Epoch.load(std::memory_order_acquire);
+	if (CurrentEpoch < Epoch)
+	{
+		// Another process may be recycling the same bucket, so check again under the lock.
+		// An add that read the old epoch just before this would land in the new period; periods are
+		// hours apart, so that window is negligible.
+		Lock();
+		CurrentEpoch = Bucket.Epoch.load(std::memory_order_acquire);
+		if (CurrentEpoch < Epoch)
+		{
+			Bucket.Plays.store(0);
+			Bucket.Votes.store(0);
+			Bucket.PlayerCountSamples.store(0);
+			Bucket.PlayerCountSum.store(0);
+			for (std::atomic<uint32>& Bin : Bucket.PlayerCountHistogram)
+			{
+				Bin.store(0);
+			}
+			Bucket.DurationSeconds.store(0);
+			Bucket.DurationSamples.store(0);
+			Bucket.Epoch.store(Epoch, std::memory_order_release);
+			CurrentEpoch = Epoch;
+		}
+		Unlock();
+	}
+	return CurrentEpoch == Epoch ? &Bucket : nullptr;
+}
+
+template<typename FunctorType>
+void FScenarioSharedStatsStore::AddToHistory(FSlot& Slot, int64 Ticks, FunctorType&& Functor)
+{
+	if (Ticks <= 0)
+	{
+		return;
+	}
+
+	const FDateTime Time(Ticks);
+	if (FBucket* Bucket = ClaimBucket(Slot.Hourly, FScenarioStatsHistory::NumHourlyBuckets, FScenarioStatsHistory::GetHourEpoch(Time)))
+	{
+		Functor(*Bucket);
+	}
+	if (FBucket* Bucket = ClaimBucket(Slot.Daily, FScenarioStatsHistory::NumDailyBuckets, FScenarioStatsHistory::GetDayEpoch(Time)))
+	{
+		Functor(*Bucket);
+	}
+}
+
+void FScenarioSharedStatsStore::Lock()
+{
+#if SCENARIO_SHARED_STATS_SUPPORTED
+	while (flock(FileDescriptor, LOCK_EX) != 0 && errno == EINTR)
+	{
+	}
+#endif
+}
+
+void FScenarioSharedStatsStore::Unlock()
+{
+#if SCENARIO_SHARED_STATS_SUPPORTED
+	flock(FileDescriptor, LOCK_UN);
+#endif
+}
@@ -0,0 +1,166 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioStatsBackend.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ScenarioPersistenceLog.h"
+#include "ScenarioPersistenceWriter.h"
+#include "ScenarioSharedStatsStore.h"
+
+FScenarioStatsFilePaths FScenarioStatsFilePaths::InDirectory(const FString& Directory)
+{
+	FScenarioStatsFilePaths Paths;
+	Paths.Snapshot = Directory / TEXT("ScenarioStats.bin");
+	Paths.Journal = Directory / TEXT("ScenarioStats.journal");
+	Paths.LegacyJson = Directory / TEXT("ScenarioStats.json");
+	Paths.SharedStore = Directory / TEXT("ScenarioStats.shared");
+	Paths.RemoteCache = Directory / TEXT("ScenarioStats.remote.bin");
+	Paths.RemoteSpill = Directory / TEXT("ScenarioStats.remote.spill");
+	Paths.RemoteClient = Directory / TEXT("ScenarioStats.remote.client");
+	Paths.Analytics = Directory / TEXT("ScenarioAnalytics.bin");
+	return Paths;
+}
+
+FScenarioFileStatsBackend::FScenarioFileStatsBackend(const FScenarioStatsFilePaths& InPaths, bool bInWriteBehind)
+	: Paths(InPaths)
+	, bWriteBehind(bInWriteBehind)
+{
+}
+
+FScenarioFileStatsBackend::~FScenarioFileStatsBackend()
+{
+	// Final append and compaction happen as the writer shuts down
+	Writer.Reset();
+}
+
+bool FScenarioFileStatsBackend::Load(FScenarioStatsStore& OutStore)
+{
+	uint64 JournalSequence = 0;
+	bool bImportedLegacy = false;
+	LoadFromDisk(Paths, OutStore, JournalSequence, bImportedLegacy);
+	if (bImportedLegacy)
+	{
+		SaveSnapshot(Paths.Snapshot, OutStore, JournalSequence);
+	}
+
+	Writer = MakeShared<FScenarioPersistenceWriter>(Paths.Snapshot, Paths.Journal, OutStore, JournalSequence, bWriteBehind);
+	return true;
+}
+
+void FScenarioFileStatsBackend::Apply(const FScenarioStatsDelta& Delta)
+{
+	if (Writer.IsValid())
+	{
+		Writer->Enqueue(Delta);
+	}
+}
+
+void FScenarioFileStatsBackend::Shutdown(const FScenarioStatsStore& Store)
+{
+	Writer.Reset();
+}
+
+void FScenarioFileStatsBackend::LoadFromDisk(const FScenarioStatsFilePaths& InPaths, FScenarioStatsStore& OutStore, uint64& OutJournalSequence, bool& bOutImportedLegacy)
+{
+	OutJournalSequence = 0;
+	bOutImportedLegacy = false;
+	TArray<uint8> Bytes;
+
+	if (FFileHelper::LoadFileToArray(Bytes, *InPaths.Snapshot, FILEREAD_Silent))
+	{
+		FString Error;
+		if (!FScenarioStatsFile::Read(Bytes, OutStore, OutJournalSequence, Error))
+		{
+			// Keep the damaged file for inspection instead of overwriting it with an empty store
+			UE_LOG(LogScenarioPersistence, Error, TEXT("Failed to load scenario stats from %s: %s"), *InPaths.Snapshot, *Error);
+			IFileManager::Get().Move(*(InPaths.Snapshot + TEXT(".corrupt")), *InPaths.Snapshot, true, true);
+		}
+	}
+	else
+	{
+		// One-way migration: import the old JSON file once, then only the binary file is written
+		FString JsonString;
+		if (FFileHelper::LoadFileToString(JsonString, *InPaths.LegacyJson)
+			&& FScenarioStatsFile::ImportJson(JsonString, OutStore))
+		{
+			UE_LOG(LogScenarioPersistence, Log, TEXT("Imported %d scenario stats from %s"), OutStore.Stats.Num(), *InPaths.LegacyJson);
+			bOutImportedLegacy = true;
+		}
+	}
+
+	// Changes made after the last compaction, the writer folds them into the snapshot once it starts
+	if (FFileHelper::LoadFileToArray(Bytes, *InPaths.Journal, FILEREAD_Silent))
+	{
+		const int32 NumReplayed = FScenarioStatsFile::ReplayJournal(Bytes, OutJournalSequence, OutStore, OutJournalSequence);
+		UE_LOG(LogScenarioPersistence, Log, TEXT("Replayed %d scenario stats changes from %s"), NumReplayed, *InPaths.Journal);
+	}
+}
+
+bool FScenarioFileStatsBackend::SaveSnapshot(const FString& FilePath, const FScenarioStatsStore& Store, uint64 JournalSequence)
+{
+	TArray<uint8> Bytes;
+	FScenarioStatsFile::Write(Store, JournalSequence, Bytes);
+	return FScenarioPersistenceWriter::WriteFileAtomic(FilePath, Bytes);
+}
+
+FScenarioSharedStatsBackend::FScenarioSharedStatsBackend(const FScenarioStatsFilePaths& InPaths, int32 InCapacity)
+	: Paths(InPaths)
+	, Capacity(InCapacity)
+{
+}
+
+bool FScenarioSharedStatsBackend::Load(FScenarioStatsStore& OutStore)
+{
+	if (!FScenarioSharedStatsStore::IsSupported())
+	{
+		return false;
+	}
+
+	// The local files only seed the shared file if this process is the first one to create it
+	FScenarioStatsStore Seed;
+	bool bImportedLegacy = false;
+	FScenarioFileStatsBackend::LoadFromDisk(Paths, Seed, JournalSequence, bImportedLegacy);
+
+	SharedStore = FScenarioSharedStatsStore::Open(Paths.SharedStore, Capacity, Seed);
+	if (!SharedStore.IsValid())
+	{
+		return false;
+	}
+
+	LastChangeCounter = SharedStore->GetChangeCounter();
+	SharedStore->ReadAll(OutStore);
+	return true;
+}
+
+void FScenarioSharedStatsBackend::Apply(const FScenarioStatsDelta& Delta)
+{
+	SharedStore->Apply(Delta);
+}
+
+bool FScenarioSharedStatsBackend::Refresh(FScenarioStatsStore& InOutStore)
+{
+	// Other processes may have changed the same records, so re-read rather than trust the local copy
+	const uint64 ChangeCounter = SharedStore->GetChangeCounter();
+	if (ChangeCounter == LastChangeCounter)
+	{
+		return false;
+	}
+
+	SharedStore->ReadAll(InOutStore);
+	LastChangeCounter = ChangeCounter;
+	return true;
+}
+
+void FScenarioSharedStatsBackend::Shutdown(const FScenarioStatsStore& Store)
+{
+	// Keep the snapshot current, so a lost shared file can be seeded again
+	FScenarioStatsStore SharedStats;
+	SharedStore->ReadAll(SharedStats);
+	SharedStore->Sync();
+	SharedStore.Reset();
+
+	FScenarioFileStatsBackend::SaveSnapshot(Paths.Snapshot, SharedStats, JournalSequence);
+}
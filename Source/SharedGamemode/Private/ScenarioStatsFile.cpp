@@ -0,0 +1,669 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioStatsFile.h"
+
+#include "JsonObjectConverter.h"
+#include "Misc/Crc.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace ScenarioStatsFile
+{
+	// Magic, version, header size, string count, stats count, rotation count, payload size, payload CRC, journal sequence, history count
+	static constexpr int32 HeaderSize = 40;
+
+	// Version 1 had no journal sequence, version 2 no history
+	static constexpr int32 HeaderSizeV1 = 28;
+	static constexpr int32 HeaderSizeV2 = 36;
+
+	// Type index, name index, times played, total votes, average player count, last played ticks
+	static constexpr int32 StatsRecordSize = 28;
+
+	// Type index, name index, weight, minimum gap, minimum matches; version 3 and older have no minimum matches
+	static constexpr int32 RotationRecordSize = 20;
+	static constexpr int32 RotationRecordSizeV3 = 16;
+
+	// History records follow the rotation records: type index, name index, hourly bucket count, daily bucket
+	// count, then only the buckets in use, each as its ring index and FScenarioStatsBucket fields.
+	// Unused buckets are skipped, so a rarely played scenario costs a few bytes.
+	static constexpr int32 HistoryRecordMinSize = 10;
+
+	// A string is its UTF-8 length followed by the bytes, so an empty one still takes the length
+	static constexpr int32 StringRecordMinSize = 2;
+
+	static int32 GetHeaderSize(uint16 Version)
+	{
+		return Version >= 3 ? HeaderSize : Version == 2 ? HeaderSizeV2 : HeaderSizeV1;
+	}
+
+	static int32 GetRotationRecordSize(uint16 Version)
+	{
+		return Version >= 4 ? RotationRecordSize : RotationRecordSizeV3;
+	}
+
+	struct FHeader
+	{
+		uint32 Magic = 0;
+		uint16 Version = 0;
+		uint16 HeaderSize = 0;
+		uint32 NumStrings = 0;
+		uint32 NumStats = 0;
+		uint32 NumRotationEntries = 0;
+		uint32 PayloadSize = 0;
+		uint32 PayloadCrc = 0;
+		uint64 JournalSequence = 0;
+		uint32 NumHistories = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FHeader& Header)
+		{
+			Ar << Header.Magic << Header.Version << Header.HeaderSize << Header.NumStrings
+				<< Header.NumStats << Header.NumRotationEntries << Header.PayloadSize << Header.PayloadCrc;
+			if (Ar.IsSaving() || Header.Version >= 2)
+			{
+				Ar << Header.JournalSequence;
+			}
+			if (Ar.IsSaving() || Header.Version >= 3)
+			{
+				Ar << Header.NumHistories;
+			}
+			return Ar;
+		}
+	};
+
+	// Journal record prefix: CRC of the rest of the record, then its size
+	static constexpr int32 JournalPrefixSize = 6;
+
+	static void WriteName(FArchive& Ar, FName Name)
+	{
+		const FTCHARToUTF8 Utf8(*Name.ToString());
+		uint16 Length = static_cast<uint16>(FMath::Min(Utf8.Length(), static_cast<int32>(MAX_uint16)));
+		Ar << Length;
+		Ar.Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Length);
+	}
+
+	static bool ReadName(FArchive& Ar, const TArray<uint8>& Bytes, FName& OutName)
+	{
+		uint16 Length = 0;
+		Ar << Length;
+		if (Ar.IsError() || Ar.Tell() + Length > Bytes.Num())
+		{
+			return false;
+		}
+		const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Bytes.GetData() + Ar.Tell()), Length);
+		OutName = FName(Converted.Length(), Converted.Get());
+		Ar.Seek(Ar.Tell() + Length);
+		return true;
+	}
+
+	static void SerializeBucket(FArchive& Ar, FScenarioStatsBucket& Bucket)
+	{
+		Ar << Bucket.Epoch << Bucket.Plays << Bucket.Votes << Bucket.PlayerCountSamples << Bucket.PlayerCountSum;
+		for (uint16& Count : Bucket.PlayerCountHistogram)
+		{
+			Ar << Count;
+		}
+		Ar << Bucket.DurationSeconds << Bucket.DurationSamples;
+	}
+
+	template<int32 NumBuckets>
+	static void WriteBuckets(FArchive& Ar, const FScenarioStatsBucket (&Buckets)[NumBuckets])
+	{
+		for (uint8 Index = 0; Index < NumBuckets; ++Index)
+		{
+			if (!Buckets[Index].IsEmpty())
+			{
+				FScenarioStatsBucket Bucket = Buckets[Index];
+				Ar << Index;
+				SerializeBucket(Ar, Bucket);
+			}
+		}
+	}
+
+	template<int32 NumBuckets>
+	static bool ReadBuckets(FArchive& Ar, uint8 Count, FScenarioStatsBucket (&Buckets)[NumBuckets])
+	{
+		for (uint8 Read = 0; Read < Count; ++Read)
+		{
+			uint8 Index = 0;
+			Ar << Index;
+			if (Index >= NumBuckets)
+			{
+				return false;
+			}
+			SerializeBucket(Ar, Buckets[Index]);
+		}
+		return !Ar.IsError();
+	}
+
+	template<int32 NumBuckets>
+	static uint8 CountBuckets(const FScenarioStatsBucket (&Buckets)[NumBuckets])
+	{
+		uint8 Count = 0;
+		for (const FScenarioStatsBucket& Bucket : Buckets)
+		{
+			Count += Bucket.IsEmpty() ? 0 : 1;
+		}
+		return Count;
+	}
+
+	// Builds the string table while records are written
+	struct FStringTable
+	{
+		TMap<FName, uint32> NameToIndex;
+		TArray<FName> Names;
+
+		uint32 Add(FName Name)
+		{
+			if (const uint32* Index = NameToIndex.Find(Name))
+			{
+				return *Index;
+			}
+			const uint32 Index = Names.Add(Name);
+			NameToIndex.Add(Name, Index);
+			return Index;
+		}
+	};
+}
+
+FScenarioStatsDelta FScenarioStatsDelta::MakePlay(const FPrimaryAssetId& ScenarioId, const FDateTime& PlayedAt)
+{
+	FScenarioStatsDelta Delta;
+	Delta.Kind = EScenarioStatsDeltaKind::Play;
+	Delta.ScenarioId = ScenarioId;
+	Delta.Ticks = PlayedAt.GetTicks();
+	return Delta;
+}
+
+FScenarioStatsDelta FScenarioStatsDelta::MakeVotes(const FPrimaryAssetId& ScenarioId, int32 Votes, const FDateTime& VotedAt)
+{
+	FScenarioStatsDelta Delta;
+	Delta.Kind = EScenarioStatsDeltaKind::Votes;
+	Delta.ScenarioId = ScenarioId;
+	Delta.Votes = Votes;
+	Delta.Ticks = VotedAt.GetTicks();
+	return Delta;
+}
+
+FScenarioStatsDelta FScenarioStatsDelta::MakePlayerCountSample(const FPrimaryAssetId& ScenarioId, float PlayerCount, const FDateTime& SampledAt)
+{
+	FScenarioStatsDelta Delta;
+	Delta.Kind = EScenarioStatsDeltaKind::PlayerCountSample;
+	Delta.ScenarioId = ScenarioId;
+	Delta.Value = PlayerCount;
+	Delta.Ticks = SampledAt.GetTicks();
+	return Delta;
+}
+
+FScenarioStatsDelta FScenarioStatsDelta::MakeMatchDuration(const FPrimaryAssetId& ScenarioId, float Seconds, const FDateTime& EndedAt)
+{
+	FScenarioStatsDelta Delta;
+	Delta.Kind = EScenarioStatsDeltaKind::MatchDuration;
+	Delta.ScenarioId = ScenarioId;
+	Delta.Value = Seconds;
+	Delta.Ticks = EndedAt.GetTicks();
+	return Delta;
+}
+
+FScenarioStatsDelta FScenarioStatsDelta::MakeStats(const FScenarioStats& Stats)
+{
+	FScenarioStatsDelta Delta;
+	Delta.Kind = EScenarioStatsDeltaKind::Stats;
+	Delta.ScenarioId = Stats.ScenarioId;
+	Delta.Count = Stats.TimesPlayed;
+	Delta.Votes = Stats.TotalVotes;
+	Delta.Value = Stats.AveragePlayerCount;
+	Delta.Ticks = Stats.LastPlayed.GetTicks();
+	return Delta;
+}
+
+FScenarioStatsDelta FScenarioStatsDelta::MakeRotationEntry(const FScenarioRotationEntry& Entry)
+{
+	FScenarioStatsDelta Delta;
+	Delta.Kind = EScenarioStatsDeltaKind::RotationEntry;
+	Delta.ScenarioId = Entry.ScenarioId;
+	Delta.Count = Entry.MinimumGapBetweenPlays;
+	Delta.Votes = Entry.MinimumMatchesBetweenPlays;
+	Delta.Value = Entry.Weight;
+	return Delta;
+}
+
+void FScenarioStatsDelta::Apply(FScenarioStatsStore& Store) const
+{
+	if (Kind == EScenarioStatsDeltaKind::RotationEntry)
+	{
+		Store.RotationEntries.RemoveAll([this](const FScenarioRotationEntry& ExistingEntry) {
+			return ExistingEntry.ScenarioId == ScenarioId;
+		});
+
+		FScenarioRotationEntry& Entry = Store.RotationEntries.AddDefaulted_GetRef();
+		Entry.ScenarioId = ScenarioId;
+		Entry.Weight = Value;
+		Entry.MinimumGapBetweenPlays = Count;
+		Entry.MinimumMatchesBetweenPlays = Votes;
+		return;
+	}
+
+	// Time-bucketed history; records written before it existed carry no time
+	const FDateTime Time(Ticks);
+	FScenarioStatsHistory* History = Ticks > 0 && Kind != EScenarioStatsDeltaKind::Stats ? &Store.History.FindOrAdd(ScenarioId) : nullptr;
+
+	if (Kind == EScenarioStatsDeltaKind::MatchDuration)
+	{
+		if (History)
+		{
+			History->AddDuration(Time, Value);
+		}
+		return;
+	}
+
+	FScenarioStats& Record = Store.Stats.FindOrAdd(ScenarioId);
+	Record.ScenarioId = ScenarioId;
+
+	switch (Kind)
+	{
+	case EScenarioStatsDeltaKind::Play:
+		Record.TimesPlayed++;
+		Record.LastPlayed = Time;
+		if (History)
+		{
+			History->AddPlay(Time);
+		}
+		break;
+	case EScenarioStatsDeltaKind::Votes:
+		Record.TotalVotes += Votes;
+		if (History)
+		{
+			History->AddVotes(Time, Votes);
+		}
+		break;
+	case EScenarioStatsDeltaKind::PlayerCountSample:
+		if (Record.TimesPlayed > 0)
+		{
+			Record.AveragePlayerCount = ((Record.AveragePlayerCount * (Record.TimesPlayed - 1)) + Value) / Record.TimesPlayed;
+		}
+		if (History)
+		{
+			History->AddPlayerCount(Time, Value);
+		}
+		break;
+	case EScenarioStatsDeltaKind::Stats:
+		Record.TimesPlayed = Count;
+		Record.TotalVotes = Votes;
+		Record.AveragePlayerCount = Value;
+		Record.LastPlayed = Time;
+		break;
+	default:
+		break;
+	}
+}
+
+void FScenarioStatsFile::Write(const FScenarioStatsStore& Store, uint64 JournalSequence, TArray<uint8>& OutBytes)
+{
+	using namespace ScenarioStatsFile;
+
+	const TMap<FPrimaryAssetId, FScenarioStats>& Stats = Store.Stats;
+	const TArray<FScenarioRotationEntry>& RotationEntries = Store.RotationEntries;
+
+	FStringTable Strings;
+	for (const TPair<FPrimaryAssetId, FScenarioStats>& Pair : Stats)
+	{
+		Strings.Add(Pair.Value.ScenarioId.PrimaryAssetType.GetName());
+		Strings.Add(Pair.Value.ScenarioId.PrimaryAssetName);
+	}
+	for (const FScenarioRotationEntry& Entry : RotationEntries)
+	{
+		Strings.Add(Entry.ScenarioId.PrimaryAssetType.GetName());
+		Strings.Add(Entry.ScenarioId.PrimaryAssetName);
+	}
+	for (const TPair<FPrimaryAssetId, FScenarioStatsHistory>& Pair : Store.History)
+	{
+		Strings.Add(Pair.Key.PrimaryAssetType.GetName());
+		Strings.Add(Pair.Key.PrimaryAssetName);
+	}
+
+	OutBytes.Reset();
+	FMemoryWriter Writer(OutBytes);
+
+	// Placeholder, rewritten once the payload CRC is known
+	FHeader Header;
+	Writer << Header;
+
+	for (const FName& Name : Strings.Names)
+	{
+		WriteName(Writer, Name);
+	}
+
+	for (const TPair<FPrimaryAssetId, FScenarioStats>& Pair : Stats)
+	{
+		const FScenarioStats& Record = Pair.Value;
+		uint32 TypeIndex = Strings.Add(Record.ScenarioId.PrimaryAssetType.GetName());
+		uint32 NameIndex = Strings.Add(Record.ScenarioId.PrimaryAssetName);
+		int32 TimesPlayed = Record.TimesPlayed;
+		int32 TotalVotes = Record.TotalVotes;
+		float AveragePlayerCount = Record.AveragePlayerCount;
+		int64 LastPlayedTicks = Record.LastPlayed.GetTicks();
+		Writer << TypeIndex << NameIndex << TimesPlayed << TotalVotes << AveragePlayerCount << LastPlayedTicks;
+	}
+
+	for (const FScenarioRotationEntry& Entry : RotationEntries)
+	{
+		uint32 TypeIndex = Strings.Add(Entry.ScenarioId.PrimaryAssetType.GetName());
+		uint32 NameIndex = Strings.Add(Entry.ScenarioId.PrimaryAssetName);
+		float Weight = Entry.Weight;
+		int32 MinimumGapBetweenPlays = Entry.MinimumGapBetweenPlays;
+		int32 MinimumMatchesBetweenPlays = Entry.MinimumMatchesBetweenPlays;
+		Writer << TypeIndex << NameIndex << Weight << MinimumGapBetweenPlays << MinimumMatchesBetweenPlays;
+	}
+
+	uint32 NumHistories = 0;
+	for (const TPair<FPrimaryAssetId, FScenarioStatsHistory>& Pair : Store.History)
+	{
+		uint8 NumHourly = CountBuckets(Pair.Value.Hourly);
+		uint8 NumDaily = CountBuckets(Pair.Value.Daily);
+		if (NumHourly == 0 && NumDaily == 0)
+		{
+			continue;
+		}
+
+		uint32 TypeIndex = Strings.Add(Pair.Key.PrimaryAssetType.GetName());
+		uint32 NameIndex = Strings.Add(Pair.Key.PrimaryAssetName);
+		Writer << TypeIndex << NameIndex << NumHourly << NumDaily;
+		WriteBuckets(Writer, Pair.Value.Hourly);
+		WriteBuckets(Writer, Pair.Value.Daily);
+		++NumHistories;
+	}
+
+	Header.Magic = Magic;
+	Header.Version = CurrentVersion;
+	Header.HeaderSize = HeaderSize;
+	Header.NumStrings = Strings.Names.Num();
+	Header.NumStats = Stats.Num();
+	Header.NumRotationEntries = RotationEntries.Num();
+	Header.PayloadSize = OutBytes.Num() - HeaderSize;
+	Header.PayloadCrc = FCrc::MemCrc32(OutBytes.GetData() + HeaderSize, Header.PayloadSize);
+	Header.JournalSequence = JournalSequence;
+	Header.NumHistories = NumHistories;
+
+	Writer.Seek(0);
+	Writer << Header;
+}
+
+bool FScenarioStatsFile::Read(const TArray<uint8>& Bytes, FScenarioStatsStore& OutStore, uint64& OutJournalSequence, FString& OutError)
+{
+	using namespace ScenarioStatsFile;
+
+	if (Bytes.Num() < HeaderSizeV1)
+	{
+		OutError = TEXT("file is shorter than its header");
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	FHeader Header;
+	Reader << Header;
+
+	if (Header.Magic != Magic)
+	{
+		OutError = TEXT("not a scenario stats file");
+		return false;
+	}
+	if (Header.Version == 0 || Header.Version > CurrentVersion)
+	{
+		OutError = FString::Printf(TEXT("unsupported schema version %d"), Header.Version);
+		return false;
+	}
+	if (Header.HeaderSize < GetHeaderSize(Header.Version) || static_cast<int64>(Header.HeaderSize) + Header.PayloadSize != Bytes.Num())
+	{
+		OutError = TEXT("size does not match header");
+		return false;
+	}
+	if (FCrc::MemCrc32(Bytes.GetData() + Header.HeaderSize, Header.PayloadSize) != Header.PayloadCrc)
+	{
+		OutError = TEXT("checksum mismatch");
+		return false;
+	}
+
+	// The counts are outside the CRC, so bound them by the payload before anything is allocated from them
+	const int64 MinPayloadSize = static_cast<int64>(Header.NumStrings) * StringRecordMinSize
+		+ static_cast<int64>(Header.NumStats) * StatsRecordSize
+		+ static_cast<int64>(Header.NumRotationEntries) * GetRotationRecordSize(Header.Version)
+		+ static_cast<int64>(Header.NumHistories) * HistoryRecordMinSize;
+	if (MinPayloadSize > Header.PayloadSize)
+	{
+		OutError = TEXT("record counts do not fit the payload");
+		return false;
+	}
+
+	// Later versions may grow the header; skip whatever this version does not know about
+	Reader.Seek(Header.HeaderSize);
+
+	TArray<FName> Names;
+	Names.Reserve(Header.NumStrings);
+	for (uint32 StringIndex = 0; StringIndex < Header.NumStrings; ++StringIndex)
+	{
+		if (!ReadName(Reader, Bytes, Names.AddDefaulted_GetRef()))
+		{
+			OutError = TEXT("truncated string table");
+			return false;
+		}
+	}
+
+	const int64 ExpectedRemaining = static_cast<int64>(Header.NumStats) * StatsRecordSize + static_cast<int64>(Header.NumRotationEntries) * GetRotationRecordSize(Header.Version);
+	const int64 Remaining = Bytes.Num() - Reader.Tell();
+	if (Header.Version >= 3 ? Remaining < ExpectedRemaining : Remaining != ExpectedRemaining)
+	{
+		OutError = TEXT("record section size does not match header");
+		return false;
+	}
+
+	auto MakeId = [&Names](uint32 TypeIndex, uint32 NameIndex, FPrimaryAssetId& OutId)
+	{
+		if (!Names.IsValidIndex(TypeIndex) || !Names.IsValidIndex(NameIndex))
+		{
+			return false;
+		}
+		OutId = FPrimaryAssetId(FPrimaryAssetType(Names[TypeIndex]), Names[NameIndex]);
+		return true;
+	};
+
+	TMap<FPrimaryAssetId, FScenarioStats> Stats;
+	Stats.Reserve(Header.NumStats);
+	for (uint32 RecordIndex = 0; RecordIndex < Header.NumStats; ++RecordIndex)
+	{
+		uint32 TypeIndex = 0;
+		uint32 NameIndex = 0;
+		int64 LastPlayedTicks = 0;
+		FScenarioStats Record;
+		Reader << TypeIndex << NameIndex << Record.TimesPlayed << Record.TotalVotes << Record.AveragePlayerCount << LastPlayedTicks;
+		if (!MakeId(TypeIndex, NameIndex, Record.ScenarioId))
+		{
+			OutError = TEXT("stats record references a missing string");
+			return false;
+		}
+		Record.LastPlayed = FDateTime(LastPlayedTicks);
+		Stats.Add(Record.ScenarioId, Record);
+	}
+
+	TArray<FScenarioRotationEntry> RotationEntries;
+	RotationEntries.Reserve(Header.NumRotationEntries);
+	for (uint32 RecordIndex = 0; RecordIndex < Header.NumRotationEntries; ++RecordIndex)
+	{
+		uint32 TypeIndex = 0;
+		uint32 NameIndex = 0;
+		FScenarioRotationEntry Entry;
+		Reader << TypeIndex << NameIndex << Entry.Weight << Entry.MinimumGapBetweenPlays;
+		if (Header.Version >= 4)
+		{
+			Reader << Entry.MinimumMatchesBetweenPlays;
+		}
+		if (!MakeId(TypeIndex, NameIndex, Entry.ScenarioId))
+		{
+			OutError = TEXT("rotation record references a missing string");
+			return false;
+		}
+		RotationEntries.Add(Entry);
+	}
+
+	TMap<FPrimaryAssetId, FScenarioStatsHistory> History;
+	History.Reserve(Header.NumHistories);
+	for (uint32 RecordIndex = 0; RecordIndex < Header.NumHistories; ++RecordIndex)
+	{
+		uint32 TypeIndex = 0;
+		uint32 NameIndex = 0;
+		uint8 NumHourly = 0;
+		uint8 NumDaily = 0;
+		FPrimaryAssetId ScenarioId;
+		Reader << TypeIndex << NameIndex << NumHourly << NumDaily;
+		if (!MakeId(TypeIndex, NameIndex, ScenarioId))
+		{
+			OutError = TEXT("history record references a missing string");
+			return false;
+		}
+
+		FScenarioStatsHistory& ScenarioHistory = History.Add(ScenarioId);
+		if (!ReadBuckets(Reader, NumHourly, ScenarioHistory.Hourly) || !ReadBuckets(Reader, NumDaily, ScenarioHistory.Daily))
+		{
+			OutError = TEXT("damaged history record");
+			return false;
+		}
+	}
+
+	if (Reader.IsError() || Reader.Tell() != Bytes.Num())
+	{
+		OutError = TEXT("record section size does not match header");
+		return false;
+	}
+
+	OutStore.Stats = MoveTemp(Stats);
+	OutStore.RotationEntries = MoveTemp(RotationEntries);
+	OutStore.History = MoveTemp(History);
+	OutJournalSequence = Header.JournalSequence;
+	return true;
+}
+
+void FScenarioStatsFile::AppendJournalRecord(const FScenarioStatsDelta& Delta, uint64 Sequence, TArray<uint8>& OutBytes)
+{
+	using namespace ScenarioStatsFile;
+
+	const int32 RecordStart = OutBytes.Num();
+	FMemoryWriter Writer(OutBytes);
+	Writer.Seek(RecordStart);
+
+	// Placeholder prefix, rewritten once the record is complete
+	uint32 Crc = 0;
+	uint16 Size = 0;
+	Writer << Crc << Size;
+
+	uint8 Kind = static_cast<uint8>(Delta.Kind);
+	int32 Count = Delta.Count;
+	int32 Votes = Delta.Votes;
+	float Value = Delta.Value;
+	int64 Ticks = Delta.Ticks;
+	Writer << Sequence << Kind << Count << Votes << Value << Ticks;
+	WriteName(Writer, Delta.ScenarioId.PrimaryAssetType.GetName());
+	WriteName(Writer, Delta.ScenarioId.PrimaryAssetName);
+
+	const int32 BodyStart = RecordStart + JournalPrefixSize;
+	Size = static_cast<uint16>(OutBytes.Num() - BodyStart);
+	Crc = FCrc::MemCrc32(OutBytes.GetData() + BodyStart, Size);
+	Writer.Seek(RecordStart);
+	Writer << Crc << Size;
+}
+
+int32 FScenarioStatsFile::ReadJournal(const TArray<uint8>& Bytes, uint64 AfterSequence, TFunctionRef<void(uint64 Sequence, const FScenarioStatsDelta& Delta)> Visitor)
+{
+	using namespace ScenarioStatsFile;
+
+	int32 NumVisited = 0;
+
+	FMemoryReader Reader(Bytes);
+	while (Reader.Tell() + JournalPrefixSize <= Bytes.Num())
+	{
+		uint32 Crc = 0;
+		uint16 Size = 0;
+		Reader << Crc << Size;
+
+		// A crash mid-append leaves a short or damaged tail; everything before it is still good
+		const int64 BodyStart = Reader.Tell();
+		if (BodyStart + Size > Bytes.Num() || FCrc::MemCrc32(Bytes.GetData() + BodyStart, Size) != Crc)
+		{
+			break;
+		}
+
+		uint64 Sequence = 0;
+		uint8 Kind = 0;
+		FName TypeName;
+		FName AssetName;
+		FScenarioStatsDelta Delta;
+		Reader << Sequence << Kind << Delta.Count << Delta.Votes << Delta.Value << Delta.Ticks;
+		if (!ReadName(Reader, Bytes, TypeName) || !ReadName(Reader, Bytes, AssetName)
+			|| Kind > static_cast<uint8>(EScenarioStatsDeltaKind::MatchDuration))
+		{
+			break;
+		}
+		Reader.Seek(BodyStart + Size);
+
+		if (Sequence <= AfterSequence)
+		{
+			continue;
+		}
+
+		Delta.Kind = static_cast<EScenarioStatsDeltaKind>(Kind);
+		Delta.ScenarioId = FPrimaryAssetId(FPrimaryAssetType(TypeName), AssetName);
+		Visitor(Sequence, Delta);
+		++NumVisited;
+	}
+
+	return NumVisited;
+}
+
+int32 FScenarioStatsFile::ReplayJournal(const TArray<uint8>& Bytes, uint64 AfterSequence, FScenarioStatsStore& Store, uint64& OutLastSequence)
+{
+	OutLastSequence = AfterSequence;
+	return ReadJournal(Bytes, AfterSequence, [&](uint64 Sequence, const FScenarioStatsDelta& Delta)
+	{
+		Delta.Apply(Store);
+		OutLastSequence = FMath::Max(OutLastSequence, Sequence);
+	});
+}
+
+bool FScenarioStatsFile::ImportJson(const FString& JsonString, FScenarioStatsStore& OutStore)
+{
+	TSharedPtr<FJsonObject> JsonObject;
+	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+	if (!FJsonSerializer::Deserialize(Reader, JsonObject) || !JsonObject.IsValid())
+	{
+		return false;
+	}
+
+	// Load scenario statistics
+	const TArray<TSharedPtr<FJsonValue>>* StatsArray;
+	if (JsonObject->TryGetArrayField(TEXT("ScenarioStats"), StatsArray))
+	{
+		for (const auto& JsonValue : *StatsArray)
+		{
+			FScenarioStats Stats;
+			if (FJsonObjectConverter::JsonObjectToUStruct(JsonValue->AsObject().ToSharedRef(), &Stats))
+			{
+				OutStore.Stats.Add(Stats.ScenarioId, Stats);
+			}
+		}
+	}
+
+	// Load rotation entries
+	const TArray<TSharedPtr<FJsonValue>>* RotationArray;
+	if (JsonObject->TryGetArrayField(TEXT("RotationEntries"), RotationArray))
+	{
+		for (const auto& JsonValue : *RotationArray)
+		{
+			FScenarioRotationEntry Entry;
+			if (FJsonObjectConverter::JsonObjectToUStruct(JsonValue->AsObject().ToSharedRef(), &Entry))
+			{
+				OutStore.RotationEntries.Add(Entry);
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,162 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "ScenarioStatsHistory.h"
+
+namespace ScenarioStatsHistory
+{
+	// Returns the bucket for Epoch, recycling it if it holds an older period, or null if it holds a newer one
+	static FScenarioStatsBucket* ClaimBucket(FScenarioStatsBucket* Buckets, int32 NumBuckets, int32 Epoch)
+	{
+		FScenarioStatsBucket& Bucket = Buckets[Epoch % NumBuckets];
+		if (Bucket.Epoch > Epoch)
+		{
+			return nullptr;
+		}
+		if (Bucket.Epoch < Epoch)
+		{
+			Bucket = FScenarioStatsBucket();
+			Bucket.Epoch = Epoch;
+		}
+		return &Bucket;
+	}
+
+	static void Accumulate(FScenarioPopularity& Popularity, const FScenarioStatsBucket& Bucket, int64& PlayerCountSamples, int64& PlayerCountSum, int64& DurationSamples, int64& DurationSeconds)
+	{
+		Popularity.Plays += Bucket.Plays;
+		Popularity.Votes += Bucket.Votes;
+		for (int32 Bin = 0; Bin < FScenarioStatsBucket::NumPlayerCountBins; ++Bin)
+		{
+			Popularity.PlayerCountHistogram[Bin] += Bucket.PlayerCountHistogram[Bin];
+		}
+		PlayerCountSamples += Bucket.PlayerCountSamples;
+		PlayerCountSum += Bucket.PlayerCountSum;
+		DurationSamples += Bucket.DurationSamples;
+		DurationSeconds += Bucket.DurationSeconds;
+	}
+}
+
+int32 FScenarioStatsBucket::GetPlayerCountBin(float PlayerCount)
+{
+	return FMath::Min(static_cast<int32>(FMath::FloorLog2(FMath::Max(FMath::RoundToInt32(PlayerCount), 1))), NumPlayerCountBins - 1);
+}
+
+int32 FScenarioStatsHistory::GetHourEpoch(const FDateTime& Time)
+{
+	return static_cast<int32>(Time.GetTicks() / ETimespan::TicksPerHour);
+}
+
+int32 FScenarioStatsHistory::GetDayEpoch(const FDateTime& Time)
+{
+	return static_cast<int32>(Time.GetTicks() / ETimespan::TicksPerDay);
+}
+
+template<typename FunctorType>
+void FScenarioStatsHistory::AddToBuckets(const FDateTime& Time, FunctorType&& Functor)
+{
+	// Records from before time-bucketing have no timestamp
+	if (Time.GetTicks() <= 0)
+	{
+		return;
+	}
+
+	if (FScenarioStatsBucket* Bucket = ScenarioStatsHistory::ClaimBucket(Hourly, NumHourlyBuckets, GetHourEpoch(Time)))
+	{
+		Functor(*Bucket);
+	}
+	if (FScenarioStatsBucket* Bucket = ScenarioStatsHistory::ClaimBucket(Daily, NumDailyBuckets, GetDayEpoch(Time)))
+	{
+		Functor(*Bucket);
+	}
+}
+
+void FScenarioStatsHistory::AddPlay(const FDateTime& Time)
+{
+	AddToBuckets(Time, [](FScenarioStatsBucket& Bucket) { Bucket.Plays++; });
+}
+
+void FScenarioStatsHistory::AddVotes(const FDateTime& Time, int32 Votes)
+{
+	AddToBuckets(Time, [Votes](FScenarioStatsBucket& Bucket) { Bucket.Votes += Votes; });
+}
+
+void FScenarioStatsHistory::AddPlayerCount(const FDateTime& Time, float PlayerCount)
+{
+	const int32 Bin = FScenarioStatsBucket::GetPlayerCountBin(PlayerCount);
+	const int32 RoundedCount = FMath::RoundToInt32(PlayerCount);
+	AddToBuckets(Time, [Bin, RoundedCount](FScenarioStatsBucket& Bucket)
+	{
+		Bucket.PlayerCountSamples++;
+		Bucket.PlayerCountSum += RoundedCount;
+		Bucket.PlayerCountHistogram[Bin] = static_cast<uint16>(FMath::Min<int32>(Bucket.PlayerCountHistogram[Bin] + 1, MAX_uint16));
+	});
+}
+
+void FScenarioStatsHistory::AddDuration(const FDateTime& Time, float Seconds)
+{
+	const int32 RoundedSeconds = FMath::Max(FMath::RoundToInt32(Seconds), 0);
+	AddToBuckets(Time, [RoundedSeconds](FScenarioStatsBucket& Bucket)
+	{
+		Bucket.DurationSamples++;
+		Bucket.DurationSeconds += RoundedSeconds;
+	});
+}
+
+FScenarioPopularity FScenarioStatsHistory::GetPopularity(const FDateTime& Now, int32 Hours) const
+{
+	FScenarioPopularity Popularity;
+	int64 PlayerCountSamples = 0;
+	int64 PlayerCountSum = 0;
+	int64 DurationSamples = 0;
+	int64 DurationSeconds = 0;
+
+	if (Hours <= NumHourlyBuckets)
+	{
+		const int32 CurrentHour = GetHourEpoch(Now);
+		for (int32 Epoch = CurrentHour - Hours + 1; Epoch <= CurrentHour; ++Epoch)
+		{
+			const FScenarioStatsBucket& Bucket = Hourly[Epoch % NumHourlyBuckets];
+			if (Bucket.Epoch == Epoch)
+			{
+				ScenarioStatsHistory::Accumulate(Popularity, Bucket, PlayerCountSamples, PlayerCountSum, DurationSamples, DurationSeconds);
+			}
+		}
+	}
+	else
+	{
+		// Longer windows round up to whole days
+		const int32 Days = FMath::Min(FMath::DivideAndRoundUp(Hours, 24), NumDailyBuckets);
+		const int32 CurrentDay = GetDayEpoch(Now);
+		for (int32 Epoch = CurrentDay - Days + 1; Epoch <= CurrentDay; ++Epoch)
+		{
+			const FScenarioStatsBucket& Bucket = Daily[Epoch % NumDailyBuckets];
+			if (Bucket.Epoch == Epoch)
+			{
+				ScenarioStatsHistory::Accumulate(Popularity, Bucket, PlayerCountSamples, PlayerCountSum, DurationSamples, DurationSeconds);
+			}
+		}
+	}
+
+	Popularity.AveragePlayerCount = PlayerCountSamples > 0 ? static_cast<float>(PlayerCountSum) / PlayerCountSamples : 0.0f;
+	Popularity.AverageDurationSeconds = DurationSamples > 0 ? static_cast<float>(DurationSeconds) / DurationSamples : 0.0f;
+	return Popularity;
+}
+
+bool FScenarioStatsHistory::IsEmpty() const
+{
+	for (const FScenarioStatsBucket& Bucket : Hourly)
+	{
+		if (!Bucket.IsEmpty())
+		{
+			return false;
+		}
+	}
+	for (const FScenarioStatsBucket& Bucket : Daily)
+	{
+		if (!Bucket.IsEmpty())
+		{
+			return false;
+		}
+	}
+	return true;
+}
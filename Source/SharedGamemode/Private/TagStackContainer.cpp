@@ -3,11 +3,81 @@
 
 #include "TagStackContainer.h"
 
+#include "Misc/CoreDelegates.h"
+
+bool FTagStack::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	// The tag's own serializer sends the fast replication net index when the project enables it
+	Tag.NetSerialize(Ar, Map, bOutSuccess);
+
+	uint8 bQuantized = Ar.IsSaving() && bAllowQuantizedCount && FMath::Abs(StackCount) >= QuantizeThreshold;
+	Ar.SerializeBits(&bQuantized, 1);
+
+	if (bQuantized)
+	{
+		// Sign, 5 bit exponent and the top mantissa bits below the implicit leading one
+		uint8 bNegative = 0;
+		uint8 Exponent = 0;
+		uint32 Mantissa = 0;
+
+		if (Ar.IsSaving())
+		{
+			const uint32 Magnitude = StackCount < 0 ? 0u - static_cast<uint32>(StackCount) : static_cast<uint32>(StackCount);
+			bNegative = StackCount < 0;
+			Exponent = static_cast<uint8>(FMath::FloorLog2(Magnitude));
+
+			// Round to nearest, carrying into the exponent if the mantissa overflows
+			const int32 Shift = Exponent - QuantizedMantissaBits;
+			Mantissa = (Magnitude + (1u << (Shift - 1))) >> Shift;
+			if (Mantissa >> (QuantizedMantissaBits + 1))
+			{
+				Mantissa >>= 1;
+				Exponent++;
+			}
+			Mantissa &= (1u << QuantizedMantissaBits) - 1;
+		}
+
+		Ar.SerializeBits(&bNegative, 1);
+		Ar.SerializeBits(&Exponent, 5);
+		Ar.SerializeBits(&Mantissa, QuantizedMantissaBits);
+
+		if (Ar.IsLoading())
+		{
+			const int32 Shift = FMath::Max(Exponent - QuantizedMantissaBits, 0);
+			const uint64 Magnitude = static_cast<uint64>((1u << QuantizedMantissaBits) | Mantissa) << Shift;
+			const int64 Value = bNegative ? -static_cast<int64>(Magnitude) : static_cast<int64>(Magnitude);
+			StackCount = static_cast<int32>(FMath::Clamp<int64>(Value, MIN_int32, MAX_int32));
+		}
+	}
+	else
+	{
+		// Zig-zag so small negative counts stay small, then a 7-bit varint
+		uint32 Encoded = Ar.IsSaving() ? (static_cast<uint32>(StackCount) << 1) ^ static_cast<uint32>(StackCount >> 31) : 0;
+		Ar.SerializeIntPacked(Encoded);
+
+		if (Ar.IsLoading())
+		{
+			StackCount = static_cast<int32>(Encoded >> 1) ^ -static_cast<int32>(Encoded & 1);
+		}
+	}
+
+	bOutSuccess = bOutSuccess && !Ar.IsError();
+	return true;
+}
+
 FString FTagStack::GetDebugString() const
 {
 	return FString::Printf(TEXT("%s x%d"), *Tag.ToString(), StackCount);
 }
 
+FTagStackPendingNotifications::~FTagStackPendingNotifications()
+{
+	if (EndFrameHandle.IsValid())
+	{
+		FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	}
+}
+
 FTagStackContainer::FTagStackContainer()
 {
 }
@@ -24,32 +94,27 @@ void FTagStackContainer::AddStack(FGameplayTag Tag, int32 StackCount)
 	if (StackCount > 0)
 	{
 		// Try to find existing stack
-		for (FTagStack& Stack : Stacks)
+		if (FSlot* Slot = TagToSlotMap.Find(Tag))
 		{
-			if (Stack.Tag == Tag)
-			{
-				// Found existing stack - update it
-				const int32 OldCount = Stack.StackCount;
-				const int32 NewCount = OldCount + StackCount;
-				Stack.StackCount = NewCount;
+			// Found existing stack - update it
+			FTagStack& Stack = Stacks[Slot->Index];
+			const int32 OldCount = Stack.StackCount;
+			const int32 NewCount = OldCount + StackCount;
+			Stack.StackCount = NewCount;
                 
-				// Update lookup map
-				TagToCountMap[Tag] = NewCount;
+			// Update lookup map
+			Slot->Count = NewCount;
                 
-				// Mark for replication
-				MarkItemDirty(Stack);
+			// Mark for replication
+			MarkItemDirty(Stack);
                 
-				// Notify listeners
-				OnTagCountChanged.Broadcast(Tag, NewCount, OldCount);
-				return;
-			}
+			// Notify listeners
+			NotifyStackChanged(Tag, NewCount, OldCount);
+			return;
 		}
 
 		// No existing stack found - create new one
-		FTagStack& NewStack = Stacks.Emplace_GetRef(Tag, StackCount);
-		MarkItemDirty(NewStack);
-		TagToCountMap.Add(Tag, StackCount);
-		OnTagCountChanged.Broadcast(Tag, StackCount, 0);
+		AddNewStack(Tag, StackCount);
 	}
 }
 
@@ -63,31 +128,26 @@ void FTagStackContainer::RemoveStack(FGameplayTag Tag, int32 StackCount)
 	if (StackCount > 0)
 	{
 		// Find and update existing stack
-		for (auto It = Stacks.CreateIterator(); It; ++It)
+		if (FSlot* Slot = TagToSlotMap.Find(Tag))
 		{
-			FTagStack& Stack = *It;
-			if (Stack.Tag == Tag)
-			{
-				const int32 OldCount = Stack.StackCount;
+			FTagStack& Stack = Stacks[Slot->Index];
+			const int32 OldCount = Stack.StackCount;
                 
-				if (Stack.StackCount <= StackCount)
-				{
-					// Removing all stacks - remove entry entirely
-					It.RemoveCurrent();
-					TagToCountMap.Remove(Tag);
-					MarkArrayDirty();
-					OnTagCountChanged.Broadcast(Tag, 0, OldCount);
-				}
-				else
-				{
-					// Partial removal - update count
-					const int32 NewCount = Stack.StackCount - StackCount;
-					Stack.StackCount = NewCount;
-					TagToCountMap[Tag] = NewCount;
-					MarkItemDirty(Stack);
-					OnTagCountChanged.Broadcast(Tag, NewCount, OldCount);
-				}
-				return;
+			if (Stack.StackCount <= StackCount)
+			{
+				// Removing all stacks - remove entry entirely
+				RemoveStackAt(Slot->Index);
+				MarkArrayDirty();
+				NotifyStackChanged(Tag, 0, OldCount);
+			}
+			else
+			{
+				// Partial removal - update count
+				const int32 NewCount = Stack.StackCount - StackCount;
+				Stack.StackCount = NewCount;
+				Slot->Count = NewCount;
+				MarkItemDirty(Stack);
+				NotifyStackChanged(Tag, NewCount, OldCount);
 			}
 		}
 	}
@@ -103,25 +163,20 @@ void FTagStackContainer::SetStack(FGameplayTag Tag, int32 StackCount)
 	if (StackCount > 0)
 	{
 		// Try to find existing stack
-		for (FTagStack& Stack : Stacks)
+		if (FSlot* Slot = TagToSlotMap.Find(Tag))
 		{
-			if (Stack.Tag == Tag)
-			{
-				// Update existing stack
-				const int32 OldCount = Stack.StackCount;
-				Stack.StackCount = StackCount;
-				TagToCountMap[Tag] = StackCount;
-				MarkItemDirty(Stack);
-				OnTagCountChanged.Broadcast(Tag, StackCount, OldCount);
-				return;
-			}
+			// Update existing stack
+			FTagStack& Stack = Stacks[Slot->Index];
+			const int32 OldCount = Stack.StackCount;
+			Stack.StackCount = StackCount;
+			Slot->Count = StackCount;
+			MarkItemDirty(Stack);
+			NotifyStackChanged(Tag, StackCount, OldCount);
+			return;
 		}
 
 		// Create new stack
-		FTagStack& NewStack = Stacks.Emplace_GetRef(Tag, StackCount);
-		MarkItemDirty(NewStack);
-		TagToCountMap.Add(Tag, StackCount);
-		OnTagCountChanged.Broadcast(Tag, StackCount, 0);
+		AddNewStack(Tag, StackCount);
 	}
 }
 
@@ -133,18 +188,12 @@ void FTagStackContainer::ClearStack(FGameplayTag Tag)
 	}
 
 	// Find and remove the stack
-	for (auto It = Stacks.CreateIterator(); It; ++It)
+	if (const FSlot* Slot = TagToSlotMap.Find(Tag))
 	{
-		FTagStack& Stack = *It;
-		if (Stack.Tag == Tag)
-		{
-			const int32 OldCount = Stack.StackCount;
-			It.RemoveCurrent();
-			TagToCountMap.Remove(Tag);
-			MarkArrayDirty();
-			OnTagCountChanged.Broadcast(Tag, 0, OldCount);
-			return;
-		}
+		const int32 OldCount = Stacks[Slot->Index].StackCount;
+		RemoveStackAt(Slot->Index);
+		MarkArrayDirty();
+		NotifyStackChanged(Tag, 0, OldCount);
 	}
 }
 
@@ -154,9 +203,11 @@ void FTagStackContainer::PreReplicatedRemove(const TArrayView<int32> RemovedIndi
 	{
 		const FGameplayTag Tag = Stacks[Index].Tag;
 		const int32 OldCount = Stacks[Index].StackCount;
-		TagToCountMap.Remove(Tag);
-		OnTagCountChanged.Broadcast(Tag, 0, OldCount);
+		TagToSlotMap.Remove(Tag);
+		NotifyStackChanged(Tag, 0, OldCount);
 	}
+
+	PendingReplicatedRemovals.Append(RemovedIndices.GetData(), RemovedIndices.Num());
 }
 
 void FTagStackContainer::PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize)
@@ -164,27 +215,357 @@ void FTagStackContainer::PostReplicatedAdd(const TArrayView<int32> AddedIndices,
 	for (int32 Index : AddedIndices)
 	{
 		const FTagStack& Stack = Stacks[Index];
-		TagToCountMap.Add(Stack.Tag, Stack.StackCount);
-		OnTagCountChanged.Broadcast(Stack.Tag, Stack.StackCount, 0);
+		TagToSlotMap.Add(Stack.Tag, { Index, Stack.StackCount });
+		NotifyStackChanged(Stack.Tag, Stack.StackCount, 0);
 	}
 }
 
 void FTagStackContainer::PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize)
 {
-	    for (int32 Index : ChangedIndices)
-    {
-        const FTagStack& Stack = Stacks[Index];
-        const int32 OldCount = TagToCountMap.FindRef(Stack.Tag);
-        TagToCountMap[Stack.Tag] = Stack.StackCount;
-        OnTagCountChanged.Broadcast(Stack.Tag, Stack.StackCount, OldCount);
-    }
+	for (int32 Index : ChangedIndices)
+	{
+		const FTagStack& Stack = Stacks[Index];
+		FSlot& Slot = TagToSlotMap.FindOrAdd(Stack.Tag);
+		const int32 OldCount = Slot.Count;
+		Slot.Index = Index;
+		Slot.Count = Stack.StackCount;
+		NotifyStackChanged(Stack.Tag, Stack.StackCount, OldCount);
+	}
+}
+
+void FTagStackContainer::PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters)
+{
+	// Removed slots below the final size now hold the entries that were swapped into them
+	for (int32 Index : PendingReplicatedRemovals)
+	{
+		if (Stacks.IsValidIndex(Index))
+		{
+			if (FSlot* Slot = TagToSlotMap.Find(Stacks[Index].Tag))
+			{
+				Slot->Index = Index;
+			}
+		}
+	}
+	PendingReplicatedRemovals.Reset();
+}
+
+void FTagStackContainer::SetQuantizeLargeCounts(bool bInQuantizeLargeCounts)
+{
+	bQuantizeLargeCounts = bInQuantizeLargeCounts;
+	for (FTagStack& Stack : Stacks)
+	{
+		Stack.bAllowQuantizedCount = bQuantizeLargeCounts;
+	}
+}
+
+void FTagStackContainer::AddNewStack(FGameplayTag Tag, int32 StackCount)
+{
+	const int32 Index = Stacks.Emplace(Tag, StackCount);
+	Stacks[Index].bAllowQuantizedCount = bQuantizeLargeCounts;
+	MarkItemDirty(Stacks[Index]);
+	TagToSlotMap.Add(Tag, { Index, StackCount });
+	NotifyStackChanged(Tag, StackCount, 0);
+}
+
+void FTagStackContainer::RemoveStackAt(int32 Index)
+{
+	TagToSlotMap.Remove(Stacks[Index].Tag);
+
+	// Order does not matter for replication, so swap the last entry into the hole
+	Stacks.RemoveAtSwap(Index);
+	if (Stacks.IsValidIndex(Index))
+	{
+		TagToSlotMap.Find(Stacks[Index].Tag)->Index = Index;
+	}
+}
+
+void FTagStackContainer::ApplyBatch(const TMap<FGameplayTag, int32, TInlineSetAllocator<16>>& NewCounts)
+{
+	struct FAppliedChange
+	{
+		FGameplayTag Tag;
+		int32 NewCount;
+		int32 OldCount;
+	};
+	TArray<FAppliedChange, TInlineAllocator<16>> AppliedChanges;
+	bool bRemovedAny = false;
+
+	for (const TPair<FGameplayTag, int32>& Pair : NewCounts)
+	{
+		const FGameplayTag Tag = Pair.Key;
+		const int32 NewCount = FMath::Max(Pair.Value, 0);
+		FSlot* Slot = TagToSlotMap.Find(Tag);
+		const int32 OldCount = Slot ? Slot->Count : 0;
+
+		// Changes that cancelled out within the batch touch nothing
+		if (NewCount == OldCount)
+		{
+			continue;
+		}
+
+		if (NewCount == 0)
+		{
+			RemoveStackAt(Slot->Index);
+			bRemovedAny = true;
+		}
+		else if (Slot)
+		{
+			FTagStack& Stack = Stacks[Slot->Index];
+			Stack.StackCount = NewCount;
+			Slot->Count = NewCount;
+			MarkItemDirty(Stack);
+		}
+		else
+		{
+			const int32 Index = Stacks.Emplace(Tag, NewCount);
+			Stacks[Index].bAllowQuantizedCount = bQuantizeLargeCounts;
+			MarkItemDirty(Stacks[Index]);
+			TagToSlotMap.Add(Tag, { Index, NewCount });
+		}
+
+		UpdateAggregateCounts(Tag, NewCount - OldCount);
+		AppliedChanges.Add({ Tag, NewCount, OldCount });
+	}
+
+	// One array-level dirty covers every removal in the batch
+	if (bRemovedAny)
+	{
+		MarkArrayDirty();
+	}
+
+	// Notify only once the whole batch (aggregates included) is in, so listeners see a consistent container
+	for (const FAppliedChange& Change : AppliedChanges)
+	{
+		OnTagCountChanged.Broadcast(Change.Tag, Change.NewCount, Change.OldCount);
+		RecordCoalescedChange(Change.Tag, Change.NewCount, Change.OldCount);
+		EvaluateThresholdWatchers(Change.Tag, Change.NewCount);
+	}
+}
+
+void FTagStackContainer::NotifyStackChanged(FGameplayTag Tag, int32 NewCount, int32 OldCount)
+{
+	UpdateAggregateCounts(Tag, NewCount - OldCount);
+	OnTagCountChanged.Broadcast(Tag, NewCount, OldCount);
+	RecordCoalescedChange(Tag, NewCount, OldCount);
+	EvaluateThresholdWatchers(Tag, NewCount);
+}
+
+void FTagStackContainer::RecordCoalescedChange(FGameplayTag Tag, int32 NewCount, int32 OldCount)
+{
+	if (!OnTagCountChangedCoalesced.IsBound())
+	{
+		return;
+	}
+
+	if (FTagStackPendingNotifications::FChange* Pending = PendingNotifications.Changes.Find(Tag))
+	{
+		Pending->NewCount = NewCount;
+	}
+	else
+	{
+		PendingNotifications.Changes.Add(Tag, { OldCount, NewCount });
+	}
+
+	// Only hook the end of frame while there is something to deliver
+	if (!PendingNotifications.EndFrameHandle.IsValid())
+	{
+		PendingNotifications.EndFrameHandle = FCoreDelegates::OnEndFrame.AddRaw(this, &FTagStackContainer::FlushCoalescedChanges);
+	}
+}
+
+void FTagStackContainer::FlushCoalescedChanges()
+{
+	if (PendingNotifications.EndFrameHandle.IsValid())
+	{
+		FCoreDelegates::OnEndFrame.Remove(PendingNotifications.EndFrameHandle);
+		PendingNotifications.EndFrameHandle.Reset();
+	}
+
+	// Listeners may change stacks again; those changes go out with the next flush
+	const TMap<FGameplayTag, FTagStackPendingNotifications::FChange> Changes = MoveTemp(PendingNotifications.Changes);
+	PendingNotifications.Changes.Reset();
+
+	for (const TPair<FGameplayTag, FTagStackPendingNotifications::FChange>& Pair : Changes)
+	{
+		if (Pair.Value.NewCount != Pair.Value.OldCount)
+		{
+			OnTagCountChangedCoalesced.Broadcast(Pair.Key, Pair.Value.NewCount, Pair.Value.OldCount);
+		}
+	}
+}
+
+FDelegateHandle FTagStackContainer::AddThresholdWatcher(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, FTagStackThresholdReached&& Callback)
+{
+	if (!Tag.IsValid())
+	{
+		return FDelegateHandle();
+	}
+
+	const int32 Count = GetStackCount(Tag);
+	if (CompareStackCount(Count, Comparison, Threshold))
+	{
+		Callback.ExecuteIfBound(Tag, Count);
+		return FDelegateHandle();
+	}
+
+	const FDelegateHandle Handle(FDelegateHandle::GenerateNewHandle);
+	WatchersByTag.FindOrAdd(Tag).Add({ Handle, Comparison, Threshold, MoveTemp(Callback) });
+	return Handle;
+}
+
+void FTagStackContainer::RemoveThresholdWatcher(FGameplayTag Tag, FDelegateHandle Handle)
+{
+	if (TArray<FThresholdWatcher>* Watchers = WatchersByTag.Find(Tag))
+	{
+		Watchers->RemoveAllSwap([Handle](const FThresholdWatcher& Watcher) { return Watcher.Handle == Handle; });
+		if (Watchers->Num() == 0)
+		{
+			WatchersByTag.Remove(Tag);
+		}
+	}
+}
+
+bool FTagStackContainer::CompareStackCount(int32 Count, ETagStackComparison Comparison, int32 Threshold)
+{
+	switch (Comparison)
+	{
+	case ETagStackComparison::GreaterOrEqual:	return Count >= Threshold;
+	case ETagStackComparison::Greater:			return Count > Threshold;
+	case ETagStackComparison::LessOrEqual:		return Count <= Threshold;
+	case ETagStackComparison::Less:				return Count < Threshold;
+	case ETagStackComparison::Equal:			return Count == Threshold;
+	case ETagStackComparison::NotEqual:			return Count != Threshold;
+	default:									return false;
+	}
+}
+
+void FTagStackContainer::EvaluateThresholdWatchers(FGameplayTag Tag, int32 NewCount)
+{
+	TArray<FThresholdWatcher>* Watchers = WatchersByTag.Find(Tag);
+	if (!Watchers)
+	{
+		return;
+	}
+
+	// Take the reached watchers out before calling them, since callbacks may add or remove watchers
+	TArray<FTagStackThresholdReached, TInlineAllocator<4>> Reached;
+	for (int32 Index = Watchers->Num() - 1; Index >= 0; --Index)
+	{
+		FThresholdWatcher& Watcher = (*Watchers)[Index];
+		if (CompareStackCount(NewCount, Watcher.Comparison, Watcher.Threshold))
+		{
+			Reached.Add(MoveTemp(Watcher.Callback));
+			Watchers->RemoveAtSwap(Index);
+		}
+	}
+
+	if (Watchers->Num() == 0)
+	{
+		WatchersByTag.Remove(Tag);
+	}
+
+	for (const FTagStackThresholdReached& Callback : Reached)
+	{
+		Callback.ExecuteIfBound(Tag, NewCount);
+	}
+}
+
+void FTagStackContainer::UpdateAggregateCounts(FGameplayTag Tag, int32 Delta)
+{
+	if (Delta == 0)
+	{
+		return;
+	}
+
+	// Tag depth is small, so walking the parents keeps the aggregate query itself a single lookup
+	for (FGameplayTag Current = Tag; Current.IsValid(); Current = Current.RequestDirectParent())
+	{
+		int32& AggregateCount = TagToAggregateCountMap.FindOrAdd(Current);
+		AggregateCount += Delta;
+		if (AggregateCount == 0)
+		{
+			TagToAggregateCountMap.Remove(Current);
+		}
+	}
+}
+
+SIZE_T FTagStackContainer::GetAllocatedSize() const
+{
+	SIZE_T Size = Stacks.GetAllocatedSize() + TagToSlotMap.GetAllocatedSize() + TagToAggregateCountMap.GetAllocatedSize();
+	Size += PendingReplicatedRemovals.GetAllocatedSize() + PendingNotifications.Changes.GetAllocatedSize() + WatchersByTag.GetAllocatedSize();
+	for (const TPair<FGameplayTag, TArray<FThresholdWatcher>>& Watchers : WatchersByTag)
+	{
+		Size += Watchers.Value.GetAllocatedSize();
+	}
+	return Size;
+}
+
+FTagStackBatch::FTagStackBatch(FTagStackContainer& InContainer)
+	: Container(InContainer)
+{
+}
+
+FTagStackBatch::~FTagStackBatch()
+{
+	Commit();
+}
+
+void FTagStackBatch::AddStack(FGameplayTag Tag, int32 StackCount)
+{
+	if (Tag.IsValid() && StackCount > 0)
+	{
+		FindOrAddPending(Tag) += StackCount;
+	}
+}
+
+void FTagStackBatch::RemoveStack(FGameplayTag Tag, int32 StackCount)
+{
+	if (Tag.IsValid() && StackCount > 0)
+	{
+		int32& PendingCount = FindOrAddPending(Tag);
+		PendingCount = FMath::Max(PendingCount - StackCount, 0);
+	}
+}
+
+void FTagStackBatch::SetStack(FGameplayTag Tag, int32 StackCount)
+{
+	if (Tag.IsValid() && StackCount > 0)
+	{
+		FindOrAddPending(Tag) = StackCount;
+	}
+}
+
+void FTagStackBatch::ClearStack(FGameplayTag Tag)
+{
+	if (Tag.IsValid())
+	{
+		FindOrAddPending(Tag) = 0;
+	}
+}
+
+int32 FTagStackBatch::GetStackCount(FGameplayTag Tag) const
+{
+	if (const int32* PendingCount = PendingCounts.Find(Tag))
+	{
+		return *PendingCount;
+	}
+	return Container.GetStackCount(Tag);
+}
+
+void FTagStackBatch::Commit()
+{
+	if (PendingCounts.Num() > 0)
+	{
+		Container.ApplyBatch(PendingCounts);
+		PendingCounts.Reset();
+	}
 }
 
-void FTagStackContainer::RebuildTagToCountMap()
+int32& FTagStackBatch::FindOrAddPending(FGameplayTag Tag)
 {
-	TagToCountMap.Empty(Stacks.Num());
-	for (const FTagStack& Stack : Stacks)
+	if (int32* PendingCount = PendingCounts.Find(Tag))
 	{
-		TagToCountMap.Add(Stack.Tag, Stack.StackCount);
+		return *PendingCount;
 	}
+	return PendingCounts.Add(Tag, Container.GetStackCount(Tag));
 }
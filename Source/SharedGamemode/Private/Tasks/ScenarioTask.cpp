@@ -31,11 +31,12 @@ void UScenarioTask::SetTaskResult(EScenarioResult NewResult)
 {
 	if (CurrentResult != NewResult)
 	{
+		const EScenarioResult OldResult = CurrentResult;
 		CurrentResult = NewResult;
         
 		if (UScenarioInstance* Instance = GetScenarioInstance())
 		{
-			Instance->NotifyTaskUpdate(Cast<UScenarioTask_ObjectiveTracker>(this));
+			Instance->NotifyTaskUpdate(Cast<UScenarioTask_ObjectiveTracker>(this), OldResult);
 		}
 	}
 }
\ No newline at end of file
@@ -7,3 +7,40 @@ UScenarioTask_ObjectiveTracker::UScenarioTask_ObjectiveTracker(const FObjectInit
 	: Super(ObjectInitializer)
 {
 }
+
+void UScenarioTask_ObjectiveTracker::CompleteWhenTagStack(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, bool bSuccess)
+{
+	UScenarioInstance* Instance = GetScenarioInstance();
+	if (!Instance)
+	{
+		return;
+	}
+
+	const FDelegateHandle Handle = Instance->AddTagStackWatcher(Tag, Comparison, Threshold, FTagStackThresholdReached::CreateWeakLambda(this, [this, bSuccess](FGameplayTag, int32)
+	{
+		// The tracker may have been resolved some other way in the meantime
+		if (CurrentResult == EScenarioResult::InProgress)
+		{
+			SetTaskResult(bSuccess ? EScenarioResult::Success : EScenarioResult::Failure);
+		}
+	}));
+
+	if (Handle.IsValid())
+	{
+		TagStackWatches.Emplace(Tag, Handle);
+	}
+}
+
+void UScenarioTask_ObjectiveTracker::EndPlay_Implementation(bool bCancelled)
+{
+	if (UScenarioInstance* Instance = GetScenarioInstance())
+	{
+		for (const TPair<FGameplayTag, FDelegateHandle>& Watch : TagStackWatches)
+		{
+			Instance->RemoveTagStackWatcher(Watch.Key, Watch.Value);
+		}
+	}
+	TagStackWatches.Reset();
+
+	Super::EndPlay_Implementation(bCancelled);
+}
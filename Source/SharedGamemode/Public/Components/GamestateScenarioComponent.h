@@ -25,7 +25,7 @@ Copyright 2021 Empires Team
 class UGameplayScenario;
 
 USTRUCT()
-struct FGameplayScenarioNetworkArrayItem : public FFastArraySerializerItem
+struct SHAREDGAMEMODE_API FGameplayScenarioNetworkArrayItem : public FFastArraySerializerItem
 {
 	GENERATED_BODY()
 public:
@@ -50,7 +50,7 @@ public:
 
 
 USTRUCT()
-struct FGameplayScenarioNetworkArray : public FFastArraySerializer 
+struct SHAREDGAMEMODE_API FGameplayScenarioNetworkArray : public FFastArraySerializer 
 {
 	GENERATED_BODY()
 public:
@@ -58,13 +58,42 @@ public:
 	TArray<FGameplayScenarioNetworkArrayItem> Items;
 
 	UPROPERTY()
-	UGamestateScenarioComponent* ScenarioComp;
-	
+	UGamestateScenarioComponent* ScenarioComp = nullptr;
+
+	// Item of an active scenario, INDEX_NONE if it has none or its item is waiting to be removed
+	int32 FindScenarioIndex(const UGameplayScenario* Scenario) const;
+
+	// Server: appends an item for Scenario and marks only that item dirty
+	void AddScenario(UGameplayScenario* Scenario);
+
+	// Server: hides the item from lookups right away, RemovePendingScenarios removes it
+	void MarkPendingRemoval(int32 Index);
+
+	// Server: swap-removes the marked items and marks the array dirty once. Returns false if none were marked.
+	bool RemovePendingScenarios();
 
 	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
 	{
 		return FFastArraySerializer::FastArrayDeltaSerialize<FGameplayScenarioNetworkArrayItem, FGameplayScenarioNetworkArray>(Items, DeltaParms, *this);
 	}
+
+	// Replication callbacks, keeping the scenario index in sync on clients
+	void PreReplicatedRemove(const TArrayView<int32> RemovedIndices, int32 FinalSize);
+	void PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize);
+	void PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize);
+	void PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters);
+
+private:
+	// Where each active scenario's item lives in Items, kept in sync across swap-removals
+	TMap<const UGameplayScenario*, int32> ScenarioToIndex;
+
+	// Server: indices of items marked for removal. Items are only appended until they are removed,
+	// so the indices stay valid until then.
+	TArray<int32> PendingRemovals;
+
+	// Client: indices removed by the last replication update. The fast array swap-removes them only
+	// after all callbacks have run, so moved items are re-indexed in PostReplicatedReceive.
+	TArray<int32> PendingReplicatedRemovals;
 };
 
 template<>
@@ -88,7 +117,7 @@ public:
 	virtual void GetLifetimeReplicatedProps(TArray<class FLifetimeProperty>& OutLifetimeProps) const override;
 
 	virtual void OnRegister() override;
-	virtual void BeginPlay() override;
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
 	
 	// Server-side functions
 	UFUNCTION(Server, Reliable)
@@ -114,9 +143,6 @@ protected:
 	void ActivateScenarioLocally(UGameplayScenario* Scenario);
 	void DeactivateScenarioLocally(UGameplayScenario* Scenario);
 
-	// Cleanup pending scenarios
-	void CleanupPendingScenarios();
-
 	// Track authority
 	bool bHasAuthority;
 
@@ -124,6 +150,7 @@ private:
 	// Helper to find scenario in network array
 	int32 FindScenarioIndex(UGameplayScenario* Scenario) const;
 
-	// Timer handle for cleanup
-	FTimerHandle CleanupTimerHandle;
+	// Whether PreReplication will run, which needs a net driver with at least one client connection
+	bool HasReplicationTarget() const;
+
 };
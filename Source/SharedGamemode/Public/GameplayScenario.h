@@ -58,7 +58,8 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "UI", AssetRegistrySearchable)
 	FText Description;
 		
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "UI")
+	// Also in the asset registry, so the rotation planner can read them without loading the scenario
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "UI", AssetRegistrySearchable)
 	FGameplayTagContainer ScenarioTags;
 
 	virtual void GetOwnedGameplayTags(FGameplayTagContainer& TagContainer) const { TagContainer.AppendTags(ScenarioTags); }
@@ -0,0 +1,131 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+
+// Tag keyed map that keeps up to InlineCapacity entries inline and scans them linearly, switching to
+// a hashed TMap once it grows past that. Most tag keyed containers only ever hold a handful of tags, so
+// their lookups never touch the heap. The TMap is only allocated once needed, so an inline map costs just
+// its inline entries.
+template<typename ValueType, int32 InlineCapacity = 4>
+struct TGameplayTagSmallMap
+{
+    TGameplayTagSmallMap() = default;
+    TGameplayTagSmallMap(TGameplayTagSmallMap&&) = default;
+    TGameplayTagSmallMap& operator=(TGameplayTagSmallMap&&) = default;
+
+    TGameplayTagSmallMap(const TGameplayTagSmallMap& Other)
+        : Inline(Other.Inline)
+        , Hashed(Other.Hashed.IsValid() ? MakeUnique<TMap<FGameplayTag, ValueType>>(*Other.Hashed) : nullptr)
+    {
+    }
+
+    TGameplayTagSmallMap& operator=(const TGameplayTagSmallMap& Other)
+    {
+        if (this != &Other)
+        {
+            Inline = Other.Inline;
+            Hashed = Other.Hashed.IsValid() ? MakeUnique<TMap<FGameplayTag, ValueType>>(*Other.Hashed) : nullptr;
+        }
+        return *this;
+    }
+
+    ValueType* Find(FGameplayTag Tag)
+    {
+        if (Hashed.IsValid())
+        {
+            return Hashed->Find(Tag);
+        }
+        for (TPair<FGameplayTag, ValueType>& Entry : Inline)
+        {
+            if (Entry.Key == Tag)
+            {
+                return &Entry.Value;
+            }
+        }
+        return nullptr;
+    }
+
+    const ValueType* Find(FGameplayTag Tag) const
+    {
+        return const_cast<TGameplayTagSmallMap*>(this)->Find(Tag);
+    }
+
+    bool Contains(FGameplayTag Tag) const { return Find(Tag) != nullptr; }
+    int32 Num() const { return Hashed.IsValid() ? Hashed->Num() : Inline.Num(); }
+
+    // Heap memory only, the inline entries are part of the owner
+    SIZE_T GetAllocatedSize() const
+    {
+        return Inline.GetAllocatedSize() + (Hashed.IsValid() ? sizeof(TMap<FGameplayTag, ValueType>) + Hashed->GetAllocatedSize() : 0);
+    }
+
+    // Tag must not be in the map yet
+    ValueType& Add(FGameplayTag Tag, const ValueType& Value)
+    {
+        if (!Hashed.IsValid() && Inline.Num() == InlineCapacity)
+        {
+            Hashed = MakeUnique<TMap<FGameplayTag, ValueType>>();
+            Hashed->Reserve(InlineCapacity * 2);
+            for (const TPair<FGameplayTag, ValueType>& Entry : Inline)
+            {
+                Hashed->Add(Entry.Key, Entry.Value);
+            }
+            Inline.Empty();
+        }
+
+        if (Hashed.IsValid())
+        {
+            return Hashed->Add(Tag, Value);
+        }
+        return Inline.Emplace_GetRef(Tag, Value).Value;
+    }
+
+    ValueType& FindOrAdd(FGameplayTag Tag)
+    {
+        if (ValueType* Value = Find(Tag))
+        {
+            return *Value;
+        }
+        return Add(Tag, ValueType());
+    }
+
+    void Remove(FGameplayTag Tag)
+    {
+        if (!Hashed.IsValid())
+        {
+            const int32 Index = Inline.IndexOfByPredicate([Tag](const TPair<FGameplayTag, ValueType>& Entry) { return Entry.Key == Tag; });
+            if (Index != INDEX_NONE)
+            {
+                Inline.RemoveAtSwap(Index);
+            }
+            return;
+        }
+
+        Hashed->Remove(Tag);
+
+        // Only go back inline well below the threshold, so a map hovering around it does not flip every change
+        if (Hashed->Num() <= InlineCapacity / 2)
+        {
+            for (const TPair<FGameplayTag, ValueType>& Entry : *Hashed)
+            {
+                Inline.Emplace(Entry.Key, Entry.Value);
+            }
+            Hashed.Reset();
+        }
+    }
+
+    void Reset()
+    {
+        Inline.Reset();
+        Hashed.Reset();
+    }
+
+private:
+    TArray<TPair<FGameplayTag, ValueType>, TInlineAllocator<InlineCapacity>> Inline;
+
+    // Set while the map is past InlineCapacity, Inline is empty then
+    TUniquePtr<TMap<FGameplayTag, ValueType>> Hashed;
+};
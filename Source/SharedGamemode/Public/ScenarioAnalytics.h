@@ -0,0 +1,93 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** How a scenario or one of its stages ended */
+enum class EScenarioOutcome : uint8
+{
+	Success,
+	Failure,
+	// Ended without a result: cancelled, or a fork branch still running when the join moved on
+	Cancelled,
+};
+
+/**
+ * Log-linear duration histogram in the style of HdrHistogram. Durations are kept in milliseconds:
+ * exact below 16ms, then 16 linear buckets per power of two, so a recorded value is off by at most
+ * 1/16. Covers up to 2^32ms in a fixed array of counters, and recording never allocates.
+ */
+struct SHAREDGAMEMODE_API FScenarioDurationHistogram
+{
+	static constexpr int32 SubBucketBits = 4;
+	static constexpr int32 NumSubBuckets = 1 << SubBucketBits;
+	static constexpr int32 NumBuckets = (32 - SubBucketBits + 1) * NumSubBuckets;
+
+	uint32 Counts[NumBuckets] = {};
+	uint64 TotalCount = 0;
+	uint64 TotalMilliseconds = 0;
+	uint32 MaxMilliseconds = 0;
+
+	static int32 GetBucketIndex(uint32 Milliseconds);
+
+	// Smallest value that lands in the bucket
+	static uint32 GetBucketLowerBound(int32 BucketIndex);
+
+	void Add(float Seconds);
+	void Merge(const FScenarioDurationHistogram& Other);
+
+	// Seconds at or below which Percentile (0-100) of the durations fall, to the middle of a bucket
+	float GetPercentile(float Percentile) const;
+	float GetMeanSeconds() const;
+};
+
+/** Outcome counts and durations of one scenario or stage */
+struct SHAREDGAMEMODE_API FScenarioOutcomeStats
+{
+	uint32 Successes = 0;
+	uint32 Failures = 0;
+	uint32 Cancellations = 0;
+	FScenarioDurationHistogram Durations;
+
+	void Record(EScenarioOutcome Outcome, float Seconds);
+	void Merge(const FScenarioOutcomeStats& Other);
+
+	uint32 GetTotal() const { return Successes + Failures + Cancellations; }
+};
+
+struct SHAREDGAMEMODE_API FScenarioAnalyticsEntry
+{
+	// Whole runs of the scenario, from start to end
+	FScenarioOutcomeStats Runs;
+
+	// Keyed by the stage's object name inside the scenario asset
+	TMap<FName, FScenarioOutcomeStats> Stages;
+};
+
+/**
+ * Outcome rates and duration histograms per scenario and per stage, fed by UScenarioInstance as
+ * stages exit and scenarios end. Recording only allocates the first time a scenario or stage is seen.
+ *
+ * File layout: magic, version, scenario count, payload size and payload CRC, then per scenario its
+ * asset id, run stats and stage count, and per stage its name and stats. Histograms only store the
+ * buckets in use.
+ */
+struct SHAREDGAMEMODE_API FScenarioAnalytics
+{
+	static constexpr uint32 Magic = 0x41534753; // "SGSA"
+	static constexpr uint16 CurrentVersion = 1;
+
+	TMap<FPrimaryAssetId, FScenarioAnalyticsEntry> Scenarios;
+
+	void RecordRun(const FPrimaryAssetId& ScenarioId, EScenarioOutcome Outcome, float Seconds);
+	void RecordStage(const FPrimaryAssetId& ScenarioId, FName StageName, EScenarioOutcome Outcome, float Seconds);
+
+	// Adds Other's counts to this one
+	void Merge(const FScenarioAnalytics& Other);
+
+	void Write(TArray<uint8>& OutBytes) const;
+
+	// Validates and parses a file written by Write, leaving this untouched on failure
+	bool Read(const TArray<uint8>& Bytes, FString& OutError);
+};
@@ -0,0 +1,186 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+#include "GameplayTagSmallMap.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "StructUtils/InstancedStruct.h"
+#include "ScenarioBlackboard.generated.h"
+
+UENUM(BlueprintType)
+enum class EScenarioBlackboardValueType : uint8
+{
+	None,
+	Int,
+	Float,
+	Vector,
+	Object,
+	Struct
+};
+
+// Payloads of the built-in value types, so every entry holds its value in one FInstancedStruct
+USTRUCT()
+struct SHAREDGAMEMODE_API FScenarioBlackboardInt
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Value = 0;
+};
+
+USTRUCT()
+struct SHAREDGAMEMODE_API FScenarioBlackboardFloat
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	float Value = 0.f;
+};
+
+USTRUCT()
+struct SHAREDGAMEMODE_API FScenarioBlackboardVector
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector Value = FVector::ZeroVector;
+};
+
+USTRUCT()
+struct SHAREDGAMEMODE_API FScenarioBlackboardObject
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<UObject> Value;
+};
+
+// A single typed value on the blackboard. Value holds the payload struct of Type, or for Struct
+// entries the shared struct itself, so an entry only pays for the type it holds.
+USTRUCT()
+struct SHAREDGAMEMODE_API FScenarioBlackboardEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FGameplayTag Key;
+
+	UPROPERTY()
+	EScenarioBlackboardValueType Type = EScenarioBlackboardValueType::None;
+
+	UPROPERTY()
+	FInstancedStruct Value;
+
+	// Payload of the given built-in type, nullptr if the entry holds another type
+	template<typename PayloadType>
+	const PayloadType* GetPayload(EScenarioBlackboardValueType PayloadValueType) const
+	{
+		return Type == PayloadValueType ? Value.GetPtr<PayloadType>() : nullptr;
+	}
+
+	// Sends the key, the type and the value. Vectors are quantized to 0.1 units like FVector_NetQuantize10.
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	FString GetDebugString() const;
+};
+
+template<>
+struct TStructOpsTypeTraits<FScenarioBlackboardEntry> : public TStructOpsTypeTraitsBase2<FScenarioBlackboardEntry>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+// Fired when a key's value changes. On removal the entry has type None.
+DECLARE_MULTICAST_DELEGATE_TwoParams(FScenarioBlackboardChanged, FGameplayTag /*Key*/, const FScenarioBlackboardEntry& /*Entry*/);
+
+/**
+ * Tag keyed, typed values shared between the tasks of a scenario instance. Entries live in one
+ * array and replicate per key, so changing a value only sends that entry.
+ */
+USTRUCT()
+struct SHAREDGAMEMODE_API FScenarioBlackboard : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	// Setters, authority only. Setting a key to a value of another type replaces it.
+	void SetInt(FGameplayTag Key, int32 Value);
+	void SetFloat(FGameplayTag Key, float Value);
+	void SetVector(FGameplayTag Key, const FVector& Value);
+	void SetObject(FGameplayTag Key, UObject* Value);
+	void SetStruct(FGameplayTag Key, const FInstancedStruct& Value);
+	void ClearValue(FGameplayTag Key);
+
+	// Getters return false if the key is missing or holds another type
+	bool GetInt(FGameplayTag Key, int32& OutValue) const;
+	bool GetFloat(FGameplayTag Key, float& OutValue) const;
+	bool GetVector(FGameplayTag Key, FVector& OutValue) const;
+	bool GetObject(FGameplayTag Key, UObject*& OutValue) const;
+
+	// Struct stored under Key if it is of type T, nullptr otherwise
+	template<typename T>
+	const T* GetStruct(FGameplayTag Key) const
+	{
+		const FScenarioBlackboardEntry* Entry = FindEntry(Key);
+		return Entry && Entry->Type == EScenarioBlackboardValueType::Struct ? Entry->Value.GetPtr<T>() : nullptr;
+	}
+
+	const FScenarioBlackboardEntry* FindEntry(FGameplayTag Key) const;
+	bool Contains(FGameplayTag Key) const { return KeyToIndexMap.Contains(Key); }
+	int32 Num() const { return Entries.Num(); }
+
+	// Listen to a single key. Fires on the server when the value is set and on clients when it replicates.
+	FDelegateHandle Subscribe(FGameplayTag Key, FScenarioBlackboardChanged::FDelegate&& Delegate);
+	void Unsubscribe(FGameplayTag Key, FDelegateHandle Handle);
+
+	// Fired for every key
+	FScenarioBlackboardChanged OnValueChanged;
+
+	// Network serialization support
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FScenarioBlackboardEntry, FScenarioBlackboard>(Entries, DeltaParms, *this);
+	}
+
+	// Replication callbacks
+	void PreReplicatedRemove(const TArrayView<int32> RemovedIndices, int32 FinalSize);
+	void PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize);
+	void PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize);
+	void PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters);
+
+private:
+	UPROPERTY()
+	TArray<FScenarioBlackboardEntry> Entries;
+
+	// Position of each key's entry in Entries, kept in sync across swap-removals
+	TGameplayTagSmallMap<int32> KeyToIndexMap;
+
+	// Per-key listeners
+	TMap<FGameplayTag, FScenarioBlackboardChanged> KeyListeners;
+
+	// Removed indices of the last replication update, re-indexed in PostReplicatedReceive
+	TArray<int32> PendingReplicatedRemovals;
+
+	// Entry of Key, added with type None if it has none yet. nullptr for an invalid key.
+	FScenarioBlackboardEntry* FindOrAddEntry(FGameplayTag Key);
+
+	// Stores NewValue as Key's PayloadType payload, replacing a value of another type. Only dirties
+	// the entry and notifies when something actually changed.
+	template<typename PayloadType, typename ValueType>
+	void SetValue(FGameplayTag Key, EScenarioBlackboardValueType Type, const ValueType& NewValue);
+
+	void NotifyValueChanged(const FScenarioBlackboardEntry& Entry);
+};
+
+template<>
+struct TStructOpsTypeTraits<FScenarioBlackboard> : public TStructOpsTypeTraitsBase2<FScenarioBlackboard>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
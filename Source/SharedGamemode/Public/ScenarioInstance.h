@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "GameplayScenario.h"
 #include "GameplayTagAssetInterface.h"
+#include "ScenarioBlackboard.h"
 #include "TagStackContainer.h"
 #include "Tasks/ScenarioStage.h"
 #include "UObject/Object.h"
@@ -19,6 +20,65 @@ class UScenarioTask_ObjectiveTracker;
 // Delegate for scenario completion notification
 DECLARE_MULTICAST_DELEGATE_TwoParams(FScenarioEndedDelegate, UScenarioInstance*, bool /*bWasCancelled*/);
 
+// Blueprint callback for tag stack threshold watchers
+DECLARE_DYNAMIC_DELEGATE_TwoParams(FScenarioTagStackThresholdReached, FGameplayTag, Tag, int32, Count);
+
+// Delegate for stage entry notification, BranchIndex is INDEX_NONE for the main stage
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FScenarioStageChangedDelegate, UScenarioInstance*, UScenarioStage* /*NewStage*/, int32 /*BranchIndex*/);
+
+// Delegate for stage exit notification, Result is InProgress when the stage was cut short
+DECLARE_MULTICAST_DELEGATE_FourParams(FScenarioStageExitedDelegate, UScenarioInstance*, UScenarioStage* /*Stage*/, EScenarioResult /*Result*/, float /*Seconds*/);
+
+/** Progress of a single objective inside an active stage */
+struct FScenarioObjectiveProgress
+{
+	// Completion rule copied from the objective asset
+	EScenarioCompletionMode CompletionMode = EScenarioCompletionMode::AnySuccess;
+
+	// Tally over this objective's trackers
+	FScenarioCompletionCounter Trackers;
+
+	// Last evaluated state, counted in the stage's objective tally
+	EScenarioResult State = EScenarioResult::InProgress;
+};
+
+/**
+ * Runtime state of a stage that is currently running, either as the instance's main stage
+ * or as one branch of a forking stage.
+ */
+USTRUCT()
+struct FScenarioStageRuntime
+{
+	GENERATED_BODY()
+
+	// The stage asset being run
+	UPROPERTY()
+	TObjectPtr<UScenarioStage> Stage;
+
+	// Services specific to this stage
+	UPROPERTY()
+	TArray<UScenarioTask_StageService*> StageServices;
+
+	// Active objective trackers
+	UPROPERTY()
+	TArray<UScenarioTask_ObjectiveTracker*> ObjectiveTrackers;
+
+	// Incremental progress per objective, indexed by the trackers' ObjectiveIndex
+	TArray<FScenarioObjectiveProgress> Objectives;
+
+	// Tally over Objectives
+	FScenarioCompletionCounter ObjectiveCounter;
+
+	// Result of the stage once it is left, and of a branch's chain once it has ended
+	EScenarioResult Result = EScenarioResult::InProgress;
+
+	// World time the stage was entered
+	double EnterTime = 0.0;
+
+	// Timer for delayed branch transitions
+	FTimerHandle ProgressionTimer;
+};
+
 /**
  * UScenarioInstance represents a running instance of a scenario.
  * It manages the active state, tasks, and progression through stages.
@@ -59,14 +119,28 @@ public:
     UFUNCTION(BlueprintPure, Category = "Scenario")
     UGameplayScenario* GetScenarioAsset() const { return ScenarioAsset; }
 
+    /** Seconds the scenario has been running, or ran for once it ended */
+    UFUNCTION(BlueprintPure, Category = "Scenario")
+    float GetRunningTime() const;
+
+    /** Get the main stage currently running */
+    UFUNCTION(BlueprintPure, Category = "Scenario")
+    UScenarioStage* GetCurrentStage() const { return CurrentStage; }
+
+    /** Get the stages running in parallel under a forking main stage */
+    UFUNCTION(BlueprintPure, Category = "Scenario")
+    TArray<UScenarioStage*> GetActiveBranchStages() const { return BranchStages; }
+
     /** Try to progress to the next stage if objectives are complete */
     bool TryProgressStage();
 
-    /** Get all active objective trackers */
+    /** Get all active objective trackers, including those of fork branches */
     TArray<UScenarioTask_ObjectiveTracker*> GetCurrentObjectiveTrackers();
 
     /** Execute function on all stage services */
     void ForEachStageService(TFunctionRef<void(UScenarioTask_StageService*)> Func);
+
+    /** Result of the main stage: its objectives, or the join of its branches when it forks */
     EScenarioResult EvaluateObjectives();
 
     //~ Begin Tag Stack System
@@ -81,8 +155,24 @@ public:
     /** Get current stack count for a tag */
     UFUNCTION(BlueprintCallable, Category = "Scenario")
     int32 GetTagStackCount(FGameplayTag Tag) const;
+
+    /** Get the total stack count of a tag and all of its child tags */
+    UFUNCTION(BlueprintCallable, Category = "Scenario")
+    int32 GetTagStackCountIncludingChildren(FGameplayTag Tag) const;
+
+    /** Call OnReached once when the tag's stack count meets the condition, right away if it already does */
+    UFUNCTION(BlueprintCallable, Category = "Scenario")
+    void WatchTagStackThreshold(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, FScenarioTagStackThresholdReached OnReached);
+
+    /** Native threshold watcher, returns an invalid handle if it fired right away */
+    FDelegateHandle AddTagStackWatcher(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, FTagStackThresholdReached&& OnReached);
+    void RemoveTagStackWatcher(FGameplayTag Tag, FDelegateHandle Handle);
     //~ End Tag Stack System
 
+    /** Typed values shared between this instance's tasks, written on the server */
+    FScenarioBlackboard& GetBlackboard() { return Blackboard; }
+    const FScenarioBlackboard& GetBlackboard() const { return Blackboard; }
+
     /** 
      * Checks if this instance has authority to make gameplay decisions.
      * Only the server has authority in networked games.
@@ -91,6 +181,12 @@ public:
     
     void OnRep_CurrentStage();
 
+    /** Fired on the server whenever the main stage or a fork branch enters a stage */
+    FScenarioStageChangedDelegate OnStageChanged;
+
+    /** Fired on the server whenever the main stage or a fork branch leaves a stage */
+    FScenarioStageExitedDelegate OnStageExited;
+
 protected:
     /** The scenario template this instance was created from */
     UPROPERTY(Replicated)
@@ -103,6 +199,10 @@ protected:
     /** Currently active stage */
     UPROPERTY(Replicated=OnRep_CurrentStage)
     TObjectPtr<UScenarioStage> CurrentStage;
+
+    /** Stages of the active fork branches, parallel to Branches */
+    UPROPERTY(Replicated)
+    TArray<UScenarioStage*> BranchStages;
     
     /** Result of the previous stage */
     UPROPERTY(Replicated)
@@ -112,6 +212,10 @@ protected:
     UPROPERTY(Replicated)
     FTagStackContainer TagStacks;
 
+    /** Typed tag-keyed data shared between tasks */
+    UPROPERTY(Replicated)
+    FScenarioBlackboard Blackboard;
+
     /** Runtime tags for this instance */
     UPROPERTY(Replicated)
     FGameplayTagContainer RuntimeTags;
@@ -120,13 +224,16 @@ protected:
     UPROPERTY()
     TArray<UScenarioTask_StageService*> GlobalServices;
 
-    /** Services specific to current stage */
+    /** Services and trackers of the main stage */
     UPROPERTY()
-    TArray<UScenarioTask_StageService*> StageServices;
+    FScenarioStageRuntime MainStage;
 
-    /** Active objective trackers */
+    /** Parallel branches of a forking main stage */
     UPROPERTY()
-    TArray<UScenarioTask_ObjectiveTracker*> ObjectiveTrackers;
+    TArray<FScenarioStageRuntime> Branches;
+
+    /** Tally over finished branches, evaluated with the fork stage's JoinMode */
+    FScenarioCompletionCounter BranchCounter;
 
     /** Called when a tag stack count changes */
     void OnTagStackChanged(FGameplayTag Tag, int32 NewCount, int32 OldCount);
@@ -134,16 +241,44 @@ protected:
 private:
     /** Handle stage transitions */
     void EnterStage(UScenarioStage* Stage);
-    void ExitStage(UScenarioStage* Stage);
+    void ExitStage(UScenarioStage* Stage, bool bCancelled = false);
     void ProgressStage_Internal(EScenarioResult Transition);
     float GetStageTransitionDelay() const;
+    float GetStageTransitionDelay(const UScenarioStage* Stage) const;
+
+    /** Spin up the runtime state (services, trackers, counters) for a stage */
+    void EnterStageRuntime(FScenarioStageRuntime& Runtime, UScenarioStage* Stage, int32 BranchIndex);
+    void ExitStageRuntime(FScenarioStageRuntime& Runtime, bool bCancelled);
+
+    /** Fork branch handling */
+    void ForkBranches(UScenarioStage* Stage);
+    void TryProgressBranch(int32 BranchIndex);
+    void ProgressBranch_Internal(int32 BranchIndex, EScenarioResult Transition);
+
+    /** Main stage for INDEX_NONE, otherwise the branch at that index */
+    FScenarioStageRuntime* GetStageRuntime(int32 BranchIndex);
 
     /** Handle task updates */
-    void NotifyTaskUpdate(UScenarioTask_ObjectiveTracker* Task);
+    void NotifyTaskUpdate(UScenarioTask_ObjectiveTracker* Task, EScenarioResult OldResult);
 
     /** Timer for delayed stage transitions */
     FTimerHandle StageProgressionTimer;
 
+    /** Set while a stage is being entered; tracker results are counted but progression waits until setup is done */
+    bool bEnteringStage = false;
+
+    /** Bumped on every main stage entry so callers can detect that the stage moved on underneath them */
+    int32 StageEntrySerial = 0;
+
+    /** World time of InitScenario and EndScenario */
+    double StartTime = 0.0;
+    double EndTime = 0.0;
+
+    /** Set by the first EndScenario, so a finished scenario is not ended (and reported) again */
+    bool bEnded = false;
+
+    double GetWorldTime() const;
+
     /** Delegate fired when scenario ends */
     FScenarioEndedDelegate OnScenarioEnded;
 
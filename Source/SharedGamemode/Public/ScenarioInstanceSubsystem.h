@@ -146,6 +146,10 @@ protected:
 
 private:
 	void OnScenarioEnded(UScenarioInstance* Instance, bool bWasCancelled);
+
+	// Feed outcomes and stage durations to the analytics kept by UScenarioPersistenceManager
+	void RecordScenarioOutcome(UScenarioInstance* Instance, bool bWasCancelled);
+	void RecordStageOutcome(UScenarioInstance* Instance, UScenarioStage* Stage, EScenarioResult Result, float Seconds);
 	void NotifyAddedScenarioFromReplication(UScenarioInstance* Instance);
 	void NotifyRemovedScenarioFromReplication(UScenarioInstance* Instance);
 };
@@ -3,9 +3,21 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/IConsoleManager.h"
+#include "ScenarioAnalytics.h"
+#include "ScenarioPopularityIndex.h"
+#include "ScenarioRecentPlays.h"
+#include "ScenarioRotationPlanner.h"
+#include "ScenarioRotationSampler.h"
+#include "ScenarioStatsHistory.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "ScenarioPersistenceManager.generated.h"
 
+class IScenarioStatsBackend;
+struct FScenarioStatsDelta;
+struct FScenarioStatsPendingLoad;
+
 USTRUCT()
 struct FScenarioStats
 {
@@ -44,15 +56,39 @@ struct FScenarioRotationEntry
 	UPROPERTY()
 	float Weight;
 
+	// Wall-time cooldown in days
 	UPROPERTY()
 	int32 MinimumGapBetweenPlays;
 
+	// Match-count cooldown: the scenario sits out this many matches after it is played (up to
+	// FScenarioRecentPlays::Capacity), 0 for none. Applies on top of the wall-time cooldown.
+	UPROPERTY()
+	int32 MinimumMatchesBetweenPlays;
+
 	FScenarioRotationEntry()
 		: Weight(1.0f)
 		, MinimumGapBetweenPlays(1)
+		, MinimumMatchesBetweenPlays(0)
 	{}
 };
 
+/** Everything the persistence layer keeps, passed between the manager, its backends and the file format */
+struct FScenarioStatsStore
+{
+	TMap<FPrimaryAssetId, FScenarioStats> Stats;
+	TArray<FScenarioRotationEntry> RotationEntries;
+
+	// Hourly and daily activity, only for scenarios that have any
+	TMap<FPrimaryAssetId, FScenarioStatsHistory> History;
+
+	void Reset()
+	{
+		Stats.Reset();
+		RotationEntries.Reset();
+		History.Reset();
+	}
+};
+
 /**
  * 
  */
@@ -67,27 +103,123 @@ public:
 	// Persistence functions
 	void SaveScenarioStats(const FScenarioStats& Stats);
 	FScenarioStats GetScenarioStats(const FPrimaryAssetId& ScenarioId) const;
+	// Also records how long the previous scenario ran, measured from its own UpdatePlayCount
 	void UpdatePlayCount(const FPrimaryAssetId& ScenarioId);
+	void RecordVotes(const FPrimaryAssetId& ScenarioId, int32 Votes);
+	void RecordMatchDuration(const FPrimaryAssetId& ScenarioId, float Seconds);
+
+	// Plays, votes, player counts and match lengths over the last Hours hours (up to 30 days)
+	FScenarioPopularity GetScenarioPopularity(const FPrimaryAssetId& ScenarioId, int32 Hours) const;
 
 	// Rotation management
 	void SetRotationEntry(const FScenarioRotationEntry& Entry);
-	TArray<FPrimaryAssetId> GetNextRotationOptions() const;
+	// Up to Count distinct scenarios eligible for rotation, drawn at random by rotation weight
+	TArray<FPrimaryAssetId> GetNextRotationOptions(int32 Count, const TArray<FPrimaryAssetId>& Exclude = TArray<FPrimaryAssetId>()) const;
 	bool IsScenarioAllowedInRotation(const FPrimaryAssetId& ScenarioId) const;
 
 	// Get weighted scenarios based on popularity
 	TArray<FPrimaryAssetId> GetWeightedScenarioOptions(int32 Count) const;
 
-private:
-	// Persistent data
-	UPROPERTY()
-	TMap<FPrimaryAssetId, FScenarioStats> ScenarioStatistics;
-
-	UPROPERTY()
-	TArray<FScenarioRotationEntry> RotationEntries;
+	// Outcome and length of a finished scenario run or stage, see FScenarioAnalytics
+	void RecordScenarioOutcome(const FPrimaryAssetId& ScenarioId, EScenarioOutcome Outcome, float Seconds);
+	void RecordStageOutcome(const FPrimaryAssetId& ScenarioId, FName StageName, EScenarioOutcome Outcome, float Seconds);
+	const FScenarioAnalytics& GetAnalytics() const;
 
-	// File operations
-	void LoadPersistedData();
-	void SavePersistedData();
+	// Options for the next vote from the precomputed rotation plan, see Scenario.Rotation.Plan.Slots.
+	// Returns false while planning is off or no plan is ready.
+	bool GetPlannedRotationOptions(int32 Count, TArray<FPrimaryAssetId>& OutOptions) const;
 
-	FString GetSaveFilePath() const;
+private:
+	// Persistent data, refreshed by queries when the backend has a newer view from elsewhere
+	mutable FScenarioStatsStore Store;
+
+	// Scenarios played on this server, newest last, for match-count cooldowns
+	mutable FScenarioRecentPlays RecentPlays;
+
+	// Position of each scenario in Store.RotationEntries, rebuilt when the entries change
+	mutable TMap<FPrimaryAssetId, int32> RotationEntryIndices;
+	mutable bool bRotationEntryIndicesDirty = true;
+
+	const FScenarioRotationEntry* FindRotationEntry(const FPrimaryAssetId& ScenarioId) const;
+
+	// Upcoming rotation slots, planned on a worker thread. A play of the first slot's first option only
+	// drops that slot and plans one more; any other play or rotation change plans from scratch.
+	mutable FScenarioRotationPlan RotationPlan;
+	mutable TFuture<FScenarioRotationPlan> PendingRotationPlan;
+	mutable uint32 RotationPlanGeneration = 0;
+
+	// Planner candidates for the rotation entries, without the parts that change from match to match.
+	// Rebuilt when the entries or the diversity roots change.
+	mutable TArray<FScenarioRotationPlanCandidate> RotationPlanCandidates;
+	mutable bool bRotationPlanCandidatesDirty = true;
+
+	// Parent tags from Scenario.Rotation.Plan.DiversityTags, parsed again only when that variable changes
+	FString RotationDiversityRootNames;
+	FGameplayTagContainer RotationDiversityRoots;
+	FConsoleVariableSinkHandle ConsoleVariableSink;
+
+	// Scenario tags read from the loaded asset or the asset registry. Filled when the stats load, when a rotation
+	// entry is set and when a scenario is played, so planning never goes to the asset registry.
+	mutable TMap<FPrimaryAssetId, FGameplayTagContainer> ScenarioTagCache;
+
+	IConsoleObject* ShowPlanCommand = nullptr;
+
+	// Picks up a finished plan, and starts planning on a worker if the plan is short of slots
+	void UpdateRotationPlan() const;
+	void InvalidateRotationPlan(const FPrimaryAssetId& PlayedScenarioId = FPrimaryAssetId()) const;
+	void OnConsoleVariablesChanged();
+	void CacheScenarioTags(const FPrimaryAssetId& ScenarioId) const;
+	void CacheRotationScenarioTags() const;
+	void DumpRotationPlan(FOutputDevice& Ar) const;
+
+	// Recorded on the game thread; a worker writes a copy to ScenarioAnalytics.bin after each scenario run
+	mutable FScenarioAnalytics Analytics;
+	bool bAnalyticsDirty = false;
+	TFuture<void> PendingAnalyticsWrite;
+	FString AnalyticsPath;
+
+	IConsoleObject* DumpAnalyticsCommand = nullptr;
+
+	// Hands a copy of the analytics to a worker unless the previous write is still running. With bWait,
+	// waits for the previous write and for this one.
+	void FlushAnalytics(bool bWait);
+	void DumpAnalytics(FOutputDevice& Ar) const;
+
+	// Scenario started by the last UpdatePlayCount, so its duration can be recorded when the next one starts
+	FPrimaryAssetId CurrentScenarioId;
+	FDateTime CurrentScenarioStartTime;
+
+	// Chosen by Scenario.Persistence.Backend, falls back to local files. Null until the startup load is picked up.
+	mutable TSharedPtr<IScenarioStatsBackend> Backend;
+
+	// Startup load running on a worker thread, null once its result has been swapped in
+	mutable TSharedPtr<FScenarioStatsPendingLoad> PendingLoad;
+
+	// Weighted picker over the eligible rotation entries, rebuilt when entries or stats change
+	// or when a scenario's minimum gap runs out
+	mutable FScenarioRotationSampler RotationSampler;
+	mutable bool bRotationSamplerDirty = true;
+	mutable FDateTime RotationSamplerValidUntil;
+
+	void RebuildRotationSampler(const FDateTime& CurrentTime) const;
+
+	// Scenarios by popularity score, kept in order as plays and votes come in. Windowed scores
+	// drift as time passes, so with a popularity window the index is also rebuilt every hour.
+	mutable FScenarioPopularityIndex PopularityIndex;
+	mutable bool bPopularityIndexDirty = true;
+	mutable int32 PopularityIndexWindowHours = 0;
+	mutable int32 PopularityIndexHour = 0;
+
+	void RebuildPopularityIndex(int32 WindowHours, const FDateTime& CurrentTime) const;
+	float GetPopularityScore(const FScenarioStats& Stats, int32 WindowHours, const FDateTime& CurrentTime) const;
+
+	// Applies a change to the store and hands it to the backend
+	void ApplyDelta(const FScenarioStatsDelta& Delta);
+
+	// Picks up changes other processes or servers made through the backend
+	void RefreshFromBackend() const;
+
+	// Swaps in the result of the startup load once it is ready, waiting for it if bWait.
+	// Returns true once the store has been loaded.
+	bool FinishLoad(bool bWait) const;
 };
@@ -0,0 +1,90 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "ScenarioStatsFile.h"
+#include "Containers/Queue.h"
+#include <atomic>
+
+class FRunnableThread;
+class IFileHandle;
+
+/**
+ * Background writer for UScenarioPersistenceManager. The game thread hands over each change as a
+ * small delta; the worker batches them, appends them to the journal, and folds the journal into
+ * the snapshot once it grows past Scenario.Persistence.JournalCompactBytes. Snapshots replace the
+ * file through a temp file and a rename, so a crash mid-write never leaves a truncated file behind.
+ */
+class SHAREDGAMEMODE_API FScenarioPersistenceWriter : public FRunnable
+{
+public:
+	// LastSequence is the highest journal sequence already reflected in InStore.
+	// Without a background thread every change is written before Enqueue returns.
+	FScenarioPersistenceWriter(const FString& InSnapshotPath, const FString& InJournalPath, const FScenarioStatsStore& InStore, uint64 LastSequence, bool bBackgroundThread);
+
+	// Stops the worker after writing everything still queued and compacting the journal
+	virtual ~FScenarioPersistenceWriter() override;
+
+	// Game thread: queue a change for the next journal append
+	void Enqueue(const FScenarioStatsDelta& Delta);
+
+	// Blocks until everything queued so far is on disk
+	void Flush();
+
+	//~ Begin FRunnable Interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable Interface
+
+	// Writes Contents next to FilePath, then renames it over FilePath
+	static bool WriteFileAtomic(const FString& FilePath, const TArray<uint8>& Contents);
+
+private:
+	// Applies queued deltas to the worker's copy and encodes them for the journal, returns true if there were any
+	bool DrainQueue();
+
+	// Appends encoded deltas to the journal and compacts it once it is large enough
+	void WritePending();
+
+	// Writes a snapshot of the worker's copy and starts an empty journal
+	void Compact();
+
+	FString SnapshotPath;
+	FString JournalPath;
+
+	// Worker-owned copy of the store
+	FScenarioStatsStore Store;
+
+	// Encoded journal records not yet appended
+	TArray<uint8> PendingJournalBytes;
+
+	// Reused between snapshots so steady-state writes do not reallocate
+	TArray<uint8> SnapshotBuffer;
+
+	// Sequence of the last delta drained from the queue
+	uint64 LastSequence = 0;
+
+	TUniquePtr<IFileHandle> JournalHandle;
+	int64 JournalSize = 0;
+
+	// Set when the journal on disk still holds records from an earlier run
+	bool bCompactPending = false;
+
+	TQueue<FScenarioStatsDelta, EQueueMode::Mpsc> PendingDeltas;
+
+	// Wakes the worker when deltas arrive or a flush is requested
+	FEvent* WakeEvent = nullptr;
+
+	// Signalled by the worker each time it completes a flush request
+	FEvent* FlushedEvent = nullptr;
+
+	// Flush requests issued by the game thread and the last one the worker completed
+	std::atomic<int32> FlushRequested { 0 };
+	std::atomic<int32> FlushCompleted { 0 };
+
+	std::atomic<bool> bStopping { false };
+
+	FRunnableThread* Thread = nullptr;
+};
@@ -0,0 +1,57 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Scenarios kept sorted by popularity score, so the top N can be read off in O(N). A changed score
+ * moves its one entry into place: binary searches find the old and new positions and only the
+ * entries in between shift. Equal scores keep the order the scenarios were first added in.
+ */
+class SHAREDGAMEMODE_API FScenarioPopularityIndex
+{
+public:
+	void Reset();
+
+	// Adds a scenario without keeping the order, for filling the index in bulk before Build
+	void Add(const FPrimaryAssetId& ScenarioId, float Score);
+
+	// Sorts everything added since Reset
+	void Build();
+
+	// Inserts the scenario or moves it to its new score
+	void Update(const FPrimaryAssetId& ScenarioId, float Score);
+
+	void Remove(const FPrimaryAssetId& ScenarioId);
+
+	int32 Num() const { return Entries.Num(); }
+
+	// Appends the Count highest scoring scenarios to OutIds, best first
+	void GetTop(int32 Count, TArray<FPrimaryAssetId>& OutIds) const;
+
+private:
+	struct FKey
+	{
+		float Score = 0.0f;
+
+		// Breaks ties, so every entry has exactly one position
+		uint32 Order = 0;
+	};
+
+	struct FEntry
+	{
+		FPrimaryAssetId ScenarioId;
+		FKey Key;
+	};
+
+	static bool Precedes(const FKey& A, const FKey& B);
+
+	// First index in [Begin, End) whose entry does not precede Key
+	int32 LowerBound(int32 Begin, int32 End, const FKey& Key) const;
+
+	// Highest score first
+	TArray<FEntry> Entries;
+	TMap<FPrimaryAssetId, FKey> Keys;
+	uint32 NextOrder = 0;
+};
@@ -0,0 +1,39 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * The last Capacity scenarios played, as a ring buffer of ids plus a table of the play number each
+ * scenario was last seen at. Recording a play and asking how many matches ago a scenario was played
+ * are both O(1). A scenario drops out of the table when its last play is overwritten in the ring.
+ */
+class SHAREDGAMEMODE_API FScenarioRecentPlays
+{
+public:
+	static constexpr int32 Capacity = 64;
+
+	void Reset();
+
+	void Add(const FPrimaryAssetId& ScenarioId);
+
+	// Matches played since the scenario's last play: 0 if it was the latest, INDEX_NONE if it is not in the buffer
+	int32 GetMatchesSince(const FPrimaryAssetId& ScenarioId) const;
+
+	// True if the scenario is among the last NumMatches plays
+	bool WasPlayedWithin(const FPrimaryAssetId& ScenarioId, int32 NumMatches) const;
+
+	int32 Num() const { return static_cast<int32>(FMath::Min<int64>(NumPlays, Capacity)); }
+
+	// The scenario played MatchesAgo matches before the latest one, 0 for the latest; MatchesAgo must be below Num
+	const FPrimaryAssetId& GetRecent(int32 MatchesAgo) const;
+
+private:
+	FPrimaryAssetId Ring[Capacity];
+
+	// Plays recorded since Reset; the next play goes to Ring[NumPlays % Capacity]
+	int64 NumPlays = 0;
+
+	TMap<FPrimaryAssetId, int64> LastPlayNumbers;
+};
@@ -0,0 +1,85 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/IHttpRequest.h"
+#include "ScenarioStatsBackend.h"
+
+/**
+ * Sends stat deltas to a fleet-wide aggregation service over HTTP and pulls its global snapshot back.
+ *
+ * Deltas are encoded as journal records and batched; at most one batch is in flight, retried with
+ * exponential backoff until the service accepts it. Each batch carries this server's client id and
+ * record sequences, so the service can drop retried records it already applied. The id and a block of
+ * reserved sequences are kept on disk, so batches resent after a restart are still recognized. When the unsent
+ * backlog passes Scenario.Persistence.Remote.MaxPendingBytes it spills to disk instead of growing in
+ * memory, and anything unsent at shutdown is spilled too and sent first on the next run.
+ *
+ * POST <Url>/deltas?client=<id>  body: journal records
+ * GET  <Url>/snapshot            body: binary stats file
+ */
+class SHAREDGAMEMODE_API FScenarioRemoteStatsBackend : public IScenarioStatsBackend, public TSharedFromThis<FScenarioRemoteStatsBackend>
+{
+public:
+	FScenarioRemoteStatsBackend(const FScenarioStatsFilePaths& InPaths, const FString& InUrl);
+	virtual ~FScenarioRemoteStatsBackend() override;
+
+	//~ Begin IScenarioStatsBackend Interface
+	virtual bool Load(FScenarioStatsStore& OutStore) override;
+	virtual void Start() override;
+	virtual void Apply(const FScenarioStatsDelta& Delta) override;
+	virtual bool Refresh(FScenarioStatsStore& InOutStore) override;
+	virtual void Shutdown(const FScenarioStatsStore& Store) override;
+	//~ End IScenarioStatsBackend Interface
+
+private:
+	bool Tick(float DeltaTime);
+
+	void SendNextBatch();
+	void OnBatchSent(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bConnectedSuccessfully);
+
+	void RequestSnapshot();
+	void OnSnapshotReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bConnectedSuccessfully);
+
+	// Appends Bytes to the spill file, dropping them if the spill file is already at its limit
+	void Spill(const TArray<uint8>& Bytes);
+
+	FString GetSendingSpillPath() const;
+
+	// Saves the client id with the next block of sequences, so a restart continues past every sequence
+	// that may have been sent. Returns false if the file could not be written.
+	bool ReserveSequences();
+
+	FScenarioStatsFilePaths Paths;
+	FString Url;
+	FString ClientId;
+
+	// Sequence of the last delta encoded
+	uint64 LastSequence = 0;
+
+	// Sequences up to this one are covered by the client file
+	uint64 ReservedSequence = 0;
+
+	// Encoded deltas not yet part of a batch
+	TArray<uint8> PendingBytes;
+
+	// Batch being sent or waiting to be retried
+	TArray<uint8> InFlightBytes;
+
+	// The in-flight batch came from the spill file and is still on disk as the sending file
+	bool bInFlightFromSpill = false;
+
+	FHttpRequestPtr BatchRequest;
+	FHttpRequestPtr SnapshotRequest;
+
+	int32 FailedAttempts = 0;
+	double NextSendTime = 0.0;
+	double NextSnapshotTime = 0.0;
+
+	// Latest global snapshot not yet handed to the manager
+	TOptional<FScenarioStatsStore> ReceivedSnapshot;
+
+	FTSTicker::FDelegateHandle TickHandle;
+};
@@ -0,0 +1,80 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+
+/** A scenario the planner may offer, with everything it needs copied out of the stats store */
+struct SHAREDGAMEMODE_API FScenarioRotationPlanCandidate
+{
+	FPrimaryAssetId ScenarioId;
+
+	// Rotation weight scaled by how well the scenario suits the current player count
+	float Weight = 1.0f;
+
+	int32 MinimumMatchesBetweenPlays = 0;
+	FTimespan MinimumGap;
+
+	// Matches since the last real play, INDEX_NONE if not played recently
+	int32 MatchesSinceLastPlay = INDEX_NONE;
+	FDateTime LastPlayed;
+
+	// Tags under the diversity roots; consecutive slots and the options of one slot avoid sharing them
+	FGameplayTagContainer DiversityTags;
+};
+
+/** One upcoming match */
+struct SHAREDGAMEMODE_API FScenarioRotationPlanSlot
+{
+	// Options offered in the vote for this match, best first. Later slots assume the first one wins.
+	TArray<FPrimaryAssetId> Options;
+
+	// Projected time of the vote
+	FDateTime VoteTime;
+};
+
+struct SHAREDGAMEMODE_API FScenarioRotationPlan
+{
+	TArray<FScenarioRotationPlanSlot> Slots;
+
+	// Incremented by the owner whenever the inputs change, so a plan built from old inputs can be dropped
+	uint32 Generation = 0;
+
+	double PlanSeconds = 0.0;
+};
+
+struct SHAREDGAMEMODE_API FScenarioRotationPlanInput
+{
+	TArray<FScenarioRotationPlanCandidate> Candidates;
+
+	// Slots still valid from the previous plan; they are kept and only the slots after them are planned
+	TArray<FScenarioRotationPlanSlot> KeepSlots;
+
+	// Diversity tags of the most recent real plays, newest first
+	TArray<FGameplayTagContainer> RecentDiversityTags;
+
+	// Projected time of the next vote and the expected length of a match
+	FDateTime FirstVoteTime;
+	FTimespan MatchLength;
+
+	int32 NumSlots = 0;
+	int32 NumOptions = 0;
+
+	// How many previous matches a slot's options avoid sharing diversity tags with
+	int32 DiversityMatches = 0;
+
+	int32 Seed = 0;
+	uint32 Generation = 0;
+};
+
+/**
+ * Plans the next rotation slots off the game thread. Each slot draws its options by weight without
+ * replacement (Efraimidis-Spirakis keys) from the candidates whose wall-time and match-count cooldowns
+ * have run out by then, assuming the earlier slots' first options were played. Cooldowns are hard
+ * constraints; tag diversity is soft and is dropped for a slot that cannot be filled otherwise.
+ */
+struct SHAREDGAMEMODE_API FScenarioRotationPlanner
+{
+	static FScenarioRotationPlan Plan(const FScenarioRotationPlanInput& Input);
+};
@@ -0,0 +1,42 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Weighted random scenario picker backed by a Vose alias table. Building is O(n); each draw is O(1).
+ * Drawing several distinct scenarios rejects repeats, which stays O(k) while the picked scenarios
+ * hold a small share of the total weight; if rejections pile up it finishes with a linear pass.
+ */
+class SHAREDGAMEMODE_API FScenarioRotationSampler
+{
+public:
+	void Reset();
+
+	// Adds a candidate; candidates with no weight are ignored
+	void Add(const FPrimaryAssetId& ScenarioId, float Weight);
+
+	// Builds the alias table from the added candidates
+	void Build();
+
+	int32 Num() const { return Ids.Num(); }
+
+	// Appends up to Count distinct scenarios that are not in Exclude to OutIds
+	void Sample(int32 Count, const TArray<FPrimaryAssetId>& Exclude, TArray<FPrimaryAssetId>& OutIds) const;
+
+private:
+	int32 SampleIndex() const;
+
+	TArray<FPrimaryAssetId> Ids;
+	TArray<float> Weights;
+
+	// Chance of keeping the drawn column rather than taking its alias
+	TArray<float> Probabilities;
+	TArray<int32> Aliases;
+
+	// Build scratch, kept so rebuilding does not reallocate
+	TArray<int32> Small;
+	TArray<int32> Large;
+	TArray<float> Scaled;
+};
@@ -0,0 +1,68 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ScenarioStatsFile.h"
+
+/**
+ * Scenario stats shared by every server process on the host through one memory-mapped file.
+ *
+ * The file is a fixed-capacity open-addressing table keyed by asset id. Per-match deltas (plays,
+ * votes, player count samples) are atomic adds on the mapped memory, so processes never block each
+ * other for them. Each slot also holds the hourly and daily history buckets; only recycling a bucket
+ * for a new hour or day takes the lock. Claiming a slot and replacing a whole record take an exclusive file lock. Slots are
+ * never freed, so lookups need no lock. The first process to create the file seeds it from its own
+ * snapshot; later processes attach to the existing table.
+ *
+ * Only available where POSIX mmap and flock exist (Linux and Mac); Open fails elsewhere.
+ */
+class SHAREDGAMEMODE_API FScenarioSharedStatsStore
+{
+public:
+	~FScenarioSharedStatsStore();
+
+	static bool IsSupported();
+
+	// Maps the store at FilePath, creating and seeding it if it does not exist yet. Returns null on failure.
+	static TSharedPtr<FScenarioSharedStatsStore> Open(const FString& FilePath, int32 Capacity, const FScenarioStatsStore& Seed);
+
+	// Applies a change for every process on the host
+	bool Apply(const FScenarioStatsDelta& Delta);
+
+	// Bumped by every change from any process, so readers can skip copying an unchanged store
+	uint64 GetChangeCounter() const;
+
+	// Copies the whole store
+	void ReadAll(FScenarioStatsStore& OutStore) const;
+
+	// Asks the OS to write the mapped pages back to the file
+	void Sync();
+
+private:
+	struct FHeader;
+	struct FSlot;
+	struct FBucket;
+
+	FScenarioSharedStatsStore() = default;
+
+	FSlot* FindSlot(const FString& Key, uint32 KeyHash) const;
+	FSlot* FindOrAddSlot(const FPrimaryAssetId& ScenarioId);
+
+	// Returns the bucket for Epoch, recycling it under the lock if it holds an older period, or null if it holds a newer one
+	FBucket* ClaimBucket(FBucket* Buckets, int32 NumBuckets, int32 Epoch);
+
+	// Runs Functor on the hourly and the daily bucket an event at Ticks lands in
+	template<typename FunctorType>
+	void AddToHistory(FSlot& Slot, int64 Ticks, FunctorType&& Functor);
+
+	void Lock();
+	void Unlock();
+
+	int32 FileDescriptor = -1;
+	uint8* MappedData = nullptr;
+	SIZE_T MappedSize = 0;
+
+	FHeader* Header = nullptr;
+	FSlot* Slots = nullptr;
+};
@@ -0,0 +1,102 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ScenarioStatsFile.h"
+
+class FScenarioPersistenceWriter;
+class FScenarioSharedStatsStore;
+
+/** Where the stats backends keep their files */
+struct SHAREDGAMEMODE_API FScenarioStatsFilePaths
+{
+	FString Snapshot;
+	FString Journal;
+	FString LegacyJson;
+	FString SharedStore;
+	FString RemoteCache;
+	FString RemoteSpill;
+	FString RemoteClient;
+
+	// Outcome analytics, always local to the server whichever backend keeps the stats
+	FString Analytics;
+
+	static FScenarioStatsFilePaths InDirectory(const FString& Directory);
+};
+
+/**
+ * Storage behind UScenarioPersistenceManager. The manager keeps the working copy of the store and
+ * applies every change to it first; the backend makes the change durable or sends it on. Load runs on
+ * a worker thread while the game instance starts; every other call comes from the game thread and must
+ * not block on disk or network I/O.
+ */
+class SHAREDGAMEMODE_API IScenarioStatsBackend
+{
+public:
+	virtual ~IScenarioStatsBackend() = default;
+
+	// Fills the store at startup, off the game thread. Returns false if the backend cannot be used, so the caller can fall back.
+	virtual bool Load(FScenarioStatsStore& OutStore) = 0;
+
+	// Called on the game thread after a successful Load, before any other call
+	virtual void Start() {}
+
+	// Records a change the caller already applied to its store
+	virtual void Apply(const FScenarioStatsDelta& Delta) = 0;
+
+	// Replaces the caller's store if the backend has a newer view from elsewhere, returns true if it did
+	virtual bool Refresh(FScenarioStatsStore& InOutStore) { return false; }
+
+	// Called once before the backend is destroyed, with the final store
+	virtual void Shutdown(const FScenarioStatsStore& Store) {}
+};
+
+/** Snapshot plus journal in the saved directory, written by FScenarioPersistenceWriter */
+class SHAREDGAMEMODE_API FScenarioFileStatsBackend : public IScenarioStatsBackend
+{
+public:
+	FScenarioFileStatsBackend(const FScenarioStatsFilePaths& InPaths, bool bInWriteBehind);
+	virtual ~FScenarioFileStatsBackend() override;
+
+	//~ Begin IScenarioStatsBackend Interface
+	virtual bool Load(FScenarioStatsStore& OutStore) override;
+	virtual void Apply(const FScenarioStatsDelta& Delta) override;
+	virtual void Shutdown(const FScenarioStatsStore& Store) override;
+	//~ End IScenarioStatsBackend Interface
+
+	// Reads the snapshot and replays the journal, importing the legacy JSON file if there is no snapshot.
+	// OutJournalSequence is the highest journal sequence reflected in the result.
+	static void LoadFromDisk(const FScenarioStatsFilePaths& Paths, FScenarioStatsStore& OutStore, uint64& OutJournalSequence, bool& bOutImportedLegacy);
+
+	static bool SaveSnapshot(const FString& FilePath, const FScenarioStatsStore& Store, uint64 JournalSequence);
+
+private:
+	FScenarioStatsFilePaths Paths;
+	bool bWriteBehind;
+	TSharedPtr<FScenarioPersistenceWriter> Writer;
+};
+
+/** Host-wide memory-mapped store shared with the other server processes, see FScenarioSharedStatsStore */
+class SHAREDGAMEMODE_API FScenarioSharedStatsBackend : public IScenarioStatsBackend
+{
+public:
+	FScenarioSharedStatsBackend(const FScenarioStatsFilePaths& InPaths, int32 InCapacity);
+
+	//~ Begin IScenarioStatsBackend Interface
+	virtual bool Load(FScenarioStatsStore& OutStore) override;
+	virtual void Apply(const FScenarioStatsDelta& Delta) override;
+	virtual bool Refresh(FScenarioStatsStore& InOutStore) override;
+	virtual void Shutdown(const FScenarioStatsStore& Store) override;
+	//~ End IScenarioStatsBackend Interface
+
+private:
+	FScenarioStatsFilePaths Paths;
+	int32 Capacity;
+	uint64 JournalSequence = 0;
+
+	TSharedPtr<FScenarioSharedStatsStore> SharedStore;
+
+	// Change counter the caller's store was last refreshed at
+	uint64 LastChangeCounter = 0;
+};
@@ -0,0 +1,91 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ScenarioPersistenceManager.h"
+
+enum class EScenarioStatsDeltaKind : uint8
+{
+	// Adds one play and sets the last played time
+	Play,
+	// Adds to the total votes
+	Votes,
+	// Folds one player count into the running average
+	PlayerCountSample,
+	// Replaces the whole stats record
+	Stats,
+	// Replaces the rotation entry for the scenario
+	RotationEntry,
+	// Records how long a match of the scenario lasted
+	MatchDuration,
+};
+
+/**
+ * A single change to the stats store. Applied to the in-memory store as it happens and
+ * appended to the journal, so replaying the journal reproduces exactly the same store.
+ */
+struct SHAREDGAMEMODE_API FScenarioStatsDelta
+{
+	EScenarioStatsDeltaKind Kind = EScenarioStatsDeltaKind::Play;
+	FPrimaryAssetId ScenarioId;
+
+	// Times played or minimum gap, depending on kind
+	int32 Count = 0;
+
+	// Votes or minimum matches between plays, depending on kind
+	int32 Votes = 0;
+
+	// Player count, average player count, weight or match seconds, depending on kind
+	float Value = 0.0f;
+
+	// When the change happened, which places it in the history buckets
+	int64 Ticks = 0;
+
+	static FScenarioStatsDelta MakePlay(const FPrimaryAssetId& ScenarioId, const FDateTime& PlayedAt);
+	static FScenarioStatsDelta MakeVotes(const FPrimaryAssetId& ScenarioId, int32 Votes, const FDateTime& VotedAt);
+	static FScenarioStatsDelta MakePlayerCountSample(const FPrimaryAssetId& ScenarioId, float PlayerCount, const FDateTime& SampledAt);
+	static FScenarioStatsDelta MakeMatchDuration(const FPrimaryAssetId& ScenarioId, float Seconds, const FDateTime& EndedAt);
+	static FScenarioStatsDelta MakeStats(const FScenarioStats& Stats);
+	static FScenarioStatsDelta MakeRotationEntry(const FScenarioRotationEntry& Entry);
+
+	void Apply(FScenarioStatsStore& Store) const;
+};
+
+/**
+ * Versioned binary scenario stats file.
+ *
+ * Header: magic, schema version, header size, string/stats/rotation counts, payload size, payload CRC32,
+ * the last journal sequence folded into the snapshot and the history record count.
+ * Payload: a string table of length-prefixed UTF-8 names, then fixed-size stats records, then fixed-size
+ * rotation records, then sparse history records. Asset ids are stored as two string table indices, so
+ * stats and rotation records have a fixed size, and the whole file is validated in one pass after a single read.
+ *
+ * The journal next to it is a list of self-checking delta records, each carrying a sequence number.
+ * Records at or below the snapshot's sequence are already part of the snapshot and are skipped on replay.
+ */
+struct SHAREDGAMEMODE_API FScenarioStatsFile
+{
+	static constexpr uint32 Magic = 0x53534753; // "SGSS"
+	static constexpr uint16 CurrentVersion = 4;
+
+	// Serializes the store into OutBytes
+	static void Write(const FScenarioStatsStore& Store, uint64 JournalSequence, TArray<uint8>& OutBytes);
+
+	// Validates and parses a file written by Write, leaving the outputs untouched on failure
+	static bool Read(const TArray<uint8>& Bytes, FScenarioStatsStore& OutStore, uint64& OutJournalSequence, FString& OutError);
+
+	// Appends one journal record to OutBytes
+	static void AppendJournalRecord(const FScenarioStatsDelta& Delta, uint64 Sequence, TArray<uint8>& OutBytes);
+
+	// Visits every journal record after AfterSequence in order, stopping at the first torn or damaged record.
+	// Returns the number of records visited.
+	static int32 ReadJournal(const TArray<uint8>& Bytes, uint64 AfterSequence, TFunctionRef<void(uint64 Sequence, const FScenarioStatsDelta& Delta)> Visitor);
+
+	// Applies every journal record after AfterSequence, see ReadJournal.
+	// Returns the number of records applied; OutLastSequence is the highest sequence seen.
+	static int32 ReplayJournal(const TArray<uint8>& Bytes, uint64 AfterSequence, FScenarioStatsStore& Store, uint64& OutLastSequence);
+
+	// One-way migration from the old ScenarioStats.json layout
+	static bool ImportJson(const FString& JsonString, FScenarioStatsStore& OutStore);
+};
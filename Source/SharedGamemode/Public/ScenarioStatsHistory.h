@@ -0,0 +1,71 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Activity of one scenario during one hour or one day */
+struct SHAREDGAMEMODE_API FScenarioStatsBucket
+{
+	// Player counts are binned by powers of two: 1, 2-3, 4-7, ... 128+
+	static constexpr int32 NumPlayerCountBins = 8;
+
+	// Hour or day number the bucket holds, INDEX_NONE while unused
+	int32 Epoch = INDEX_NONE;
+
+	int32 Plays = 0;
+	int32 Votes = 0;
+	int32 PlayerCountSamples = 0;
+	int32 PlayerCountSum = 0;
+	uint16 PlayerCountHistogram[NumPlayerCountBins] = {};
+	int32 DurationSeconds = 0;
+	int32 DurationSamples = 0;
+
+	static int32 GetPlayerCountBin(float PlayerCount);
+
+	bool IsEmpty() const { return Epoch == INDEX_NONE; }
+};
+
+/** Activity summed over a window, see FScenarioStatsHistory::GetPopularity */
+struct SHAREDGAMEMODE_API FScenarioPopularity
+{
+	int32 Plays = 0;
+	int32 Votes = 0;
+	float AveragePlayerCount = 0.0f;
+	float AverageDurationSeconds = 0.0f;
+	int32 PlayerCountHistogram[FScenarioStatsBucket::NumPlayerCountBins] = {};
+};
+
+/**
+ * Per-scenario ring buffers of hourly and daily buckets. Each bucket remembers which hour or day
+ * it holds, so recording an event is O(1): it either adds to the current bucket or recycles a
+ * bucket that has fallen out of the window. Events older than the bucket they map to are dropped.
+ */
+struct SHAREDGAMEMODE_API FScenarioStatsHistory
+{
+	static constexpr int32 NumHourlyBuckets = 48;
+	static constexpr int32 NumDailyBuckets = 30;
+
+	FScenarioStatsBucket Hourly[NumHourlyBuckets];
+	FScenarioStatsBucket Daily[NumDailyBuckets];
+
+	static int32 GetHourEpoch(const FDateTime& Time);
+	static int32 GetDayEpoch(const FDateTime& Time);
+
+	void AddPlay(const FDateTime& Time);
+	void AddVotes(const FDateTime& Time, int32 Votes);
+	void AddPlayerCount(const FDateTime& Time, float PlayerCount);
+	void AddDuration(const FDateTime& Time, float Seconds);
+
+	// Activity over the last Hours hours. Up to NumHourlyBuckets hours this sums hourly buckets; longer windows
+	// are rounded up to whole UTC days and sum only daily buckets, so 49 hours may cover up to 72 hours.
+	// Touches at most Hours buckets, however long the scenario has been played.
+	FScenarioPopularity GetPopularity(const FDateTime& Now, int32 Hours) const;
+
+	bool IsEmpty() const;
+
+private:
+	// Runs Functor on the hourly and the daily bucket the event lands in, skipping one that already holds a later period
+	template<typename FunctorType>
+	void AddToBuckets(const FDateTime& Time, FunctorType&& Functor);
+};
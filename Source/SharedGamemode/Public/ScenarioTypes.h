@@ -31,4 +31,50 @@ enum class EScenarioCompletionMode : uint8
     
 	// Succeed only if ALL trackers succeed
 	AllSuccess
-};
\ No newline at end of file
+};
+
+/**
+ * Incremental success/failure tally over a fixed set of children (trackers of an objective,
+ * objectives of a stage, or branches of a fork). Children report each result change once,
+ * so evaluating the set is O(1) no matter how many children it has.
+ */
+struct FScenarioCompletionCounter
+{
+	int32 Total = 0;
+	int32 Succeeded = 0;
+	int32 Failed = 0;
+
+	void Reset(int32 InTotal)
+	{
+		Total = InTotal;
+		Succeeded = 0;
+		Failed = 0;
+	}
+
+	// Move one child from its old result to its new result
+	void ApplyTransition(EScenarioResult OldResult, EScenarioResult NewResult)
+	{
+		Succeeded += (NewResult == EScenarioResult::Success) - (OldResult == EScenarioResult::Success);
+		Failed += (NewResult == EScenarioResult::Failure) - (OldResult == EScenarioResult::Failure);
+	}
+
+	EScenarioResult Evaluate(EScenarioCompletionMode Mode) const
+	{
+		if (Mode == EScenarioCompletionMode::AllSuccess)
+		{
+			// Any failure sinks the set, otherwise wait for every child to succeed
+			if (Failed > 0)
+			{
+				return EScenarioResult::Failure;
+			}
+			return Succeeded == Total ? EScenarioResult::Success : EScenarioResult::InProgress;
+		}
+
+		// Any success completes the set, otherwise wait for every child to fail
+		if (Succeeded > 0)
+		{
+			return EScenarioResult::Success;
+		}
+		return Failed == Total ? EScenarioResult::Failure : EScenarioResult::InProgress;
+	}
+};
@@ -4,12 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameplayTagContainer.h"
+#include "GameplayTagSmallMap.h"
 #include "Net/Serialization/FastArraySerializer.h"
 #include "TagStackContainer.generated.h"
 
 // Represents a single tag and its stack count
 USTRUCT()
-struct FTagStack : public FFastArraySerializerItem
+struct SHAREDGAMEMODE_API FTagStack : public FFastArraySerializerItem
 {
     GENERATED_BODY()
 
@@ -28,16 +29,75 @@ struct FTagStack : public FFastArraySerializerItem
     UPROPERTY()
     int32 StackCount = 0;
 
+    // Server-side opt-in to send counts at or above QuantizeThreshold with reduced precision
+    bool bAllowQuantizedCount = false;
+
+    // Counts below this always replicate exactly
+    static constexpr int32 QuantizeThreshold = 1 << 16;
+
+    // Mantissa bits kept for quantized counts (relative error below 0.05%)
+    static constexpr int32 QuantizedMantissaBits = 10;
+
+    // Sends the tag as its fast replication net index and the count as a zig-zag varint
+    bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
     // Debug helper
     FString GetDebugString() const;
 };
 
+template<>
+struct TStructOpsTypeTraits<FTagStack> : public TStructOpsTypeTraitsBase2<FTagStack>
+{
+    enum
+    {
+        WithNetSerializer = true,
+    };
+};
+
 // Delegate to notify when tag counts change
 DECLARE_MULTICAST_DELEGATE_ThreeParams(FTagStackChanged, FGameplayTag /*Tag*/, int32 /*NewCount*/, int32 /*OldCount*/);
 
+// How a threshold watcher compares a tag's stack count against its threshold
+UENUM(BlueprintType)
+enum class ETagStackComparison : uint8
+{
+    GreaterOrEqual,
+    Greater,
+    LessOrEqual,
+    Less,
+    Equal,
+    NotEqual
+};
+
+// Called once when a watched tag's stack count meets the watcher's condition
+DECLARE_DELEGATE_TwoParams(FTagStackThresholdReached, FGameplayTag /*Tag*/, int32 /*Count*/);
+
+struct FTagStackBatch;
+
+// Count changes waiting for the end-of-frame coalesced broadcast. Copies start empty and
+// unregistered, since a pending end-of-frame registration belongs to the original container.
+struct SHAREDGAMEMODE_API FTagStackPendingNotifications
+{
+    FTagStackPendingNotifications() = default;
+    FTagStackPendingNotifications(const FTagStackPendingNotifications&) {}
+    FTagStackPendingNotifications& operator=(const FTagStackPendingNotifications&) { return *this; }
+    ~FTagStackPendingNotifications();
+
+    struct FChange
+    {
+        int32 OldCount;
+        int32 NewCount;
+    };
+
+    // First old and last new count per tag, in the order tags first changed this frame
+    TMap<FGameplayTag, FChange> Changes;
+
+    FDelegateHandle EndFrameHandle;
+};
+
 // Container that manages tag stacks with network replication support
 USTRUCT()
-struct FTagStackContainer : public FFastArraySerializer
+struct SHAREDGAMEMODE_API FTagStackContainer : public FFastArraySerializer
 {
     GENERATED_BODY()
 
@@ -50,8 +110,23 @@ struct FTagStackContainer : public FFastArraySerializer
     void ClearStack(FGameplayTag Tag);
 
     // Query methods
-    int32 GetStackCount(FGameplayTag Tag) const { return TagToCountMap.FindRef(Tag); }
-    bool ContainsTag(FGameplayTag Tag) const { return TagToCountMap.Contains(Tag); }
+    int32 GetStackCount(FGameplayTag Tag) const
+    {
+        const FSlot* Slot = TagToSlotMap.Find(Tag);
+        return Slot ? Slot->Count : 0;
+    }
+    bool ContainsTag(FGameplayTag Tag) const { return TagToSlotMap.Contains(Tag); }
+
+    // Total stacks of Tag and every tag below it (e.g. Score.Kills counts Score.Kills.Headshot too)
+    int32 GetStackCountIncludingChildren(FGameplayTag Tag) const
+    {
+        const int32* AggregateCount = TagToAggregateCountMap.Find(Tag);
+        return AggregateCount ? *AggregateCount : 0;
+    }
+
+    // Replicate large counters with reduced precision. Clients then see approximate values above
+    // FTagStack::QuantizeThreshold, so only enable this for display-style counters.
+    void SetQuantizeLargeCounts(bool bInQuantizeLargeCounts);
 
     // Network serialization support
     bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
@@ -63,20 +138,129 @@ struct FTagStackContainer : public FFastArraySerializer
     void PreReplicatedRemove(const TArrayView<int32> RemovedIndices, int32 FinalSize);
     void PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize);
     void PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize);
+    void PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters);
 
-    // Change notification
+    // Change notification, fired immediately for every change
     FTagStackChanged OnTagCountChanged;
 
+    // Change notification fired once per changed tag at the end of the frame, with the tag's count
+    // before its first change and after its last one. Tags that end the frame where they started
+    // are skipped. Changes are only recorded while something is bound. The container must stay at
+    // the same address while changes are pending (as it does as a member of a UObject).
+    FTagStackChanged OnTagCountChangedCoalesced;
+
+    // Delivers pending coalesced notifications now instead of at the end of the frame
+    void FlushCoalescedChanges();
+
+    // Calls Callback once, as soon as Tag's stack count compares true against Threshold. If the count
+    // already does, Callback runs right away and the returned handle is invalid. Works on clients too,
+    // where replicated changes are evaluated as they arrive.
+    FDelegateHandle AddThresholdWatcher(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, FTagStackThresholdReached&& Callback);
+
+    // Drops a watcher that has not fired yet
+    void RemoveThresholdWatcher(FGameplayTag Tag, FDelegateHandle Handle);
+
+    static bool CompareStackCount(int32 Count, ETagStackComparison Comparison, int32 Threshold);
+
+    // Heap memory held by the container, not counting the container itself
+    SIZE_T GetAllocatedSize() const;
+
 private:
+    // Whether new entries may replicate their counts quantized
+    bool bQuantizeLargeCounts = false;
+
     // The actual storage of tag stacks
     UPROPERTY()
     TArray<FTagStack> Stacks;
 
-    // Quick lookup map for stack counts
-    TMap<FGameplayTag, int32> TagToCountMap;
+    // Where a tag's entry lives in Stacks, and its count as last seen by the lookup. On clients the
+    // count is what the old value of a replicated change is read from.
+    struct FSlot
+    {
+        int32 Index = INDEX_NONE;
+        int32 Count = 0;
+    };
+
+    // Slot of every tag in Stacks, kept in sync across swap-removals
+    TGameplayTagSmallMap<FSlot> TagToSlotMap;
+
+    // Stack totals for every tag and each of its parents, only holding non-zero totals. Parents make
+    // this outgrow a small inline buffer quickly, so it is a plain map that allocates on first use.
+    TMap<FGameplayTag, int32> TagToAggregateCountMap;
+
+    // Indices removed by the last replication update. The fast array swap-removes them only
+    // after all callbacks have run, so moved entries are re-indexed in PostReplicatedReceive.
+    TArray<int32> PendingReplicatedRemovals;
+
+    // Adds a new entry for a tag that has no stacks yet
+    void AddNewStack(FGameplayTag Tag, int32 StackCount);
+
+    // Changes waiting for OnTagCountChangedCoalesced
+    FTagStackPendingNotifications PendingNotifications;
+
+    struct FThresholdWatcher
+    {
+        FDelegateHandle Handle;
+        ETagStackComparison Comparison;
+        int32 Threshold;
+        FTagStackThresholdReached Callback;
+    };
+
+    // Watchers that have not fired yet, by watched tag, so a change only looks at its own tag's watchers
+    TMap<FGameplayTag, TArray<FThresholdWatcher>> WatchersByTag;
+
+    // Fires and drops the watchers of Tag whose condition NewCount now meets
+    void EvaluateThresholdWatchers(FGameplayTag Tag, int32 NewCount);
+
+    // Every count change funnels through here: updates the aggregates, then notifies listeners
+    void NotifyStackChanged(FGameplayTag Tag, int32 NewCount, int32 OldCount);
+
+    // Records a change for the coalesced broadcast, registering for the end of the frame if needed
+    void RecordCoalescedChange(FGameplayTag Tag, int32 NewCount, int32 OldCount);
+
+    // Applies a count delta to Tag's aggregate and those of all its parents
+    void UpdateAggregateCounts(FGameplayTag Tag, int32 Delta);
+
+    // Swap-removes the entry at Index, fixing up the index of the entry moved into its slot.
+    // The caller marks the array dirty.
+    void RemoveStackAt(int32 Index);
+
+    // Applies the merged final counts of a batch, then notifies once per changed tag
+    void ApplyBatch(const TMap<FGameplayTag, int32, TInlineSetAllocator<16>>& NewCounts);
+
+    friend struct FTagStackBatch;
+};
+
+/**
+ * Scoped batch of tag stack mutations. Changes to the same tag are merged, each affected entry is
+ * marked dirty once, and OnTagCountChanged fires once per changed tag when the batch is committed
+ * (at the latest when it goes out of scope). The container should not be mutated directly while a
+ * batch on it is open.
+ */
+struct SHAREDGAMEMODE_API FTagStackBatch : public FNoncopyable
+{
+    explicit FTagStackBatch(FTagStackContainer& InContainer);
+    ~FTagStackBatch();
+
+    // Same rules as the FTagStackContainer functions of the same name
+    void AddStack(FGameplayTag Tag, int32 StackCount);
+    void RemoveStack(FGameplayTag Tag, int32 StackCount);
+    void SetStack(FGameplayTag Tag, int32 StackCount);
+    void ClearStack(FGameplayTag Tag);
+
+    // Stack count the tag will have once the batch is applied
+    int32 GetStackCount(FGameplayTag Tag) const;
+
+    // Apply the pending changes now; the batch can keep being used afterwards
+    void Commit();
+
+private:
+    int32& FindOrAddPending(FGameplayTag Tag);
+
+    FTagStackContainer& Container;
 
-    // Helper to rebuild the lookup map
-    void RebuildTagToCountMap();
+    // Final stack count per touched tag, zero meaning removed
+    TMap<FGameplayTag, int32, TInlineSetAllocator<16>> PendingCounts;
 };
 
 // Enable network delta serialization
@@ -41,6 +41,19 @@ public:
 	UPROPERTY(VisibleAnywhere, Category = "Stage")
 	UScenarioStage* NextStage_Failure;
 
+	// Parallel branches started when this stage is entered. Each branch runs its own
+	// success/failure chain; the stage completes once the branches join per JoinMode.
+	// Objectives on a forking stage are ignored, its services still run. Branch stages cannot fork
+	// again, and a branch stage without objective trackers succeeds as soon as it is entered.
+	UPROPERTY(VisibleAnywhere, Category = "Stage")
+	TArray<UScenarioStage*> ForkBranches;
+
+	// How branch results combine into this stage's result
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Stage")
+	EScenarioCompletionMode JoinMode;
+
+	bool IsForkStage() const { return ForkBranches.Num() > 0; }
+
 	// Stage components
 	UPROPERTY(VisibleAnywhere, Category = "Stage")
 	TArray<UScenarioObjective*> Objectives;
@@ -38,24 +38,90 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Scenario")
 	UScenarioInstance* GetScenarioInstance() const;
 
-	// Tag-based data sharing helpers
+	// Tag-based data sharing helpers, backed by the instance's blackboard. Integers, floats, vectors,
+	// object pointers and any USTRUCT can be shared; only the server writes.
 	template<typename T>
-	void ShareData(FGameplayTag Tag, T Value)
+	void ShareData(FGameplayTag Tag, const T& Value)
 	{
-		if (UScenarioInstance* Instance = GetScenarioInstance())
+		UScenarioInstance* Instance = GetScenarioInstance();
+		if (!Instance || !Instance->HasAuthority())
 		{
-			//Instance->SetTagStack(Tag, Value);
+			return;
+		}
+
+		FScenarioBlackboard& Blackboard = Instance->GetBlackboard();
+		if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+		{
+			Blackboard.SetInt(Tag, static_cast<int32>(Value));
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			Blackboard.SetFloat(Tag, static_cast<float>(Value));
+		}
+		else if constexpr (std::is_same_v<T, FVector>)
+		{
+			Blackboard.SetVector(Tag, Value);
+		}
+		else if constexpr (std::is_convertible_v<T, UObject*>)
+		{
+			Blackboard.SetObject(Tag, Value);
+		}
+		else if constexpr (std::is_same_v<T, FInstancedStruct>)
+		{
+			Blackboard.SetStruct(Tag, Value);
+		}
+		else
+		{
+			Blackboard.SetStruct(Tag, FInstancedStruct::Make(Value));
 		}
 	}
 
+	// Reads a value shared with ShareData. Numbers that are not on the blackboard fall back to the
+	// tag's stack count, so counters kept as tag stacks read the same as before.
 	template<typename T>
 	T GetSharedData(FGameplayTag Tag, T DefaultValue = T()) const
 	{
-		if (UScenarioInstance* Instance = GetScenarioInstance())
+		const UScenarioInstance* Instance = GetScenarioInstance();
+		if (!Instance)
+		{
+			return DefaultValue;
+		}
+
+		const FScenarioBlackboard& Blackboard = Instance->GetBlackboard();
+		if constexpr (std::is_integral_v<T> || std::is_enum_v<T> || std::is_floating_point_v<T>)
 		{
+			int32 IntValue = 0;
+			float FloatValue = 0.f;
+			if (Blackboard.GetInt(Tag, IntValue))
+			{
+				return static_cast<T>(IntValue);
+			}
+			if (Blackboard.GetFloat(Tag, FloatValue))
+			{
+				return static_cast<T>(FloatValue);
+			}
 			return static_cast<T>(Instance->GetTagStackCount(Tag));
 		}
-		return DefaultValue;
+		else if constexpr (std::is_same_v<T, FVector>)
+		{
+			FVector Value;
+			return Blackboard.GetVector(Tag, Value) ? Value : DefaultValue;
+		}
+		else if constexpr (std::is_pointer_v<T>)
+		{
+			UObject* Object = nullptr;
+			return Blackboard.GetObject(Tag, Object) ? Cast<std::remove_pointer_t<T>>(Object) : DefaultValue;
+		}
+		else if constexpr (std::is_same_v<T, FInstancedStruct>)
+		{
+			const FScenarioBlackboardEntry* Entry = Blackboard.FindEntry(Tag);
+			return Entry && Entry->Type == EScenarioBlackboardValueType::Struct ? Entry->Value : DefaultValue;
+		}
+		else
+		{
+			const T* Value = Blackboard.GetStruct<T>(Tag);
+			return Value ? *Value : DefaultValue;
+		}
 	}
 
 protected:
@@ -31,6 +31,12 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Scenario")
 	EScenarioResult GetTrackerState() const { return CurrentResult; }
 
+	// Finish this tracker once the instance's stack count for Tag meets the condition, instead of polling it
+	UFUNCTION(BlueprintCallable, Category = "Scenario")
+	void CompleteWhenTagStack(FGameplayTag Tag, ETagStackComparison Comparison, int32 Threshold, bool bSuccess = true);
+
+	virtual void EndPlay_Implementation(bool bCancelled) override;
+
 protected:
 	UPROPERTY()
 	TObjectPtr<UScenarioObjective> Objective;
@@ -38,4 +44,15 @@ protected:
 	// Change notification
 	DECLARE_MULTICAST_DELEGATE_OneParam(FOnTrackerUpdated, UScenarioTask_ObjectiveTracker*);
 	FOnTrackerUpdated OnTrackerStateUpdated;
+
+private:
+	// Where this tracker lives in the owning instance's active stages (INDEX_NONE branch = main stage)
+	int32 BranchIndex = INDEX_NONE;
+	int32 ObjectiveIndex = INDEX_NONE;
+	int32 TrackerIndex = INDEX_NONE;
+
+	// Threshold watchers registered by CompleteWhenTagStack that have not fired yet
+	TArray<TPair<FGameplayTag, FDelegateHandle>> TagStackWatches;
+
+	friend class UScenarioInstance;
 };
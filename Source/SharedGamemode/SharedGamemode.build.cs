@@ -51,7 +51,8 @@ public class SharedGamemode : ModuleRules
 				"Engine",
 				"Slate",
 				"SlateCore", 
-				"JsonUtilities"
+				"JsonUtilities",
+				"HTTP"
 			});
 		
 		
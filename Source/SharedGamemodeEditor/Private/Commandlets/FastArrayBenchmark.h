@@ -0,0 +1,105 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "UObject/CoreNet.h"
+
+// Harness shared by the benchmark commandlets that replicate a fast array without a net driver
+namespace FastArrayBenchmark
+{
+	// Results in long form (suite, case, size, metric, value) so runs can be diffed against a baseline row by row
+	struct FResultTable
+	{
+		FString Csv = TEXT("suite,case,size,metric,value\n");
+
+		void Add(const TCHAR* Suite, const TCHAR* Case, int32 Size, const TCHAR* Metric, double Value)
+		{
+			Csv += FString::Printf(TEXT("%s,%s,%d,%s,%.4f\n"), Suite, Case, Size, Metric, Value);
+		}
+	};
+
+	inline double NsPerOp(uint64 Cycles, int32 NumOps)
+	{
+		return NumOps > 0 ? FPlatformTime::ToMilliseconds64(Cycles) * 1000000.0 / NumOps : 0.0;
+	}
+
+	// Stand-in for the net driver's struct serializer: items go straight through their native NetSerialize.
+	// Items with object references override NetSerializeStruct to write them in their own way.
+	class FBenchmarkNetSerializeCB : public INetSerializeCB
+	{
+	public:
+		virtual void NetSerializeStruct(FNetDeltaSerializeInfo& Params) override
+		{
+			FArchive& Ar = Params.Writer ? static_cast<FArchive&>(*Params.Writer) : static_cast<FArchive&>(*Params.Reader);
+			bool bSuccess = true;
+			Params.Struct->GetCppStructOps()->NetSerialize(Ar, Params.Map, bSuccess, Params.Data);
+		}
+
+		// Both sides know every object up front, so nothing is ever unmapped
+		virtual void GatherGuidReferencesForFastArray(FFastArrayDeltaSerializeParams& Params) override {}
+		virtual bool MoveGuidToUnmappedForFastArray(FFastArrayDeltaSerializeParams& Params) override { return false; }
+		virtual void UpdateUnmappedGuidsForFastArray(FFastArrayDeltaSerializeParams& Params) override {}
+		virtual bool NetDeltaSerializeForFastArray(FFastArrayDeltaSerializeParams& Params) override { return false; }
+	};
+
+	// A server array replicating into a client array through its NetDeltaSerialize, timing each side
+	template<typename ArrayType, typename NetSerializeCBType = FBenchmarkNetSerializeCB>
+	struct TReplicationPair
+	{
+		ArrayType Server;
+		ArrayType Client;
+		TSharedPtr<INetDeltaBaseState> BaseState;
+		NetSerializeCBType NetSerializeCB;
+
+		int64 LastBits = 0;
+		double LastWriteSeconds = 0.0;
+		double LastReadSeconds = 0.0;
+
+		template<typename... ArgTypes>
+		explicit TReplicationPair(ArgTypes&&... Args)
+			: NetSerializeCB(Forward<ArgTypes>(Args)...)
+		{
+		}
+
+		bool Replicate()
+		{
+			FNetBitWriter Writer(nullptr, 0);
+			TSharedPtr<INetDeltaBaseState> NewState;
+
+			FNetDeltaSerializeInfo WriteParms;
+			WriteParms.Writer = &Writer;
+			WriteParms.OldState = BaseState.Get();
+			WriteParms.NewState = &NewState;
+			WriteParms.NetSerializeCB = &NetSerializeCB;
+
+			const double WriteStart = FPlatformTime::Seconds();
+			const bool bWroteAnything = Server.NetDeltaSerialize(WriteParms);
+			LastWriteSeconds = FPlatformTime::Seconds() - WriteStart;
+			LastBits = Writer.GetNumBits();
+			LastReadSeconds = 0.0;
+
+			if (NewState.IsValid())
+			{
+				BaseState = NewState;
+			}
+			if (!bWroteAnything || LastBits == 0)
+			{
+				return true;
+			}
+
+			FNetBitReader Reader(nullptr, Writer.GetData(), Writer.GetNumBits());
+			FNetDeltaSerializeInfo ReadParms;
+			ReadParms.Reader = &Reader;
+			ReadParms.NetSerializeCB = &NetSerializeCB;
+
+			// Includes the client side callbacks the array runs for each change
+			const double ReadStart = FPlatformTime::Seconds();
+			Client.NetDeltaSerialize(ReadParms);
+			LastReadSeconds = FPlatformTime::Seconds() - ReadStart;
+
+			return !Reader.IsError();
+		}
+	};
+}
@@ -0,0 +1,256 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "Commandlets/GamestateScenarioBenchmarkCommandlet.h"
+
+#include "Commandlets/FastArrayBenchmark.h"
+#include "Components/GamestateScenarioComponent.h"
+#include "Engine/NetSerialization.h"
+#include "GameplayScenario.h"
+#include "Misc/FileHelper.h"
+#include "UObject/CoreNet.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGamestateScenarioBenchmark, Log, All);
+
+namespace GamestateScenarioBenchmark
+{
+	using FastArrayBenchmark::FResultTable;
+	using FastArrayBenchmark::NsPerOp;
+
+	// Stand-in for the package map: scenarios go over the wire as their index in a shared table
+	class FScenarioNetSerializeCB : public FastArrayBenchmark::FBenchmarkNetSerializeCB
+	{
+	public:
+		explicit FScenarioNetSerializeCB(const TArray<UGameplayScenario*>& InScenarios)
+			: Scenarios(InScenarios)
+		{
+			for (int32 Index = 0; Index < Scenarios.Num(); ++Index)
+			{
+				ScenarioToNetIndex.Add(Scenarios[Index], Index);
+			}
+		}
+
+		virtual void NetSerializeStruct(FNetDeltaSerializeInfo& Params) override
+		{
+			FGameplayScenarioNetworkArrayItem& Item = *static_cast<FGameplayScenarioNetworkArrayItem*>(Params.Data);
+			if (Params.Writer)
+			{
+				const int32* NetIndex = ScenarioToNetIndex.Find(Item.Scenario);
+				uint32 Value = NetIndex ? static_cast<uint32>(*NetIndex) + 1 : 0;
+				Params.Writer->SerializeIntPacked(Value);
+			}
+			else
+			{
+				uint32 Value = 0;
+				Params.Reader->SerializeIntPacked(Value);
+				Item.Scenario = Value > 0 && Scenarios.IsValidIndex(Value - 1) ? Scenarios[Value - 1] : nullptr;
+			}
+		}
+
+	private:
+		const TArray<UGameplayScenario*>& Scenarios;
+		TMap<const UGameplayScenario*, int32> ScenarioToNetIndex;
+	};
+
+	// Neither array has a component, so the item callbacks only keep the client's scenario index up to date
+	using FReplicationPair = FastArrayBenchmark::TReplicationPair<FGameplayScenarioNetworkArray, FScenarioNetSerializeCB>;
+
+	// The lookup GamestateScenarioComponent did before the array kept an index
+	static int32 FindScenarioIndexLinear(const FGameplayScenarioNetworkArray& Array, const UGameplayScenario* Scenario)
+	{
+		return Array.Items.IndexOfByPredicate([Scenario](const FGameplayScenarioNetworkArrayItem& Item)
+		{
+			return Item.Scenario == Scenario && !Item.bPendingRemoval;
+		});
+	}
+}
+
+UGamestateScenarioBenchmarkCommandlet::UGamestateScenarioBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = true;
+	LogToConsole = true;
+}
+
+int32 UGamestateScenarioBenchmarkCommandlet::Main(const FString& Params)
+{
+	using namespace GamestateScenarioBenchmark;
+
+	int32 NumActive = 200;
+	int32 NumLookups = 100000;
+	int32 NumUpdates = 500;
+	int32 Seed = 1337;
+	FString Suites = TEXT("lookup,churn");
+	FString CsvPath;
+
+	FParse::Value(*Params, TEXT("Scenarios="), NumActive);
+	FParse::Value(*Params, TEXT("Lookups="), NumLookups);
+	FParse::Value(*Params, TEXT("Updates="), NumUpdates);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("Suites="), Suites);
+	FParse::Value(*Params, TEXT("Csv="), CsvPath);
+
+	NumActive = FMath::Max(NumActive, 1);
+	NumLookups = FMath::Max(NumLookups, 1);
+	NumUpdates = FMath::Max(NumUpdates, 1);
+	FRandomStream Random(Seed);
+
+	// Twice as many modifiers as are active at once, so churn always has one to swap in
+	TArray<UGameplayScenario*> Scenarios;
+	for (int32 ScenarioIndex = 0; ScenarioIndex < NumActive * 2; ++ScenarioIndex)
+	{
+		UGameplayScenario* Scenario = NewObject<UGameplayScenario>(GetTransientPackage(), NAME_None, RF_Transient);
+		Scenario->AddToRoot();
+		Scenarios.Add(Scenario);
+	}
+
+	FResultTable Results;
+	bool bAllOk = true;
+
+	if (Suites.Contains(TEXT("lookup")))
+	{
+		FGameplayScenarioNetworkArray Array;
+		for (int32 ScenarioIndex = 0; ScenarioIndex < NumActive; ++ScenarioIndex)
+		{
+			Array.AddScenario(Scenarios[ScenarioIndex]);
+		}
+
+		// Half the lookups ask about inactive scenarios, which is the linear scan's worst case
+		TArray<const UGameplayScenario*> Picks;
+		Picks.SetNumUninitialized(NumLookups);
+		for (const UGameplayScenario*& Pick : Picks)
+		{
+			Pick = Scenarios[Random.RandRange(0, Scenarios.Num() - 1)];
+		}
+
+		int32 Checksum = 0;
+		uint64 Start = FPlatformTime::Cycles64();
+		for (const UGameplayScenario* Pick : Picks)
+		{
+			Checksum += FindScenarioIndexLinear(Array, Pick);
+		}
+		const double LinearNs = NsPerOp(FPlatformTime::Cycles64() - Start, NumLookups);
+
+		Start = FPlatformTime::Cycles64();
+		for (const UGameplayScenario* Pick : Picks)
+		{
+			Checksum -= Array.FindScenarioIndex(Pick);
+		}
+		const double IndexedNs = NsPerOp(FPlatformTime::Cycles64() - Start, NumLookups);
+
+		// Both lookups must agree on every pick
+		bAllOk &= Checksum == 0;
+
+		UE_LOG(LogGamestateScenarioBenchmark, Display, TEXT("lookup %d active: linear %.1fns, indexed %.1fns%s"),
+			NumActive, LinearNs, IndexedNs, Checksum == 0 ? TEXT("") : TEXT(" RESULTS DIFFER"));
+
+		Results.Add(TEXT("lookup"), TEXT("linear"), NumActive, TEXT("ns_per_op"), LinearNs);
+		Results.Add(TEXT("lookup"), TEXT("indexed"), NumActive, TEXT("ns_per_op"), IndexedNs);
+	}
+
+	if (Suites.Contains(TEXT("churn")))
+	{
+		const TPair<bool, const TCHAR*> Cases[] =
+		{
+			// Every add and removal marks the whole array dirty and scans for the item
+			{ false, TEXT("legacy") },
+			// Adds mark only the new item, removals are batched into one pass
+			{ true, TEXT("indexed") },
+		};
+
+		for (const TPair<bool, const TCHAR*>& Case : Cases)
+		{
+			const bool bIndexed = Case.Key;
+			FReplicationPair Pair(Scenarios);
+
+			TArray<UGameplayScenario*> Active(Scenarios.GetData(), NumActive);
+			TArray<UGameplayScenario*> Inactive(Scenarios.GetData() + NumActive, NumActive);
+			for (UGameplayScenario* Scenario : Active)
+			{
+				Pair.Server.AddScenario(Scenario);
+			}
+
+			// Initial replication is not part of the steady state
+			bAllOk &= Pair.Replicate();
+
+			int64 TotalBits = 0;
+			uint64 ServerCycles = 0;
+			double TotalWriteSeconds = 0.0;
+			double TotalReadSeconds = 0.0;
+
+			for (int32 Update = 0; Update < NumUpdates; ++Update)
+			{
+				// One modifier ends and another starts, so the number active stays put
+				const int32 OutSlot = Random.RandRange(0, NumActive - 1);
+				const int32 InSlot = Random.RandRange(0, NumActive - 1);
+				UGameplayScenario* Outgoing = Active[OutSlot];
+				UGameplayScenario* Incoming = Inactive[InSlot];
+				Active[OutSlot] = Incoming;
+				Inactive[InSlot] = Outgoing;
+
+				const uint64 Start = FPlatformTime::Cycles64();
+				if (bIndexed)
+				{
+					Pair.Server.MarkPendingRemoval(Pair.Server.FindScenarioIndex(Outgoing));
+					Pair.Server.AddScenario(Incoming);
+					Pair.Server.RemovePendingScenarios();
+				}
+				else
+				{
+					Pair.Server.Items.RemoveAtSwap(FindScenarioIndexLinear(Pair.Server, Outgoing), 1, EAllowShrinking::No);
+					Pair.Server.MarkArrayDirty();
+
+					FGameplayScenarioNetworkArrayItem Item;
+					Item.Scenario = Incoming;
+					Pair.Server.Items.Add(Item);
+					Pair.Server.MarkArrayDirty();
+					Pair.Server.MarkItemDirty(Pair.Server.Items.Last());
+				}
+				ServerCycles += FPlatformTime::Cycles64() - Start;
+
+				bAllOk &= Pair.Replicate();
+				TotalBits += Pair.LastBits;
+				TotalWriteSeconds += Pair.LastWriteSeconds;
+				TotalReadSeconds += Pair.LastReadSeconds;
+			}
+
+			const double BytesPerUpdate = TotalBits / 8.0 / NumUpdates;
+			const double ServerNs = NsPerOp(ServerCycles, NumUpdates);
+			const double WriteNs = TotalWriteSeconds * 1.0e9 / NumUpdates;
+			const double ReadNs = TotalReadSeconds * 1.0e9 / NumUpdates;
+
+			bool bInSync = Pair.Client.Items.Num() == NumActive;
+			for (const UGameplayScenario* Scenario : Active)
+			{
+				bInSync &= Pair.Client.FindScenarioIndex(Scenario) != INDEX_NONE;
+			}
+			for (const UGameplayScenario* Scenario : Inactive)
+			{
+				bInSync &= Pair.Client.FindScenarioIndex(Scenario) == INDEX_NONE;
+			}
+			bAllOk &= bInSync;
+
+			UE_LOG(LogGamestateScenarioBenchmark, Display, TEXT("churn %-7s %d active: %.1f bytes/update, server %.0fns, write %.0fns, client receive %.0fns%s"),
+				Case.Value, NumActive, BytesPerUpdate, ServerNs, WriteNs, ReadNs, bInSync ? TEXT("") : TEXT(" CLIENT OUT OF SYNC"));
+
+			Results.Add(TEXT("churn"), Case.Value, NumActive, TEXT("bytes_per_update"), BytesPerUpdate);
+			Results.Add(TEXT("churn"), Case.Value, NumActive, TEXT("server_ns"), ServerNs);
+			Results.Add(TEXT("churn"), Case.Value, NumActive, TEXT("write_ns"), WriteNs);
+			Results.Add(TEXT("churn"), Case.Value, NumActive, TEXT("client_receive_ns"), ReadNs);
+		}
+	}
+
+	for (UGameplayScenario* Scenario : Scenarios)
+	{
+		Scenario->RemoveFromRoot();
+	}
+
+	if (!CsvPath.IsEmpty())
+	{
+		FFileHelper::SaveStringToFile(Results.Csv, *CsvPath);
+	}
+
+	return bAllOk ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "Commandlets/ScenarioBenchmarkCommandlet.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameplayScenario.h"
+#include "GameplayTagsManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "ScenarioInstance.h"
+#include "Tasks/ScenarioObjective.h"
+#include "Tasks/ScenarioStage.h"
+#include "UObject/UObjectArray.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogScenarioBenchmark, Log, All);
+
+namespace ScenarioBenchmark
+{
+	// Fixed-bucket latency histogram so recording a sample never allocates mid-run
+	struct FLatencyHistogram
+	{
+		static constexpr int32 NumBuckets = 4096;
+		static constexpr double BucketWidthNs = 25.0;
+
+		uint64 Buckets[NumBuckets] = {};
+		uint64 NumSamples = 0;
+		double MaxNs = 0.0;
+
+		void Add(double SampleNs)
+		{
+			const int32 Bucket = FMath::Clamp(FMath::FloorToInt32(SampleNs / BucketWidthNs), 0, NumBuckets - 1);
+			Buckets[Bucket]++;
+			NumSamples++;
+			MaxNs = FMath::Max(MaxNs, SampleNs);
+		}
+
+		double Percentile(double Fraction) const
+		{
+			const uint64 Target = FMath::CeilToInt64(NumSamples * Fraction);
+			uint64 Seen = 0;
+			for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+			{
+				Seen += Buckets[Bucket];
+				if (Seen >= Target && Seen > 0)
+				{
+					// Report the bucket's upper edge; the last bucket also holds everything slower
+					return Bucket == NumBuckets - 1 ? MaxNs : (Bucket + 1) * BucketWidthNs;
+				}
+			}
+			return MaxNs;
+		}
+	};
+}
+
+UScenarioBenchmarkCommandlet::UScenarioBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = true;
+	LogToConsole = true;
+}
+
+int32 UScenarioBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumInstances = 2000;
+	int32 NumFrames = 600;
+	int32 NumScenarios = 4;
+	int32 NumStages = 8;
+	int32 NumObjectives = 3;
+	int32 NumTrackers = 2;
+	int32 ForkEvery = 4;
+	int32 NumBranches = 3;
+	int32 GCInterval = 60;
+	int32 Seed = 1337;
+	float SuccessChance = 0.7f;
+	FString CsvPath;
+
+	FParse::Value(*Params, TEXT("Instances="), NumInstances);
+	FParse::Value(*Params, TEXT("Frames="), NumFrames);
+	FParse::Value(*Params, TEXT("Scenarios="), NumScenarios);
+	FParse::Value(*Params, TEXT("Stages="), NumStages);
+	FParse::Value(*Params, TEXT("Objectives="), NumObjectives);
+	FParse::Value(*Params, TEXT("Trackers="), NumTrackers);
+	FParse::Value(*Params, TEXT("ForkEvery="), ForkEvery);
+	FParse::Value(*Params, TEXT("Branches="), NumBranches);
+	FParse::Value(*Params, TEXT("GCInterval="), GCInterval);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("SuccessChance="), SuccessChance);
+	FParse::Value(*Params, TEXT("Csv="), CsvPath);
+
+	NumScenarios = FMath::Max(NumScenarios, 1);
+	NumStages = FMath::Max(NumStages, 1);
+
+	FRandomStream Random(Seed);
+
+	// Headless game world so timers, GetWorld() and authority checks behave like a standalone server
+	BenchmarkWorld = UWorld::CreateWorld(EWorldType::Game, false, TEXT("ScenarioBenchmarkWorld"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(BenchmarkWorld);
+
+	// Use whatever tags the project has registered for the tag stack churn
+	FGameplayTagContainer AllTags;
+	UGameplayTagsManager::Get().RequestAllGameplayTags(AllTags, true);
+	TArray<FGameplayTag> Tags;
+	AllTags.GetGameplayTagArray(Tags);
+	if (Tags.Num() == 0)
+	{
+		UE_LOG(LogScenarioBenchmark, Warning, TEXT("No gameplay tags registered, tag stack changes will be skipped"));
+	}
+
+	TArray<UGameplayScenario*> Scenarios;
+	for (int32 ScenarioIndex = 0; ScenarioIndex < NumScenarios; ++ScenarioIndex)
+	{
+		Scenarios.Add(BuildSyntheticScenario(NumStages, NumObjectives, NumTrackers, ForkEvery, NumBranches));
+	}
+
+	const int32 ObjectsBefore = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	const uint64 MemoryBefore = FPlatformMemory::GetStats().UsedPhysical;
+
+	int64 StageTransitions = 0;
+	Instances.Reserve(NumInstances);
+	for (int32 InstanceIndex = 0; InstanceIndex < NumInstances; ++InstanceIndex)
+	{
+		UScenarioInstance* Instance = NewObject<UScenarioInstance>(BenchmarkWorld);
+		if (Instance->InitScenario(Scenarios[InstanceIndex % Scenarios.Num()], FGameplayTagContainer()))
+		{
+			Instance->OnStageChanged.AddWeakLambda(this, [&StageTransitions](UScenarioInstance*, UScenarioStage*, int32)
+			{
+				++StageTransitions;
+			});
+			Instances.Add(Instance);
+		}
+	}
+
+	const int32 ObjectsAfterStart = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	const uint64 MemoryAfterStart = FPlatformMemory::GetStats().UsedPhysical;
+
+	UE_LOG(LogScenarioBenchmark, Display, TEXT("Started %d instances from %d scenarios (%d stages, %d objectives x %d trackers, fork every %d with %d branches)"),
+		Instances.Num(), Scenarios.Num(), NumStages, NumObjectives, NumTrackers, ForkEvery, NumBranches);
+
+	ScenarioBenchmark::FLatencyHistogram EvaluateLatency;
+	double DriveSeconds = 0.0;
+	double GCSeconds = 0.0;
+
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		const double FrameStart = FPlatformTime::Seconds();
+
+		for (UScenarioInstance* Instance : Instances)
+		{
+			const TArray<UScenarioTask_ObjectiveTracker*> Trackers = Instance->GetCurrentObjectiveTrackers();
+			if (Trackers.Num() > 0)
+			{
+				UScenarioTask_ObjectiveTracker* Tracker = Trackers[Random.RandRange(0, Trackers.Num() - 1)];
+				if (Tracker->GetTrackerState() == EScenarioResult::InProgress)
+				{
+					if (Random.FRand() < SuccessChance)
+					{
+						Tracker->MarkSuccess();
+					}
+					else
+					{
+						Tracker->MarkFailure();
+					}
+				}
+			}
+
+			if (Tags.Num() > 0)
+			{
+				const FGameplayTag& Tag = Tags[Random.RandRange(0, Tags.Num() - 1)];
+				if (Random.FRand() < 0.6f)
+				{
+					Instance->AddTagStack(Tag, Random.RandRange(1, 5));
+				}
+				else
+				{
+					Instance->RemoveTagStack(Tag, Random.RandRange(1, 5));
+				}
+			}
+
+			const uint64 EvaluateStart = FPlatformTime::Cycles64();
+			Instance->EvaluateObjectives();
+			EvaluateLatency.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - EvaluateStart) * 1000000.0);
+		}
+
+		DriveSeconds += FPlatformTime::Seconds() - FrameStart;
+
+		// Stage changes create and drop task objects, so collect like a server would
+		if (GCInterval > 0 && (Frame + 1) % GCInterval == 0)
+		{
+			const double GCStart = FPlatformTime::Seconds();
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+			GCSeconds += FPlatformTime::Seconds() - GCStart;
+		}
+	}
+
+	const int32 ObjectsAfterRun = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	const uint64 MemoryAfterRun = FPlatformMemory::GetStats().UsedPhysical;
+
+	const double TransitionsPerSecond = DriveSeconds > 0.0 ? StageTransitions / DriveSeconds : 0.0;
+	const double P50Ns = EvaluateLatency.Percentile(0.50);
+	const double P99Ns = EvaluateLatency.Percentile(0.99);
+
+	UE_LOG(LogScenarioBenchmark, Display, TEXT("Frames: %d, drive time: %.3fs, GC time: %.3fs"), NumFrames, DriveSeconds, GCSeconds);
+	UE_LOG(LogScenarioBenchmark, Display, TEXT("Stage transitions: %lld (%.1f/s)"), StageTransitions, TransitionsPerSecond);
+	UE_LOG(LogScenarioBenchmark, Display, TEXT("EvaluateObjectives: p50 %.0fns, p99 %.0fns, max %.0fns over %llu calls"), P50Ns, P99Ns, EvaluateLatency.MaxNs, EvaluateLatency.NumSamples);
+	UE_LOG(LogScenarioBenchmark, Display, TEXT("UObjects: %d before, %d after start, %d after run"), ObjectsBefore, ObjectsAfterStart, ObjectsAfterRun);
+	UE_LOG(LogScenarioBenchmark, Display, TEXT("Memory: %.1f MiB before, %.1f MiB after start, %.1f MiB after run"),
+		MemoryBefore / (1024.0 * 1024.0), MemoryAfterStart / (1024.0 * 1024.0), MemoryAfterRun / (1024.0 * 1024.0));
+
+	if (!CsvPath.IsEmpty())
+	{
+		const FString Csv = FString::Printf(
+			TEXT("instances,frames,stage_transitions,transitions_per_sec,evaluate_p50_ns,evaluate_p99_ns,evaluate_max_ns,uobjects_start,uobjects_end,memory_start_bytes,memory_end_bytes\n")
+			TEXT("%d,%d,%lld,%.2f,%.1f,%.1f,%.1f,%d,%d,%llu,%llu\n"),
+			Instances.Num(), NumFrames, StageTransitions, TransitionsPerSecond, P50Ns, P99Ns, EvaluateLatency.MaxNs,
+			ObjectsAfterStart, ObjectsAfterRun, MemoryAfterStart, MemoryAfterRun);
+		FFileHelper::SaveStringToFile(Csv, *CsvPath);
+	}
+
+	// Tear down
+	for (UScenarioInstance* Instance : Instances)
+	{
+		Instance->OnStageChanged.RemoveAll(this);
+		Instance->EndScenario(true);
+	}
+	Instances.Empty();
+
+	GEngine->DestroyWorldContext(BenchmarkWorld);
+	BenchmarkWorld->DestroyWorld(false);
+	BenchmarkWorld = nullptr;
+
+	return 0;
+}
+
+UGameplayScenario* UScenarioBenchmarkCommandlet::BuildSyntheticScenario(int32 NumStages, int32 NumObjectives, int32 NumTrackers, int32 ForkEvery, int32 NumBranches)
+{
+	UGameplayScenario* Scenario = NewObject<UGameplayScenario>(GetTransientPackage(), NAME_None, RF_Transient);
+
+	TArray<UScenarioStage*> Chain;
+	for (int32 StageIndex = 0; StageIndex < NumStages; ++StageIndex)
+	{
+		const bool bFork = ForkEvery > 0 && NumBranches > 0 && (StageIndex + 1) % ForkEvery == 0;
+		if (bFork)
+		{
+			UScenarioStage* ForkStage = NewObject<UScenarioStage>(Scenario);
+			ForkStage->JoinMode = EScenarioCompletionMode::AllSuccess;
+			for (int32 BranchIndex = 0; BranchIndex < NumBranches; ++BranchIndex)
+			{
+				ForkStage->ForkBranches.Add(BuildSyntheticStage(Scenario, NumObjectives, NumTrackers));
+			}
+			Scenario->AllStages.Add(ForkStage);
+			Chain.Add(ForkStage);
+		}
+		else
+		{
+			Chain.Add(BuildSyntheticStage(Scenario, NumObjectives, NumTrackers));
+		}
+	}
+
+	// Success moves along a loop, failure retries the stage, so instances keep running for the whole benchmark
+	for (int32 StageIndex = 0; StageIndex < Chain.Num(); ++StageIndex)
+	{
+		Chain[StageIndex]->NextStage_Success = Chain[(StageIndex + 1) % Chain.Num()];
+		Chain[StageIndex]->NextStage_Failure = Chain[StageIndex];
+	}
+
+	Scenario->InitialStage = Chain[0];
+	return Scenario;
+}
+
+UScenarioStage* UScenarioBenchmarkCommandlet::BuildSyntheticStage(UGameplayScenario* Scenario, int32 NumObjectives, int32 NumTrackers)
+{
+	UScenarioStage* Stage = NewObject<UScenarioStage>(Scenario);
+	Stage->CompletionMode = EScenarioCompletionMode::AllSuccess;
+
+	for (int32 ObjectiveIndex = 0; ObjectiveIndex < NumObjectives; ++ObjectiveIndex)
+	{
+		UScenarioObjective* Objective = NewObject<UScenarioObjective>(Stage);
+		Objective->CompletionMode = ObjectiveIndex % 2 == 0 ? EScenarioCompletionMode::AllSuccess : EScenarioCompletionMode::AnySuccess;
+		for (int32 TrackerIndex = 0; TrackerIndex < NumTrackers; ++TrackerIndex)
+		{
+			Objective->ObjectiveTrackers.Add(NewObject<UScenarioBenchmarkTracker>(Objective));
+		}
+		Stage->Objectives.Add(Objective);
+	}
+
+	Scenario->AllStages.Add(Stage);
+	return Stage;
+}
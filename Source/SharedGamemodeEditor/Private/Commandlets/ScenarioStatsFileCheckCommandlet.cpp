@@ -0,0 +1,169 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "Commandlets/ScenarioStatsFileCheckCommandlet.h"
+
+#include "ScenarioPersistenceManager.h"
+#include "ScenarioStatsFile.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogScenarioStatsFileCheck, Log, All);
+
+namespace ScenarioStatsFileCheck
+{
+	// Byte offsets of the header's record counts: strings, stats, rotation entries and histories
+	static const int32 CountOffsets[] = { 8, 12, 16, 36 };
+
+	// Byte offset of the scenario count in the analytics header
+	static constexpr int32 AnalyticsCountOffset = 8;
+
+	static void WriteUint32(TArray<uint8>& Bytes, int32 Offset, uint32 Value)
+	{
+		FMemory::Memcpy(Bytes.GetData() + Offset, &Value, sizeof(Value));
+	}
+
+	// Reads a damaged copy of Bytes. Getting here at all means the reader did not crash.
+	static bool ReadDamaged(const TArray<uint8>& Bytes, FString& OutError)
+	{
+		FScenarioStatsStore Store;
+		uint64 JournalSequence = 0;
+		return FScenarioStatsFile::Read(Bytes, Store, JournalSequence, OutError);
+	}
+}
+
+UScenarioStatsFileCheckCommandlet::UScenarioStatsFileCheckCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = true;
+	LogToConsole = true;
+}
+
+int32 UScenarioStatsFileCheckCommandlet::Main(const FString& Params)
+{
+	using namespace ScenarioStatsFileCheck;
+
+	int32 NumScenarios = 64;
+	int32 Seed = 1337;
+	FParse::Value(*Params, TEXT("Scenarios="), NumScenarios);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	NumScenarios = FMath::Max(NumScenarios, 1);
+	FRandomStream Random(Seed);
+
+	// Stats, rotation entries and history for every scenario, so every section of the file is present
+	FScenarioStatsStore Store;
+	const FDateTime Now = FDateTime::UtcNow();
+	for (int32 ScenarioIndex = 0; ScenarioIndex < NumScenarios; ++ScenarioIndex)
+	{
+		const FPrimaryAssetId ScenarioId(TEXT("GameplayScenario"), *FString::Printf(TEXT("Scenario_%d"), ScenarioIndex));
+		const FDateTime PlayedAt = Now - FTimespan::FromHours(Random.RandRange(0, 24 * 30));
+		FScenarioStatsDelta::MakePlay(ScenarioId, PlayedAt).Apply(Store);
+		FScenarioStatsDelta::MakeVotes(ScenarioId, Random.RandRange(1, 20), PlayedAt).Apply(Store);
+		FScenarioStatsDelta::MakePlayerCountSample(ScenarioId, Random.FRandRange(2.f, 64.f), PlayedAt).Apply(Store);
+		FScenarioStatsDelta::MakeMatchDuration(ScenarioId, Random.FRandRange(300.f, 2400.f), PlayedAt).Apply(Store);
+
+		FScenarioRotationEntry Entry;
+		Entry.ScenarioId = ScenarioId;
+		Entry.Weight = Random.FRandRange(0.5f, 2.f);
+		FScenarioStatsDelta::MakeRotationEntry(Entry).Apply(Store);
+	}
+
+	TArray<uint8> Bytes;
+	FScenarioStatsFile::Write(Store, 42, Bytes);
+
+	bool bAllOk = true;
+	FString Error;
+
+	{
+		FScenarioStatsStore ReadStore;
+		uint64 JournalSequence = 0;
+		const bool bRead = FScenarioStatsFile::Read(Bytes, ReadStore, JournalSequence, Error);
+		const bool bRoundTripOk = bRead && JournalSequence == 42 && ReadStore.Stats.Num() == Store.Stats.Num()
+			&& ReadStore.RotationEntries.Num() == Store.RotationEntries.Num() && ReadStore.History.Num() == Store.History.Num();
+		UE_LOG(LogScenarioStatsFileCheck, Display, TEXT("round trip of %d bytes: %s %s"), Bytes.Num(), bRoundTripOk ? TEXT("ok") : TEXT("FAILED"), *Error);
+		bAllOk &= bRoundTripOk;
+	}
+
+	// Fields outside the CRC: any flip must either be rejected or still read as a valid file
+	int32 NumHeaderRejected = 0;
+	int32 NumHeaderCases = 0;
+	for (int32 Bit = 0; Bit < FMath::Min(Bytes.Num(), 40) * 8; ++Bit)
+	{
+		TArray<uint8> Damaged = Bytes;
+		Damaged[Bit / 8] ^= 1 << (Bit % 8);
+		NumHeaderRejected += ReadDamaged(Damaged, Error) ? 0 : 1;
+		++NumHeaderCases;
+	}
+	UE_LOG(LogScenarioStatsFileCheck, Display, TEXT("header bit flips: %d of %d rejected"), NumHeaderRejected, NumHeaderCases);
+
+	// Counts no payload could hold must never reach an allocation
+	for (const int32 Offset : CountOffsets)
+	{
+		for (const uint32 Count : { 0x7fffffffu, 0x80000000u, 0xffffffffu })
+		{
+			TArray<uint8> Damaged = Bytes;
+			WriteUint32(Damaged, Offset, Count);
+			const bool bRejected = !ReadDamaged(Damaged, Error);
+			if (!bRejected)
+			{
+				UE_LOG(LogScenarioStatsFileCheck, Error, TEXT("count 0x%08x at offset %d was accepted"), Count, Offset);
+			}
+			bAllOk &= bRejected;
+		}
+	}
+
+	for (int32 Length = 0; Length < Bytes.Num(); Length += FMath::Max(Bytes.Num() / 64, 1))
+	{
+		TArray<uint8> Truncated(Bytes.GetData(), Length);
+		const bool bRejected = !ReadDamaged(Truncated, Error);
+		if (!bRejected)
+		{
+			UE_LOG(LogScenarioStatsFileCheck, Error, TEXT("file truncated to %d bytes was accepted"), Length);
+		}
+		bAllOk &= bRejected;
+	}
+
+	// The CRC covers the payload, so a damaged payload byte is always caught
+	int32 NumPayloadAccepted = 0;
+	for (int32 Case = 0; Case < 256 && Bytes.Num() > 40; ++Case)
+	{
+		TArray<uint8> Damaged = Bytes;
+		Damaged[Random.RandRange(40, Bytes.Num() - 1)] ^= static_cast<uint8>(Random.RandRange(1, 255));
+		NumPayloadAccepted += ReadDamaged(Damaged, Error) ? 1 : 0;
+	}
+	UE_LOG(LogScenarioStatsFileCheck, Display, TEXT("payload damage: %d of 256 accepted"), NumPayloadAccepted);
+	bAllOk &= NumPayloadAccepted == 0;
+
+	// The analytics file has the same kind of header, with its scenario count outside the CRC
+	FScenarioAnalytics Analytics;
+	for (int32 ScenarioIndex = 0; ScenarioIndex < NumScenarios; ++ScenarioIndex)
+	{
+		const FPrimaryAssetId ScenarioId(TEXT("GameplayScenario"), *FString::Printf(TEXT("Scenario_%d"), ScenarioIndex));
+		Analytics.RecordRun(ScenarioId, EScenarioOutcome::Success, Random.FRandRange(300.f, 2400.f));
+		Analytics.RecordStage(ScenarioId, TEXT("Stage_0"), EScenarioOutcome::Failure, Random.FRandRange(10.f, 300.f));
+	}
+
+	TArray<uint8> AnalyticsBytes;
+	Analytics.Write(AnalyticsBytes);
+	{
+		FScenarioAnalytics ReadAnalytics;
+		const bool bRoundTripOk = ReadAnalytics.Read(AnalyticsBytes, Error) && ReadAnalytics.Scenarios.Num() == Analytics.Scenarios.Num();
+		UE_LOG(LogScenarioStatsFileCheck, Display, TEXT("analytics round trip of %d bytes: %s %s"), AnalyticsBytes.Num(), bRoundTripOk ? TEXT("ok") : TEXT("FAILED"), *Error);
+		bAllOk &= bRoundTripOk;
+	}
+
+	for (const uint32 Count : { 0x7fffffffu, 0x80000000u, 0xffffffffu })
+	{
+		TArray<uint8> Damaged = AnalyticsBytes;
+		WriteUint32(Damaged, AnalyticsCountOffset, Count);
+		FScenarioAnalytics ReadAnalytics;
+		const bool bRejected = !ReadAnalytics.Read(Damaged, Error);
+		if (!bRejected)
+		{
+			UE_LOG(LogScenarioStatsFileCheck, Error, TEXT("analytics scenario count 0x%08x was accepted"), Count);
+		}
+		bAllOk &= bRejected;
+	}
+
+	UE_LOG(LogScenarioStatsFileCheck, Display, TEXT("%s"), bAllOk ? TEXT("All checks passed") : TEXT("CHECKS FAILED"));
+	return bAllOk ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "Commandlets/ScenarioStatsServerCommandlet.h"
+
+#include "Containers/Ticker.h"
+#include "HttpPath.h"
+#include "HttpServerModule.h"
+#include "HttpServerResponse.h"
+#include "IHttpRouter.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "ScenarioPersistenceWriter.h"
+#include "ScenarioStatsFile.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogScenarioStatsServer, Log, All);
+
+namespace ScenarioStatsServer
+{
+	// The store and the per-client sequences are saved together, so a restart neither loses applied
+	// records nor applies a resent batch twice
+	static constexpr uint32 StateMagic = 0x56534753; // "SGSV"
+	static constexpr uint32 StateVersion = 1;
+
+	static void SaveState(const FString& FilePath, const FScenarioStatsStore& Store, const TMap<FString, uint64>& LastSequenceByClient)
+	{
+		TArray<uint8> StoreBytes;
+		FScenarioStatsFile::Write(Store, 0, StoreBytes);
+
+		TArray<uint8> Bytes;
+		FMemoryWriter Writer(Bytes);
+		uint32 Magic = StateMagic;
+		uint32 Version = StateVersion;
+		int32 NumClients = LastSequenceByClient.Num();
+		Writer << Magic << Version << StoreBytes << NumClients;
+		for (const TPair<FString, uint64>& Client : LastSequenceByClient)
+		{
+			FString ClientId = Client.Key;
+			uint64 LastSequence = Client.Value;
+			Writer << ClientId << LastSequence;
+		}
+
+		FScenarioPersistenceWriter::WriteFileAtomic(FilePath, Bytes);
+	}
+
+	static bool LoadState(const TArray<uint8>& Bytes, FScenarioStatsStore& OutStore, TMap<FString, uint64>& OutLastSequenceByClient, FString& OutError)
+	{
+		FMemoryReader Reader(Bytes);
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		Reader << Magic << Version;
+
+		// A plain stats file, saved before the client sequences were kept
+		if (Magic != StateMagic)
+		{
+			uint64 UnusedSequence = 0;
+			return FScenarioStatsFile::Read(Bytes, OutStore, UnusedSequence, OutError);
+		}
+		if (Version != StateVersion)
+		{
+			OutError = FString::Printf(TEXT("unsupported server state version %u"), Version);
+			return false;
+		}
+
+		TArray<uint8> StoreBytes;
+		int32 NumClients = 0;
+		Reader << StoreBytes << NumClients;
+		for (int32 ClientIndex = 0; ClientIndex < NumClients && !Reader.IsError(); ++ClientIndex)
+		{
+			FString ClientId;
+			uint64 LastSequence = 0;
+			Reader << ClientId << LastSequence;
+			OutLastSequenceByClient.Add(MoveTemp(ClientId), LastSequence);
+		}
+		if (Reader.IsError())
+		{
+			OutError = TEXT("server state is truncated");
+			return false;
+		}
+
+		uint64 UnusedSequence = 0;
+		return FScenarioStatsFile::Read(StoreBytes, OutStore, UnusedSequence, OutError);
+	}
+}
+
+UScenarioStatsServerCommandlet::UScenarioStatsServerCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = true;
+	LogToConsole = true;
+}
+
+int32 UScenarioStatsServerCommandlet::Main(const FString& Params)
+{
+	using namespace ScenarioStatsServer;
+
+	int32 Port = 8787;
+	float SaveInterval = 10.0f;
+	float RunSeconds = 0.0f;
+	FString FilePath = FPaths::ProjectSavedDir() / TEXT("ScenarioStatsServer.bin");
+
+	FParse::Value(*Params, TEXT("Port="), Port);
+	FParse::Value(*Params, TEXT("SaveInterval="), SaveInterval);
+	FParse::Value(*Params, TEXT("Seconds="), RunSeconds);
+	FParse::Value(*Params, TEXT("File="), FilePath);
+
+	FScenarioStatsStore Store;
+
+	// Highest record sequence applied per client, so retried batches are not counted twice
+	TMap<FString, uint64> LastSequenceByClient;
+	bool bDirty = false;
+
+	TArray<uint8> Bytes;
+	if (FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		FString Error;
+		if (!LoadState(Bytes, Store, LastSequenceByClient, Error))
+		{
+			UE_LOG(LogScenarioStatsServer, Error, TEXT("Failed to load %s: %s"), *FilePath, *Error);
+			return 1;
+		}
+	}
+	UE_LOG(LogScenarioStatsServer, Display, TEXT("Loaded %d scenario stats and %d clients from %s"), Store.Stats.Num(), LastSequenceByClient.Num(), *FilePath);
+
+	FHttpServerModule& HttpServer = FHttpServerModule::Get();
+	TSharedPtr<IHttpRouter> Router = HttpServer.GetHttpRouter(Port);
+	if (!Router.IsValid())
+	{
+		UE_LOG(LogScenarioStatsServer, Error, TEXT("Could not listen on port %d"), Port);
+		return 1;
+	}
+
+	FHttpRouteHandle DeltasRoute = Router->BindRoute(FHttpPath(TEXT("/scenario-stats/deltas")), EHttpServerRequestVerbs::VERB_POST,
+		FHttpRequestHandler::CreateLambda([&](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+		{
+			const FString* ClientId = Request.QueryParams.Find(TEXT("client"));
+			if (!ClientId)
+			{
+				OnComplete(FHttpServerResponse::Error(EHttpServerResponseCodes::BadRequest, TEXT("MissingClient"), TEXT("client query parameter is required")));
+				return true;
+			}
+
+			uint64& LastSequence = LastSequenceByClient.FindOrAdd(*ClientId);
+			int32 NumApplied = 0;
+			FScenarioStatsFile::ReadJournal(Request.Body, LastSequence, [&](uint64 Sequence, const FScenarioStatsDelta& Delta)
+			{
+				Delta.Apply(Store);
+				LastSequence = FMath::Max(LastSequence, Sequence);
+				++NumApplied;
+			});
+			bDirty |= NumApplied > 0;
+
+			UE_LOG(LogScenarioStatsServer, Verbose, TEXT("Applied %d deltas from %s"), NumApplied, **ClientId);
+			OnComplete(FHttpServerResponse::Ok());
+			return true;
+		}));
+
+	FHttpRouteHandle SnapshotRoute = Router->BindRoute(FHttpPath(TEXT("/scenario-stats/snapshot")), EHttpServerRequestVerbs::VERB_GET,
+		FHttpRequestHandler::CreateLambda([&](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+		{
+			TArray<uint8> Snapshot;
+			FScenarioStatsFile::Write(Store, 0, Snapshot);
+			OnComplete(FHttpServerResponse::Create(MoveTemp(Snapshot), TEXT("application/octet-stream")));
+			return true;
+		}));
+
+	HttpServer.StartAllListeners();
+	UE_LOG(LogScenarioStatsServer, Display, TEXT("Serving scenario stats on port %d"), Port);
+
+	const double StartTime = FPlatformTime::Seconds();
+	double LastTickTime = StartTime;
+	double NextSaveTime = StartTime + SaveInterval;
+
+	while (!IsEngineExitRequested() && (RunSeconds <= 0.0f || FPlatformTime::Seconds() - StartTime < RunSeconds))
+	{
+		const double Now = FPlatformTime::Seconds();
+		FTSTicker::GetCoreTicker().Tick(static_cast<float>(Now - LastTickTime));
+		LastTickTime = Now;
+
+		if (bDirty && Now >= NextSaveTime)
+		{
+			SaveState(FilePath, Store, LastSequenceByClient);
+			NextSaveTime = Now + SaveInterval;
+			bDirty = false;
+		}
+
+		FPlatformProcess::Sleep(0.005f);
+	}
+
+	Router->UnbindRoute(DeltasRoute);
+	Router->UnbindRoute(SnapshotRoute);
+	HttpServer.StopAllListeners();
+
+	SaveState(FilePath, Store, LastSequenceByClient);
+	UE_LOG(LogScenarioStatsServer, Display, TEXT("Saved %d scenario stats to %s"), Store.Stats.Num(), *FilePath);
+
+	return 0;
+}
@@ -0,0 +1,380 @@
+﻿// Impact Forge LLC 2024
+
+
+#include "Commandlets/TagStackBenchmarkCommandlet.h"
+
+#include "Commandlets/FastArrayBenchmark.h"
+#include "Engine/NetSerialization.h"
+#include "GameplayTagsManager.h"
+#include "Misc/FileHelper.h"
+#include "TagStackContainer.h"
+#include "UObject/CoreNet.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTagStackBenchmark, Log, All);
+
+namespace TagStackBenchmark
+{
+	using FastArrayBenchmark::FResultTable;
+	using FastArrayBenchmark::NsPerOp;
+	using FReplicationPair = FastArrayBenchmark::TReplicationPair<FTagStackContainer>;
+
+	struct FCountDistribution
+	{
+		const TCHAR* Name;
+		int32 Min;
+		int32 Max;
+	};
+
+	// Typical shapes: small objective counters, signed deltas, scores and large resource totals
+	static const FCountDistribution Distributions[] =
+	{
+		{ TEXT("small"), 0, 16 },
+		{ TEXT("signed"), -64, 64 },
+		{ TEXT("medium"), 100, 20000 },
+		{ TEXT("large"), 100000, 50000000 },
+	};
+
+	struct FSerializeResult
+	{
+		int64 Bits = 0;
+		double WriteSeconds = 0.0;
+		double ReadSeconds = 0.0;
+		double MaxRelativeError = 0.0;
+		bool bRoundTripOk = true;
+	};
+
+	static FSerializeResult SerializeItems(TArray<FTagStack>& Items, bool bQuantize)
+	{
+		FSerializeResult Result;
+
+		FNetBitWriter Writer(nullptr, 0);
+		const double WriteStart = FPlatformTime::Seconds();
+		for (FTagStack& Item : Items)
+		{
+			Item.bAllowQuantizedCount = bQuantize;
+			bool bSuccess = true;
+			Item.NetSerialize(Writer, nullptr, bSuccess);
+		}
+		Result.WriteSeconds = FPlatformTime::Seconds() - WriteStart;
+		Result.Bits = Writer.GetNumBits();
+
+		FNetBitReader Reader(nullptr, Writer.GetData(), Writer.GetNumBits());
+		const double ReadStart = FPlatformTime::Seconds();
+		for (const FTagStack& Item : Items)
+		{
+			FTagStack Received;
+			bool bSuccess = true;
+			Received.NetSerialize(Reader, nullptr, bSuccess);
+
+			if (Received.Tag != Item.Tag || (!bQuantize && Received.StackCount != Item.StackCount))
+			{
+				Result.bRoundTripOk = false;
+			}
+			if (Item.StackCount != 0)
+			{
+				const double Error = FMath::Abs(static_cast<double>(Received.StackCount) - Item.StackCount) / FMath::Abs(static_cast<double>(Item.StackCount));
+				Result.MaxRelativeError = FMath::Max(Result.MaxRelativeError, Error);
+			}
+		}
+		Result.ReadSeconds = FPlatformTime::Seconds() - ReadStart;
+		Result.bRoundTripOk &= !Reader.IsError();
+
+		return Result;
+	}
+}
+
+UTagStackBenchmarkCommandlet::UTagStackBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = true;
+	LogToConsole = true;
+}
+
+int32 UTagStackBenchmarkCommandlet::Main(const FString& Params)
+{
+	using namespace TagStackBenchmark;
+
+	int32 NumItems = 100000;
+	int32 NumOps = 100000;
+	int32 NumUpdates = 500;
+	int32 MaxSize = 1024;
+	int32 Seed = 1337;
+	FString Suites = TEXT("serializer,ops,delta");
+	FString CsvPath;
+
+	FParse::Value(*Params, TEXT("Items="), NumItems);
+	FParse::Value(*Params, TEXT("Ops="), NumOps);
+	FParse::Value(*Params, TEXT("Updates="), NumUpdates);
+	FParse::Value(*Params, TEXT("MaxSize="), MaxSize);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("Suites="), Suites);
+	FParse::Value(*Params, TEXT("Csv="), CsvPath);
+
+	NumItems = FMath::Max(NumItems, 1);
+	NumOps = FMath::Max(NumOps, 1);
+	NumUpdates = FMath::Max(NumUpdates, 1);
+	FRandomStream Random(Seed);
+
+	FGameplayTagContainer AllTags;
+	UGameplayTagsManager::Get().RequestAllGameplayTags(AllTags, true);
+	TArray<FGameplayTag> Tags;
+	AllTags.GetGameplayTagArray(Tags);
+	if (Tags.Num() == 0)
+	{
+		UE_LOG(LogTagStackBenchmark, Error, TEXT("No gameplay tags registered, nothing to benchmark"));
+		return 1;
+	}
+
+	// Container sizes are bounded by the number of distinct tags the project has
+	TArray<int32> Sizes;
+	for (int32 Size = 1; Size <= FMath::Min(MaxSize, Tags.Num()); Size *= 2)
+	{
+		Sizes.Add(Size);
+	}
+	if (Tags.Num() < MaxSize)
+	{
+		UE_LOG(LogTagStackBenchmark, Warning, TEXT("Only %d gameplay tags registered, container sizes stop at %d"), Tags.Num(), Sizes.Last());
+	}
+
+	FResultTable Results;
+	bool bAllOk = true;
+
+	if (Suites.Contains(TEXT("serializer")))
+	{
+		// Tag cost is shared by every layout, so measure it once and add the raw int32 for the per-property baseline
+		int64 TagBits = 0;
+		{
+			FNetBitWriter Writer(nullptr, 0);
+			for (int32 TagIndex = 0; TagIndex < Tags.Num(); ++TagIndex)
+			{
+				FGameplayTag Tag = Tags[TagIndex];
+				bool bSuccess = true;
+				Tag.NetSerialize(Writer, nullptr, bSuccess);
+			}
+			TagBits = Writer.GetNumBits();
+		}
+		const double AvgTagBits = static_cast<double>(TagBits) / Tags.Num();
+		const double PropertyBitsPerItem = AvgTagBits + 32.0;
+
+		UE_LOG(LogTagStackBenchmark, Display, TEXT("%d tags, %.1f bits per tag (fast replication %s)"),
+			Tags.Num(), AvgTagBits, UGameplayTagsManager::Get().ShouldUseFastReplication() ? TEXT("on") : TEXT("off"));
+
+		for (const FCountDistribution& Distribution : Distributions)
+		{
+			TArray<FTagStack> Items;
+			Items.Reserve(NumItems);
+			for (int32 ItemIndex = 0; ItemIndex < NumItems; ++ItemIndex)
+			{
+				Items.Emplace(Tags[Random.RandRange(0, Tags.Num() - 1)], Random.RandRange(Distribution.Min, Distribution.Max));
+			}
+
+			const FSerializeResult Compact = SerializeItems(Items, false);
+			const FSerializeResult Quantized = SerializeItems(Items, true);
+			bAllOk &= Compact.bRoundTripOk && Quantized.bRoundTripOk;
+
+			const double CompactBitsPerItem = static_cast<double>(Compact.Bits) / NumItems;
+			const double QuantizedBitsPerItem = static_cast<double>(Quantized.Bits) / NumItems;
+			const double WriteNs = Compact.WriteSeconds * 1.0e9 / NumItems;
+			const double ReadNs = Compact.ReadSeconds * 1.0e9 / NumItems;
+
+			UE_LOG(LogTagStackBenchmark, Display, TEXT("serializer %-7s property %.1f bits, compact %.1f bits (%.0f%%), quantized %.1f bits (max error %.4f%%), write %.1fns, read %.1fns%s"),
+				Distribution.Name, PropertyBitsPerItem, CompactBitsPerItem, 100.0 * CompactBitsPerItem / PropertyBitsPerItem,
+				QuantizedBitsPerItem, Quantized.MaxRelativeError * 100.0, WriteNs, ReadNs,
+				Compact.bRoundTripOk && Quantized.bRoundTripOk ? TEXT("") : TEXT(" ROUND TRIP FAILED"));
+
+			Results.Add(TEXT("serializer"), Distribution.Name, NumItems, TEXT("property_bits_per_item"), PropertyBitsPerItem);
+			Results.Add(TEXT("serializer"), Distribution.Name, NumItems, TEXT("compact_bits_per_item"), CompactBitsPerItem);
+			Results.Add(TEXT("serializer"), Distribution.Name, NumItems, TEXT("quantized_bits_per_item"), QuantizedBitsPerItem);
+			Results.Add(TEXT("serializer"), Distribution.Name, NumItems, TEXT("write_ns"), WriteNs);
+			Results.Add(TEXT("serializer"), Distribution.Name, NumItems, TEXT("read_ns"), ReadNs);
+			Results.Add(TEXT("serializer"), Distribution.Name, NumItems, TEXT("quantized_max_rel_error"), Quantized.MaxRelativeError);
+		}
+	}
+
+	if (Suites.Contains(TEXT("ops")))
+	{
+		UE_LOG(LogTagStackBenchmark, Display, TEXT("Empty FTagStackContainer: %d bytes"), static_cast<int32>(sizeof(FTagStackContainer)));
+		Results.Add(TEXT("ops"), TEXT("container"), 0, TEXT("bytes"), sizeof(FTagStackContainer));
+
+		for (const int32 Size : Sizes)
+		{
+			// Counts start high so partial removals never empty an entry
+			FTagStackContainer Container;
+			for (int32 TagIndex = 0; TagIndex < Size; ++TagIndex)
+			{
+				Container.SetStack(Tags[TagIndex], 1 << 20);
+			}
+
+			TArray<int32> Picks;
+			Picks.SetNumUninitialized(NumOps);
+			for (int32& Pick : Picks)
+			{
+				Pick = Random.RandRange(0, Size - 1);
+			}
+
+			uint64 Start = FPlatformTime::Cycles64();
+			for (const int32 Pick : Picks)
+			{
+				Container.AddStack(Tags[Pick], 1);
+			}
+			const double AddNs = NsPerOp(FPlatformTime::Cycles64() - Start, NumOps);
+
+			Start = FPlatformTime::Cycles64();
+			for (const int32 Pick : Picks)
+			{
+				Container.RemoveStack(Tags[Pick], 1);
+			}
+			const double RemoveNs = NsPerOp(FPlatformTime::Cycles64() - Start, NumOps);
+
+			Start = FPlatformTime::Cycles64();
+			for (int32 OpIndex = 0; OpIndex < NumOps; ++OpIndex)
+			{
+				Container.SetStack(Tags[Picks[OpIndex]], 1 + (OpIndex & 1023));
+			}
+			const double SetNs = NsPerOp(FPlatformTime::Cycles64() - Start, NumOps);
+
+			// Clear every entry per round, refilling outside the timed region
+			uint64 ClearCycles = 0;
+			int32 NumClears = 0;
+			while (NumClears < NumOps)
+			{
+				Start = FPlatformTime::Cycles64();
+				for (int32 TagIndex = 0; TagIndex < Size; ++TagIndex)
+				{
+					Container.ClearStack(Tags[TagIndex]);
+				}
+				ClearCycles += FPlatformTime::Cycles64() - Start;
+				NumClears += Size;
+
+				for (int32 TagIndex = 0; TagIndex < Size; ++TagIndex)
+				{
+					Container.SetStack(Tags[TagIndex], 1 << 20);
+				}
+			}
+			const double ClearNs = NsPerOp(ClearCycles, NumClears);
+
+			// The container as a member of its owner plus what it holds on the heap, filled to Size tags
+			const double ContainerBytes = static_cast<double>(sizeof(FTagStackContainer) + Container.GetAllocatedSize());
+
+			UE_LOG(LogTagStackBenchmark, Display, TEXT("ops size %4d: AddStack %.1fns, RemoveStack %.1fns, SetStack %.1fns, ClearStack %.1fns, %.0f bytes"),
+				Size, AddNs, RemoveNs, SetNs, ClearNs, ContainerBytes);
+
+			Results.Add(TEXT("ops"), TEXT("AddStack"), Size, TEXT("ns_per_op"), AddNs);
+			Results.Add(TEXT("ops"), TEXT("RemoveStack"), Size, TEXT("ns_per_op"), RemoveNs);
+			Results.Add(TEXT("ops"), TEXT("SetStack"), Size, TEXT("ns_per_op"), SetNs);
+			Results.Add(TEXT("ops"), TEXT("ClearStack"), Size, TEXT("ns_per_op"), ClearNs);
+			Results.Add(TEXT("ops"), TEXT("container"), Size, TEXT("bytes"), ContainerBytes);
+		}
+	}
+
+	if (Suites.Contains(TEXT("delta")))
+	{
+		enum class EChurn : uint8
+		{
+			// A few counters tick up, like kills or captures
+			Increment,
+			// All counters change, like a full score refresh
+			Burst,
+			// One tag appears and another goes away, like short lived status tags
+			AddRemove
+		};
+		const TPair<EChurn, const TCHAR*> ChurnPatterns[] =
+		{
+			{ EChurn::Increment, TEXT("increment") },
+			{ EChurn::Burst, TEXT("burst") },
+			{ EChurn::AddRemove, TEXT("add_remove") },
+		};
+
+		for (const TPair<EChurn, const TCHAR*>& Churn : ChurnPatterns)
+		{
+			for (const int32 Size : Sizes)
+			{
+				FReplicationPair Pair;
+				for (int32 TagIndex = 0; TagIndex < Size; ++TagIndex)
+				{
+					Pair.Server.SetStack(Tags[TagIndex], 1 + TagIndex);
+				}
+
+				// Initial replication is not part of the steady state
+				bAllOk &= Pair.Replicate();
+
+				int64 TotalBits = 0;
+				double TotalWriteSeconds = 0.0;
+				double TotalReadSeconds = 0.0;
+				int32 ClientNotifications = 0;
+				const FDelegateHandle ClientHandle = Pair.Client.OnTagCountChanged.AddLambda([&ClientNotifications](FGameplayTag, int32, int32)
+				{
+					++ClientNotifications;
+				});
+
+				for (int32 Update = 0; Update < NumUpdates; ++Update)
+				{
+					switch (Churn.Key)
+					{
+					case EChurn::Increment:
+						for (int32 Change = 0; Change < FMath::Max(Size / 10, 1); ++Change)
+						{
+							Pair.Server.AddStack(Tags[Random.RandRange(0, Size - 1)], 1);
+						}
+						break;
+					case EChurn::Burst:
+						for (int32 TagIndex = 0; TagIndex < Size; ++TagIndex)
+						{
+							Pair.Server.AddStack(Tags[TagIndex], 1);
+						}
+						break;
+					case EChurn::AddRemove:
+						{
+							// Rotate one tag out and back in so the container size stays put
+							const FGameplayTag& Tag = Tags[Random.RandRange(0, Size - 1)];
+							const int32 Count = Pair.Server.GetStackCount(Tag);
+							Pair.Server.ClearStack(Tag);
+							bAllOk &= Pair.Replicate();
+							TotalBits += Pair.LastBits;
+							TotalWriteSeconds += Pair.LastWriteSeconds;
+							TotalReadSeconds += Pair.LastReadSeconds;
+							Pair.Server.SetStack(Tag, Count);
+						}
+						break;
+					}
+
+					bAllOk &= Pair.Replicate();
+					TotalBits += Pair.LastBits;
+					TotalWriteSeconds += Pair.LastWriteSeconds;
+					TotalReadSeconds += Pair.LastReadSeconds;
+				}
+				Pair.Client.OnTagCountChanged.Remove(ClientHandle);
+
+				// Add/remove replicates twice per update, the other patterns once
+				const int32 NumReplications = Churn.Key == EChurn::AddRemove ? NumUpdates * 2 : NumUpdates;
+				const double BytesPerUpdate = TotalBits / 8.0 / NumReplications;
+				const double WriteNs = TotalWriteSeconds * 1.0e9 / NumReplications;
+				const double ReadNs = TotalReadSeconds * 1.0e9 / NumReplications;
+				const double CallbackNs = ClientNotifications > 0 ? TotalReadSeconds * 1.0e9 / ClientNotifications : 0.0;
+
+				bool bInSync = true;
+				for (int32 TagIndex = 0; TagIndex < Size; ++TagIndex)
+				{
+					bInSync &= Pair.Client.GetStackCount(Tags[TagIndex]) == Pair.Server.GetStackCount(Tags[TagIndex]);
+				}
+				bAllOk &= bInSync;
+
+				UE_LOG(LogTagStackBenchmark, Display, TEXT("delta %-10s size %4d: %.1f bytes/update, write %.0fns, client receive %.0fns (%.0fns per changed tag)%s"),
+					Churn.Value, Size, BytesPerUpdate, WriteNs, ReadNs, CallbackNs, bInSync ? TEXT("") : TEXT(" CLIENT OUT OF SYNC"));
+
+				Results.Add(TEXT("delta"), Churn.Value, Size, TEXT("bytes_per_update"), BytesPerUpdate);
+				Results.Add(TEXT("delta"), Churn.Value, Size, TEXT("write_ns"), WriteNs);
+				Results.Add(TEXT("delta"), Churn.Value, Size, TEXT("client_receive_ns"), ReadNs);
+				Results.Add(TEXT("delta"), Churn.Value, Size, TEXT("client_ns_per_changed_tag"), CallbackNs);
+			}
+		}
+	}
+
+	if (!CsvPath.IsEmpty())
+	{
+		FFileHelper::SaveStringToFile(Results.Csv, *CsvPath);
+	}
+
+	return bAllOk ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GamestateScenarioBenchmarkCommandlet.generated.h"
+
+/**
+ * FGameplayScenarioNetworkArray benchmark, run headless with many modifier scenarios active at once. Suites:
+ *  - lookup: ns per IsScenarioActive-style lookup, scanning Items against the scenario index
+ *  - churn: one modifier swapped for another per update, replicated through FastArrayDeltaSerialize.
+ *    Compares the legacy path (MarkArrayDirty on every add and removal) with marking only the new item
+ *    and removing marked items in one pass, reporting bytes and write time per update and the client
+ *    receive cost.
+ * Results go to a long-form CSV (suite,case,size,metric,value) like TagStackBenchmark.
+ *
+ * UnrealEditor-Cmd <Project> -run=GamestateScenarioBenchmark -nullrhi -unattended -nopause
+ *     [-Suites=lookup,churn] [-Scenarios=200] [-Lookups=100000] [-Updates=500] [-Seed=1337] [-Csv=<path>]
+ */
+UCLASS()
+class SHAREDGAMEMODEEDITOR_API UGamestateScenarioBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UGamestateScenarioBenchmarkCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,54 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "Tasks/ScenarioTask_ObjectiveTracker.h"
+#include "ScenarioBenchmarkCommandlet.generated.h"
+
+class UGameplayScenario;
+class UScenarioInstance;
+class UScenarioStage;
+
+/**
+ * Tracker used by the synthetic benchmark scenarios. It does nothing on its own;
+ * the benchmark drives its result directly.
+ */
+UCLASS(NotBlueprintable, Transient)
+class SHAREDGAMEMODEEDITOR_API UScenarioBenchmarkTracker : public UScenarioTask_ObjectiveTracker
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Headless scenario benchmark. Starts many scenario instances from synthetic scenario graphs,
+ * drives random tracker results and tag stack changes, and reports stage transitions per second,
+ * p99 EvaluateObjectives time, UObject count and memory.
+ *
+ * UnrealEditor-Cmd <Project> -run=ScenarioBenchmark -nullrhi -unattended -nopause
+ *     [-Instances=2000] [-Frames=600] [-Stages=8] [-Objectives=3] [-Trackers=2]
+ *     [-ForkEvery=4] [-Branches=3] [-SuccessChance=0.7] [-GCInterval=60] [-Seed=1337]
+ */
+UCLASS()
+class SHAREDGAMEMODEEDITOR_API UScenarioBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UScenarioBenchmarkCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+
+private:
+	/** Builds a looping stage chain, with a forking stage every ForkEvery stages */
+	UGameplayScenario* BuildSyntheticScenario(int32 NumStages, int32 NumObjectives, int32 NumTrackers, int32 ForkEvery, int32 NumBranches);
+	UScenarioStage* BuildSyntheticStage(UGameplayScenario* Scenario, int32 NumObjectives, int32 NumTrackers);
+
+	UPROPERTY()
+	TObjectPtr<UWorld> BenchmarkWorld;
+
+	UPROPERTY()
+	TArray<TObjectPtr<UScenarioInstance>> Instances;
+};
@@ -0,0 +1,27 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ScenarioStatsFileCheckCommandlet.generated.h"
+
+/**
+ * Checks that damaged scenario persistence files are rejected instead of crashing the server. Writes a
+ * synthetic store, verifies it reads back, then reads it again with every header bit flipped, with
+ * oversized record counts, truncated and with damaged payload bytes. Every damaged payload and every
+ * impossible count must be rejected. The analytics file gets a round trip and the impossible scenario counts.
+ *
+ * UnrealEditor-Cmd <Project> -run=ScenarioStatsFileCheck -nullrhi -unattended -nopause [-Scenarios=64] [-Seed=1337]
+ */
+UCLASS()
+class SHAREDGAMEMODEEDITOR_API UScenarioStatsFileCheckCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UScenarioStatsFileCheckCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,27 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ScenarioStatsServerCommandlet.generated.h"
+
+/**
+ * Stand-in for the scenario stats aggregation service, for local testing of the remote stats backend.
+ * Applies delta batches from any number of servers to one store, drops records a client already sent,
+ * serves the global snapshot and saves it periodically, together with the last sequence applied per client.
+ *
+ * UnrealEditor-Cmd <Project> -run=ScenarioStatsServer -nullrhi -unattended -nopause
+ *     [-Port=8787] [-File=<Saved>/ScenarioStatsServer.bin] [-SaveInterval=10] [-Seconds=0]
+ */
+UCLASS()
+class SHAREDGAMEMODEEDITOR_API UScenarioStatsServerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UScenarioStatsServerCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
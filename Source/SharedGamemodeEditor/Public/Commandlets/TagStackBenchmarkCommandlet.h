@@ -0,0 +1,31 @@
+﻿// Impact Forge LLC 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TagStackBenchmarkCommandlet.generated.h"
+
+/**
+ * FTagStackContainer benchmark suite, run headless. Suites:
+ *  - serializer: bits per item for the per-property layout, the compact NetSerialize and its quantized mode
+ *  - ops: ns/op of AddStack, RemoveStack, SetStack and ClearStack at container sizes 1 to MaxSize
+ *  - delta: FastArrayDeltaSerialize bytes and time per update under increment, burst and add/remove
+ *    churn, plus the client receive and callback cost
+ * Results go to a long-form CSV (suite,case,size,metric,value) for comparison against a baseline run.
+ *
+ * UnrealEditor-Cmd <Project> -run=TagStackBenchmark -nullrhi -unattended -nopause
+ *     [-Suites=serializer,ops,delta] [-Items=100000] [-Ops=100000] [-Updates=500] [-MaxSize=1024]
+ *     [-Seed=1337] [-Csv=<path>]
+ */
+UCLASS()
+class SHAREDGAMEMODEEDITOR_API UTagStackBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UTagStackBenchmarkCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -10,6 +10,7 @@ public class SharedGamemodeEditor : ModuleRules
             new string[]
             {
                 "Core",
+                "SharedGamemode",
             }
         );
 
@@ -19,7 +20,9 @@ public class SharedGamemodeEditor : ModuleRules
                 "CoreUObject",
                 "Engine",
                 "Slate",
-                "SlateCore"
+                "SlateCore",
+                "GameplayTags",
+                "HTTPServer"
             }
         );
     }